@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "vkapp_jobs.h"
+
+// Microbenchmark for the job system: per-job spawn overhead with empty jobs,
+// and parallel-for scaling on a CPU bound kernel as workers are added.
+
+#define SPAWN_JOB_COUNT 200000
+#define SPAWN_BATCH_SIZE 2048
+#define SCALING_ITEM_COUNT (1u << 20)
+#define SCALING_GRAIN_SIZE 1024
+#define SCALING_REPEATS 5
+
+double secondsSince(uint64_t start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+void emptyJob(void *data) {
+    (void)data;
+}
+
+typedef struct {
+    float *output;
+} ScalingData;
+
+void scalingKernel(void *data, uint32_t begin, uint32_t end) {
+    ScalingData *scalingData = (ScalingData *)data;
+    for (uint32_t i = begin; i < end; i++) {
+        float x = (float)i;
+        for (int j = 0; j < 64; j++) {
+            x = sqrtf(x * 1.0001f + 1.0f);
+        }
+        scalingData->output[i] = x;
+    }
+}
+
+double benchSpawn(JobSystem *pJobSystem) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (uint32_t submitted = 0; submitted < SPAWN_JOB_COUNT; submitted += SPAWN_BATCH_SIZE) {
+        JobCounter counter;
+        initJobCounter(&counter);
+        for (uint32_t i = 0; i < SPAWN_BATCH_SIZE; i++) {
+            jobSystemRun(pJobSystem, emptyJob, NULL, &counter);
+        }
+        jobSystemWait(pJobSystem, &counter);
+    }
+    return secondsSince(start) * 1e9 / SPAWN_JOB_COUNT;
+}
+
+double benchScaling(JobSystem *pJobSystem, ScalingData *scalingData) {
+    double best = 1e30;
+    for (int repeat = 0; repeat < SCALING_REPEATS; repeat++) {
+        uint64_t start = SDL_GetPerformanceCounter();
+        jobSystemParallelFor(pJobSystem, SCALING_ITEM_COUNT, SCALING_GRAIN_SIZE, scalingKernel, scalingData);
+        double elapsed = secondsSince(start);
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    if (SDL_Init(0) != 0) {
+        fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    int cpuCount = SDL_GetCPUCount();
+    ScalingData scalingData = {0};
+    scalingData.output = (float *)malloc(SCALING_ITEM_COUNT * sizeof(float));
+    if (scalingData.output == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate benchmark output!\n");
+        return 1;
+    }
+
+    printf("threads  spawn ns/job  parallel-for ms  speedup\n");
+    double baseline = 0.0;
+    for (int threads = 1; threads <= cpuCount; threads = threads < cpuCount && threads * 2 > cpuCount ? cpuCount : threads * 2) {
+        JobSystem jobSystem;
+        // the benchmark thread takes part too, so one fewer background worker; none for the baseline
+        jobSystemInit(&jobSystem, (uint32_t)threads - 1);
+        jobSystemRegisterThread(&jobSystem);
+
+        double spawn = benchSpawn(&jobSystem);
+        double scaling = benchScaling(&jobSystem, &scalingData);
+        if (threads == 1) {
+            baseline = scaling;
+        }
+        printf("%7d  %12.1f  %15.3f  %7.2fx\n", threads, spawn, scaling * 1000.0, baseline / scaling);
+
+        jobSystemShutdown(&jobSystem);
+        if (threads == cpuCount) {
+            break;
+        }
+    }
+
+    free(scalingData.output);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,32 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+// BINDLESS_MAX_TEXTURES, partially bound: only slots the app wrote may be indexed
+layout(set = 1, binding = 0) uniform sampler2D textures[1024];
+// BINDLESS_MAX_TEXTURES entries per frame in flight, read by the texture streamer
+layout(set = 1, binding = 1) buffer MipFeedback {
+    uint requestedLevel[];
+} feedback;
+
+layout(push_constant) uniform DrawConstants {
+    uint materialIndex;
+    uint feedbackOffset;
+} draw;
+
+// FEEDBACK_LEVEL_BIAS, keeps levels finer than the sampled image's first one positive
+const float levelBias = 16.0;
+
+void main() {
+    outColor = texture(textures[draw.materialIndex], fragTexCoord);
+    // implicit derivatives, so queried in uniform control flow before the branch
+    float lod = textureQueryLod(textures[draw.materialIndex], fragTexCoord).y;
+    // one fragment in 64 is plenty to find the finest level and keeps the atomics cheap
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    if (((pixel.x | pixel.y) & 7u) == 0u) {
+        uint level = uint(clamp(floor(lod) + levelBias, 0.0, 31.0));
+        atomicMin(feedback.requestedLevel[draw.feedbackOffset + draw.materialIndex], level);
+    }
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// must match MULTIVIEW_MAX_VIEWS
+#define MAX_VIEWS 4
+
+layout(binding = 0) uniform MultiviewCameraUniformBufferObject {
+    mat4 view[MAX_VIEWS];
+    mat4 proj[MAX_VIEWS];
+} camera;
+
+// pushed per draw, after DrawConstants in shaders/bindless.frag
+layout(push_constant) uniform ObjectConstants {
+    layout(offset = 16) mat4 model;
+} object;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+
+void main() {
+    gl_Position = camera.proj[gl_ViewIndex] * camera.view[gl_ViewIndex] * object.model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
@@ -1,10 +1,15 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+// written once per frame
+layout(binding = 0) uniform CameraUniformBufferObject {
     mat4 view;
     mat4 proj;
-} ubo;
+} camera;
+
+// pushed per draw, after DrawConstants in shaders/bindless.frag
+layout(push_constant) uniform ObjectConstants {
+    layout(offset = 16) mat4 model;
+} object;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -15,7 +20,7 @@ layout(location = 1) out vec2 fragTexCoord;
 
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = camera.proj * camera.view * object.model * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
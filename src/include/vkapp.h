@@ -7,11 +7,54 @@
 #include "SDL.h"
 #include "SDL_vulkan.h"
 
+#include "vkapp_jobs.h"
+#include "vkapp_timing.h"
+#include "vkapp_trace.h"
+#include "vkapp_framestats.h"
+#include "vkapp_frame.h"
+#include "vkapp_image.h"
+#include "vkapp_ktx.h"
+#include "vkapp_packer.h"
 #include "vkapp_types.h"
 #include "vkapp_debug.h"
+#include "vkapp_descriptors.h"
+#include "vkapp_samplers.h"
+#include "vkapp_barriers.h"
 #include "vkapp_vulkan.h"
+#include "vkapp_rendergraph.h"
+#include "vkapp_textures.h"
+#include "vkapp_bindless.h"
+#include "vkapp_atlas.h"
+#include "vkapp_streaming.h"
+#include "vkapp_profiler.h"
+#include "vkapp_capture.h"
+#include "vkapp_service.h"
+#include "vkapp_benchmark.h"
+
+void app_queryDrawableExtent(VkApp *pApp, VkExtent2D *pExtent) {
+    if (pApp->window == NULL) {
+        // headless, the requested size is all there is
+        pExtent->width = pApp->width;
+        pExtent->height = pApp->height;
+        return;
+    }
+    int width;
+    int height;
+    SDL_Vulkan_GetDrawableSize(pApp->window, &width, &height);
+    pExtent->width = (uint32_t)width;
+    pExtent->height = (uint32_t)height;
+}
 
 void app_initSDLWindow(VkApp *pApp) {
+    if (pApp->headless) {
+        // events only, so SIGINT still arrives as SDL_QUIT
+        if (SDL_Init(SDL_INIT_EVENTS) != 0) {
+            fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+            exit(1);
+        }
+        app_queryDrawableExtent(pApp, &pApp->drawableExtent);
+        return;
+    }
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
         exit(1);
@@ -23,52 +66,434 @@ void app_initSDLWindow(VkApp *pApp) {
         exit(1);
     }
     SDL_SetWindowResizable(pApp->window, SDL_TRUE);
+    app_queryDrawableExtent(pApp, &pApp->drawableExtent);
+}
+
+void app_loadModelJob(void *data) {
+    VkApp *pApp = (VkApp *)data;
+    STARTUP_PHASE(&pApp->startupTimer, "model_parse", modelVertexCount * sizeof(Vertex) + modelIndexCount * sizeof(uint32_t), loadModel());
+    if (pApp->pTextureAtlas != NULL) {
+        // only runs once the atlas is built, entries have no place before that
+        textureAtlasRemapModel(pApp->pTextureAtlas, texturePath, modelVertices, modelVertexCount);
+    }
+}
+
+void app_loadShadersJob(void *data) {
+    VkApp *pApp = (VkApp *)data;
+    STARTUP_PHASE(&pApp->startupTimer, "shader_load", pApp->vertexShaderFile.size + pApp->fragmentShaderFile.size + pApp->bindlessFragmentShaderFile.size, loadShaders(pApp));
+}
+
+// the tail of the texture is uploaded here, the rest streams in while rendering
+void app_startTextureStreaming(VkApp *pApp) {
+    // the shared sampler leaves the LOD range open, each view limits sampling to its own levels
+    createTextureSampler(pApp);
+    pApp->pTextureStreamer = (TextureStreamer *)malloc(sizeof(TextureStreamer));
+    createTextureStreamer(pApp->pTextureStreamer, pApp->textureBudget, pApp->textureSampler, pApp);
+    pApp->materialIndex = textureStreamerAdd(pApp->pTextureStreamer, texturePath, pApp);
+    if (pApp->materialIndex == NO_STREAMED_TEXTURE) {
+        exit(1);
+    }
+    // set 0 (frag.spv, the service) samples the tail, which stays resident
+    const StreamedTexture *pTexture = &pApp->pTextureStreamer->textures[pApp->materialIndex];
+    pApp->textureImageView = pTexture->tail.view;
+    pApp->textureFormat = pTexture->format;
+    pApp->textureMipLevels = pTexture->mipLevels;
+}
+
+void app_createPipelineJob(void *data) {
+    VkApp *pApp = (VkApp *)data;
+    STARTUP_PHASE(&pApp->startupTimer, "pipeline", 0, createGraphicsPipeline(pApp));
 }
 
+// Startup is a small dependency graph rather than a straight line: file
+// loading and decoding run on the job system while this thread brings up the
+// instance and device, pipeline creation overlaps the rest of the swapchain
+// setup, and each upload is issued as soon as its data is ready. Everything
+// that records into the command pool or touches the queue stays on this thread.
 void app_initVulkan(VkApp *pApp) {
-    loadModel();
+    JobSystem *pJobSystem = &pApp->jobSystem;
+    StartupTimer *pTimer = &pApp->startupTimer;
+    JobCounter modelLoaded;
+    TextureLoader textureLoader;
+    JobCounter shadersLoaded;
+    JobCounter pipelineCreated;
+    JobCounter atlasBuilt;
+    initJobCounter(&modelLoaded);
+    initJobCounter(&shadersLoaded);
+    initJobCounter(&pipelineCreated);
+    initJobCounter(&atlasBuilt);
+    uint32_t initPhase = startupPhaseBegin(pTimer, "init_vulkan");
+
+    // a texture in the atlas is drawn from its page, with the model's coordinates remapped into it
+    bool textureInAtlas = false;
+    if (pApp->atlasPath != NULL) {
+        pApp->pTextureAtlas = (TextureAtlas *)malloc(sizeof(TextureAtlas));
+        if (!textureAtlasOpen(pApp->pTextureAtlas, pApp->atlasPath, pJobSystem)) {
+            exit(1);
+        }
+        textureInAtlas = atlasFindEntry(&pApp->pTextureAtlas->layout, texturePath) != NULL;
+        jobSystemRun(pJobSystem, textureAtlasBuildJob, pApp->pTextureAtlas, &atlasBuilt);
+        jobSystemRunAfter(pJobSystem, &atlasBuilt, app_loadModelJob, pApp, &modelLoaded);
+    } else {
+        jobSystemRun(pJobSystem, app_loadModelJob, pApp, &modelLoaded);
+    }
+    if (textureInAtlas && pApp->streamTextures) {
+        printf("INFO: %s is in the atlas, not streaming it\n", texturePath);
+        pApp->streamTextures = false;
+    }
+    // streaming only knows whether it can run once the device exists
+    if (!pApp->streamTextures && !textureInAtlas) {
+        textureLoaderStart(&textureLoader, &texturePath, 1, pApp);
+    }
+    jobSystemRun(pJobSystem, app_loadShadersJob, pApp, &shadersLoaded);
+
+    uint32_t phase = startupPhaseBegin(pTimer, "instance");
     app_createVulkanInstance(pApp);
     setupDebugMessenger(pApp);
     createSurface(pApp);
+    startupPhaseEnd(pTimer, phase, 0);
+
+    phase = startupPhaseBegin(pTimer, "device");
     pickPhysicalDevice(pApp);
     createLogicalDevice(pApp);
+    initSamplerCache(&pApp->samplerCache);
+    startupPhaseEnd(pTimer, phase, 0);
+    if (pApp->streamTextures && !pApp->bindless.supported) {
+        printf("INFO: texture streaming needs descriptor indexing, loading the whole texture instead\n");
+        pApp->streamTextures = false;
+        textureLoaderStart(&textureLoader, &texturePath, 1, pApp);
+    }
+
+    phase = startupPhaseBegin(pTimer, "swapchain");
     createSwapChain(pApp);
     createImageViews(pApp);
     createRenderPass(pApp);
     createDescriptorSetLayout(pApp);
-    createGraphicsPipeline(pApp);
+    createBindlessTextures(pApp);
+    startupPhaseEnd(pTimer, phase, 0);
+    jobSystemRunAfter(pJobSystem, &shadersLoaded, app_createPipelineJob, pApp, &pipelineCreated);
+
+    phase = startupPhaseBegin(pTimer, "frame_resources");
     createCommandPool(pApp);
-    createDepthResources(pApp);
-    createFramebuffers(pApp);
-    createTextureImage(pApp);
-    createTextureImageView(pApp);
-    createTextureSampler(pApp);
-    createVertexBuffer(pApp);
-    createIndexBuffer(pApp);
+    if (!pApp->streamTextures && !textureInAtlas) {
+        textureLoaderCreateStaging(&textureLoader, pApp);
+    }
+    initRenderGraph(&pApp->renderGraph);
     createUniformBuffers(pApp);
-    createDescriptorPool(pApp);
-    createDescriptorSets(pApp);
+    createDescriptorAllocators(pApp);
     createCommandBuffers(pApp);
     createSyncObjects(pApp);
+    createGpuProfiler(pApp);
+    startupPhaseEnd(pTimer, phase, (uint64_t)sizeof(CameraUniformBufferObject) * MAX_FRAMES_IN_FLIGHT);
+
+    if (pApp->streamTextures) {
+        STARTUP_PHASE(pTimer, "texture_stream_tail", 0, app_startTextureStreaming(pApp));
+    } else if (textureInAtlas) {
+        pApp->textureMipLevels = atlasMipLevels(pApp->pTextureAtlas->layout.padding);
+        createTextureSampler(pApp);
+    } else {
+        STARTUP_PHASE(pTimer, "texture_upload", textureLoader.uploadedBytes, textureLoaderFinish(&textureLoader, pApp));
+        if (textureLoader.failedCount > 0) {
+            exit(1);
+        }
+        pApp->textureImage = textureLoader.loads[0].image;
+        pApp->textureImageMemory = textureLoader.loads[0].imageMemory;
+        pApp->textureFormat = textureLoader.loads[0].format;
+        pApp->textureMipLevels = textureLoader.loads[0].mipLevels;
+        destroyTextureLoader(&textureLoader);
+        createTextureImageView(pApp);
+        createTextureSampler(pApp);
+        pApp->materialIndex = bindlessAddTexture(pApp->textureImageView, pApp->textureSampler, pApp);
+    }
+    if (pApp->pTextureAtlas != NULL) {
+        TextureAtlas *pAtlas = pApp->pTextureAtlas;
+        STARTUP_PHASE(pTimer, "wait_atlas_build", 0, jobSystemWait(pJobSystem, &atlasBuilt));
+        if (pAtlas->failed) {
+            exit(1);
+        }
+        STARTUP_PHASE(pTimer, "atlas_upload", pAtlas->uploadedBytes, textureAtlasUpload(pAtlas, pApp->textureSampler, pApp));
+        if (textureInAtlas) {
+            uint32_t page = atlasFindEntry(&pAtlas->layout, texturePath)->page;
+            pApp->textureImageView = pAtlas->imageViews[page];
+            pApp->materialIndex = pAtlas->slots[page];
+        }
+    }
+    createDescriptorSets(pApp);
+
+    STARTUP_PHASE(pTimer, "wait_model_parse", 0, jobSystemWait(pJobSystem, &modelLoaded));
+    STARTUP_PHASE(pTimer, "vertex_upload", modelVertexCount * sizeof(Vertex), createVertexBuffer(pApp));
+    STARTUP_PHASE(pTimer, "index_upload", modelIndexCount * sizeof(uint32_t), createIndexBuffer(pApp));
+
+    STARTUP_PHASE(pTimer, "wait_pipeline", 0, jobSystemWait(pJobSystem, &pipelineCreated));
+    startupPhaseEnd(pTimer, initPhase, 0);
 }
 
-void app_mainLoop(VkApp *pApp) {
-    SDL_Event event;
+void app_parseArgs(int argc, char **argv, VkApp *pApp) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--on-demand") == 0) {
+            pApp->renderOnDemand = true;
+        } else if (strcmp(argv[i], "--startup-report") == 0 && i + 1 < argc) {
+            pApp->startupReportPath = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            pApp->headless = true;
+        } else if (strcmp(argv[i], "--headless-surface") == 0) {
+            pApp->headless = true;
+            pApp->useHeadlessSurface = true;
+        } else if (strcmp(argv[i], "--benchmark") == 0) {
+            pApp->benchmark = true;
+        } else if (strcmp(argv[i], "--benchmark-frames") == 0 && i + 1 < argc) {
+            pApp->benchmarkFrames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--benchmark-warmup") == 0 && i + 1 < argc) {
+            pApp->benchmarkWarmupFrames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc) {
+            pApp->benchmarkOutputPath = argv[++i];
+        } else if (strcmp(argv[i], "--uncapped") == 0) {
+            pApp->uncappedPresent = true;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            pApp->servicePath = argv[++i];
+            pApp->headless = true;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            pApp->capture.everyFrame = true;
+            pApp->capture.directory = argv[++i];
+        } else if (strcmp(argv[i], "--capture-raw") == 0) {
+            pApp->capture.raw = true;
+        } else if (strcmp(argv[i], "--frame-stats") == 0) {
+            pApp->printFrameStats = true;
+        } else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+            // a .ktx2 file from tools/ktxconv is uploaded without decoding
+            texturePath = argv[++i];
+        } else if (strcmp(argv[i], "--stream-textures") == 0) {
+            pApp->streamTextures = true;
+        } else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+            // MiB of streamed detail levels, the resident tails aren't counted
+            pApp->textureBudget = (VkDeviceSize)strtoul(argv[++i], NULL, 10) << 20;
+        } else if (strcmp(argv[i], "--atlas") == 0 && i + 1 < argc) {
+            // a .atlas manifest from tools/atlaspack, or a list of images packed at startup
+            pApp->atlasPath = argv[++i];
+        } else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            // samples per pixel, lowered to what the device supports
+            char *end;
+            unsigned long samples = strtoul(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || samples < 1) {
+                fprintf(stderr, "ERROR: --msaa needs a sample count of at least 1, got %s\n", argv[i]);
+                exit(1);
+            }
+            pApp->msaaSamples = samples > VK_SAMPLE_COUNT_64_BIT ? VK_SAMPLE_COUNT_64_BIT : (VkSampleCountFlagBits)samples;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            pApp->tracePath = argv[++i];
+        } else {
+            fprintf(stderr, "WARNING: ignoring unknown argument: %s\n", argv[i]);
+        }
+    }
+}
+
+// returns false once the app should quit
+bool app_handleEvent(VkApp *pApp, SDL_Event *event) {
+    switch (event->type) {
+    case SDL_QUIT:
+        return false;
+    case SDL_KEYDOWN:
+        if (event->key.keysym.sym == SDLK_ESCAPE) {
+            return false;
+        }
+        if (event->key.keysym.sym == SDLK_SPACE) {
+            pApp->animating = !pApp->animating;
+            pApp->redrawRequested = true;
+        }
+        if (event->key.keysym.sym == SDLK_F2) {
+            writeStartupReport(&pApp->startupTimer, stdout);
+        }
+        if (event->key.keysym.sym == SDLK_F3) {
+            // the stats belong to the render thread, it prints them after its next frame
+            atomic_store(&pApp->gpuProfiler.reportRequested, true);
+        }
+        if (event->key.keysym.sym == SDLK_F4) {
+            writeTraceFile(pApp->tracePath != NULL ? pApp->tracePath : DEFAULT_TRACE_PATH);
+        }
+        if (event->key.keysym.sym == SDLK_F5) {
+            frameStatsReport(&pApp->frameStats, stdout);
+        }
+        if (event->key.keysym.sym == SDLK_F6) {
+            // picked up by the render thread's next frame
+            atomic_store(&pApp->capture.requested, true);
+            pApp->redrawRequested = true;
+        }
+        break;
+    case SDL_WINDOWEVENT:
+        switch (event->window.event) {
+        case SDL_WINDOWEVENT_MINIMIZED:
+        case SDL_WINDOWEVENT_HIDDEN:
+            pApp->minimized = true;
+            break;
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_MAXIMIZED:
+        case SDL_WINDOWEVENT_SHOWN:
+            pApp->minimized = false;
+            pApp->redrawRequested = true;
+            break;
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+            atomic_store(&pApp->framebufferResized, true);
+            pApp->redrawRequested = true;
+            break;
+        case SDL_WINDOWEVENT_EXPOSED:
+            pApp->redrawRequested = true;
+            break;
+        }
+        break;
+    }
+    return true;
+}
+
+bool app_shouldRender(VkApp *pApp) {
+    if (pApp->minimized) {
+        return false;
+    }
+    if (pApp->benchmark) {
+        return true;
+    }
+    return !pApp->renderOnDemand || pApp->animating || pApp->redrawRequested;
+}
+
+void app_advanceAnimation(VkApp *pApp) {
+    if (pApp->benchmark) {
+        // fixed step per simulated frame, independent of how long frames really take
+        pApp->animationTime = (double)pApp->simulatedFrameCount * BENCHMARK_TIMESTEP;
+        return;
+    }
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (pApp->lastFrameCounter != 0 && pApp->animating) {
+        pApp->animationTime += (double)(now - pApp->lastFrameCounter) / (double)SDL_GetPerformanceFrequency();
+    }
+    pApp->lastFrameCounter = now;
+}
+
+// fills in the next frame's state; runs on the event thread
+void app_simulate(VkApp *pApp, FrameState *pState) {
+    pState->frameIndex = pApp->simulatedFrameCount++;
+    pState->time = pApp->animationTime;
+
+    glm_mat4_identity(pState->model);
+    glm_rotate(pState->model, (float)pApp->animationTime * glm_rad(90.0f), (vec3){0.0f, 0.0f, 1.0f});
+
+    // the benchmark orbits the camera too so the path covers more than one view of the model
+    float orbit = glm_rad(45.0f);
+    if (pApp->benchmark) {
+        orbit += (float)pApp->animationTime * glm_rad(BENCHMARK_ORBIT_DEGREES_PER_SECOND);
+    }
+    float orbitRadius = sqrtf(8.0f);
+    glm_mat4_identity(pState->view);
+    glm_lookat((vec3){orbitRadius * cosf(orbit), orbitRadius * sinf(orbit), 2.0f}, (vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, 1.0f}, pState->view);
+
+    pState->fovY = glm_rad(45.0f);
+    pState->nearPlane = 0.1f;
+    pState->farPlane = 10.0f;
+    app_queryDrawableExtent(pApp, &pState->drawableExtent);
+}
+
+// Acquire, record, submit and present all happen here, so a slow present
+// never holds up event handling on the main thread.
+int app_renderThread(void *data) {
+    VkApp *pApp = (VkApp *)data;
+    jobSystemRegisterThread(&pApp->jobSystem);
+    traceSetThreadName("render");
     while (true) {
-        SDL_PollEvent(&event);
-        if (event.type == SDL_QUIT) {
+        SDL_SemWait(pApp->frameReady);
+        if (atomic_load(&pApp->renderThreadQuit)) {
             break;
         }
-        if (event.type == SDL_WINDOWEVENT) {
-            // recreateSwapChain(pApp);
-            // continue;
-            if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-                recreateSwapChain(pApp);
-                continue;
+        const FrameState *pState = frameStateAcquire(&pApp->frameStates);
+        if (pState == NULL) {
+            continue;
+        }
+        // let the event thread start simulating the next frame while this one is submitted
+        SDL_SemPost(pApp->frameConsumed);
+
+        bool extentChanged = pState->drawableExtent.width != pApp->drawableExtent.width || pState->drawableExtent.height != pApp->drawableExtent.height;
+        if (atomic_exchange(&pApp->framebufferResized, false) || extentChanged) {
+            pApp->drawableExtent = pState->drawableExtent;
+            TRACE_SCOPE("recreateSwapChain", recreateSwapChain(pApp));
+        }
+        if (pApp->benchmark && pState->frameIndex == pApp->benchmarkWarmupFrames) {
+            frameStatsReset(&pApp->frameStats);
+            gpuProfilerResetStats(pApp, pState->frameIndex);
+        }
+        app_renderFrame(pApp, pState);
+        startupTimerMarkFirstFrame(&pApp->startupTimer);
+        if (atomic_exchange(&pApp->gpuProfiler.reportRequested, false)) {
+            gpuProfilerReport(pApp, stdout);
+        }
+        if (pApp->printFrameStats) {
+            frameStatsReportPeriodically(&pApp->frameStats, stdout);
+        }
+    }
+    return 0;
+}
+
+void app_startRenderThread(VkApp *pApp) {
+    pApp->frameReady = SDL_CreateSemaphore(0);
+    pApp->frameConsumed = SDL_CreateSemaphore(0);
+    if (pApp->frameReady == NULL || pApp->frameConsumed == NULL) {
+        fprintf(stderr, "ERROR: failed to create render thread semaphores: %s\n", SDL_GetError());
+        exit(1);
+    }
+    atomic_store(&pApp->renderThreadQuit, false);
+    pApp->renderThread = SDL_CreateThread(app_renderThread, "render", pApp);
+    if (pApp->renderThread == NULL) {
+        fprintf(stderr, "ERROR: failed to create render thread: %s\n", SDL_GetError());
+        exit(1);
+    }
+}
+
+void app_stopRenderThread(VkApp *pApp) {
+    atomic_store(&pApp->renderThreadQuit, true);
+    SDL_SemPost(pApp->frameReady);
+    SDL_WaitThread(pApp->renderThread, NULL);
+    pApp->renderThread = NULL;
+    SDL_DestroySemaphore(pApp->frameReady);
+    SDL_DestroySemaphore(pApp->frameConsumed);
+}
+
+void app_mainLoop(VkApp *pApp) {
+    SDL_Event event;
+    bool running = true;
+    // the previous snapshot was picked up, so the next one can be simulated
+    bool canPublish = true;
+    app_startRenderThread(pApp);
+    while (running) {
+        // nothing to draw: sleep until an event arrives instead of spinning
+        if (!app_shouldRender(pApp)) {
+            int timeout = pApp->minimized ? -1 : IDLE_WAIT_TIMEOUT_MS;
+            if (SDL_WaitEventTimeout(&event, timeout)) {
+                running = app_handleEvent(pApp, &event);
             }
+            // don't count the time spent asleep as animation time
+            pApp->lastFrameCounter = 0;
+        }
+        // drain everything that queued up during the last frame
+        while (running && SDL_PollEvent(&event)) {
+            running = app_handleEvent(pApp, &event);
+        }
+        if (!running) {
+            break;
+        }
+        // every benchmark frame has been handed over, stopping the render thread lets the last one finish
+        if (pApp->benchmark && canPublish && pApp->simulatedFrameCount >= (uint64_t)pApp->benchmarkWarmupFrames + pApp->benchmarkFrames) {
+            break;
+        }
+        if (canPublish && app_shouldRender(pApp)) {
+            app_advanceAnimation(pApp);
+            pApp->redrawRequested = false;
+            TRACE_SCOPE("app_simulate", app_simulate(pApp, frameStateBack(&pApp->frameStates)));
+            frameStatePublish(&pApp->frameStates);
+            SDL_SemPost(pApp->frameReady);
+            canPublish = false;
+        }
+        // pace the simulation to the render thread, but keep waking up to handle input if it stalls
+        if (!canPublish) {
+            canPublish = SDL_SemWaitTimeout(pApp->frameConsumed, INPUT_POLL_INTERVAL_MS) == 0;
         }
-        app_renderFrame(pApp);
     }
+    app_stopRenderThread(pApp);
     vkDeviceWaitIdle(pApp->device);
 }
 
@@ -81,38 +506,85 @@ void app_cleanup(VkApp *pApp) {
         vkDestroySemaphore(pApp->device, pApp->renderFinishedSemaphores[i], NULL);
         vkDestroyFence(pApp->device, pApp->inFlightFences[i], NULL);
     }
+    destroyCaptureRing(pApp);
+    captureReport(pApp, stdout);
+    gpuProfilerReport(pApp, stdout);
+    destroyGpuProfiler(pApp);
+    frameStatsReport(&pApp->frameStats, stdout);
+    destroyFrameStats(&pApp->frameStats);
     vkDestroyCommandPool(pApp->device, pApp->commandPool, NULL);
     vkDestroyPipeline(pApp->device, pApp->graphicsPipeline, NULL);
     vkDestroyPipelineLayout(pApp->device, pApp->pipelineLayout, NULL);
     vkDestroyRenderPass(pApp->device, pApp->renderPass, NULL);
     cleanupSwapChain(pApp);
+    destroyRenderGraph(&pApp->renderGraph, pApp);
         
-    vkDestroyImage(pApp->device, pApp->textureImage, NULL);
-    vkFreeMemory(pApp->device, pApp->textureImageMemory, NULL);
-    vkDestroyImageView(pApp->device, pApp->textureImageView, NULL);
-    vkDestroySampler(pApp->device, pApp->textureSampler, NULL);
+    if (pApp->pTextureStreamer != NULL) {
+        // the texture view is the streamer's
+        textureStreamerReport(pApp->pTextureStreamer, stdout);
+        destroyTextureStreamer(pApp->pTextureStreamer, pApp);
+        free(pApp->pTextureStreamer);
+    } else if (pApp->textureImage == VK_NULL_HANDLE) {
+        // the texture view is an atlas page's, destroyed with the atlas
+    } else {
+        vkDestroyImage(pApp->device, pApp->textureImage, NULL);
+        freeDeviceMemory(pApp->textureImageMemory, pApp);
+        vkDestroyImageView(pApp->device, pApp->textureImageView, NULL);
+    }
+    if (pApp->pTextureAtlas != NULL) {
+        destroyTextureAtlas(pApp->pTextureAtlas, pApp);
+        free(pApp->pTextureAtlas);
+    }
+    destroySamplerCache(&pApp->samplerCache, pApp);
     destroyUniformBuffers(pApp);
-    vkDestroyDescriptorPool(pApp->device, pApp->descriptorPool, NULL);
+    destroyDescriptorAllocators(pApp);
     vkDestroyDescriptorSetLayout(pApp->device, pApp->descriptorSetLayout, NULL);
+    destroyBindlessTextures(pApp);
     // free(pApp->imageAvailableSemaphores);
     // free(pApp->renderFinishedSemaphores);
     // free(pApp->inFlightFences);
     // free(pApp->commandBuffers);
     vkDestroyBuffer(pApp->device, pApp->vertexBuffer, NULL);
-    vkFreeMemory(pApp->device, pApp->vertexBufferMemory, NULL);
+    freeDeviceMemory(pApp->vertexBufferMemory, pApp);
     vkDestroyBuffer(pApp->device, pApp->indexBuffer, NULL);
-    vkFreeMemory(pApp->device, pApp->indexBufferMemory, NULL);
+    freeDeviceMemory(pApp->indexBufferMemory, pApp);
     vkDestroyDevice(pApp->device, NULL);
-    vkDestroySurfaceKHR(pApp->instance, pApp->surface, NULL);
+    destroyDeviceMemoryStats(&pApp->deviceMemory);
+    if (pApp->surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(pApp->instance, pApp->surface, NULL);
+    }
     vkDestroyInstance(pApp->instance, NULL);
-    SDL_DestroyWindow(pApp->window);
+    jobSystemShutdown(&pApp->jobSystem);
+    if (pApp->window != NULL) {
+        SDL_DestroyWindow(pApp->window);
+    }
     SDL_Quit();
 }
 
 int app_run(VkApp *pApp) {
-    app_initSDLWindow(pApp);
+    initTracer();
+    traceSetThreadName("main");
+    initFrameStats(&pApp->frameStats);
+    initDeviceMemoryStats(&pApp->deviceMemory);
+    STARTUP_PHASE(&pApp->startupTimer, "job_system", 0, jobSystemInit(&pApp->jobSystem, JOB_SYSTEM_DEFAULT_WORKERS));
+    jobSystemRegisterThread(&pApp->jobSystem);
+    STARTUP_PHASE(&pApp->startupTimer, "window", 0, app_initSDLWindow(pApp));
     app_initVulkan(pApp);
-    app_mainLoop(pApp);
+    if (pApp->servicePath != NULL) {
+        app_serve(pApp);
+    } else {
+        app_mainLoop(pApp);
+    }
+    if (pApp->benchmark) {
+        app_writeBenchmarkReport(pApp);
+    }
     app_cleanup(pApp);
+    if (pApp->startupReportPath != NULL) {
+        writeStartupReportFile(&pApp->startupTimer, pApp->startupReportPath);
+    }
+    if (pApp->tracePath != NULL) {
+        writeTraceFile(pApp->tracePath);
+    }
+    destroyTracer();
     return 0;
 }
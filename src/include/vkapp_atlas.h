@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+// Runtime side of texture atlases, see vkapp_packer.h for the layout.
+// --atlas takes either a .atlas manifest from tools/atlaspack, whose pages
+// are only decoded here, or a plain list of image paths, one per line, that
+// is decoded and packed at startup. Both end up as RGBA8 pages with
+// atlasMipLevels levels, each one image and one bindless slot. The model's
+// texture coordinates are remapped when its texture is one of the entries,
+// and it then draws with its page at set 0 as well as through bindless.
+
+struct TextureAtlas {
+    AtlasLayout layout;
+    JobSystem *pJobSystem;
+    // RGBA8 page and its levels, built by textureAtlasBuildJob and freed once uploaded
+    uint8_t *pagePixels[ATLAS_MAX_PAGES];
+    size_t levelOffsets[KTX2_MAX_LEVELS];
+    uint32_t mipLevels;
+    bool failed;
+    VkImage images[ATLAS_MAX_PAGES];
+    VkDeviceMemory imageMemories[ATLAS_MAX_PAGES];
+    VkImageView imageViews[ATLAS_MAX_PAGES];
+    uint32_t slots[ATLAS_MAX_PAGES];
+    uint64_t uploadedBytes;
+};
+
+// reads the manifest or the list; cheap, so startup knows right away which textures are in the atlas
+bool textureAtlasOpen(TextureAtlas *pAtlas, const char *path, JobSystem *pJobSystem) {
+    memset(pAtlas, 0, sizeof(*pAtlas));
+    pAtlas->pJobSystem = pJobSystem;
+    if (pathHasExtension(path, ".atlas")) {
+        return readAtlasManifest(path, &pAtlas->layout);
+    }
+    FILE *pFile = fopen(path, "r");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open atlas list %s\n", path);
+        return false;
+    }
+    AtlasLayout *pLayout = &pAtlas->layout;
+    pLayout->pageSize = ATLAS_DEFAULT_PAGE_SIZE;
+    pLayout->padding = ATLAS_PADDING;
+    uint32_t entryCapacity = 0;
+    char line[ATLAS_MAX_PATH];
+    while (fgets(line, sizeof(line), pFile) != NULL) {
+        if (!atlasTrimLine(line)) {
+            continue;
+        }
+        if (pLayout->entryCount == entryCapacity) {
+            entryCapacity = entryCapacity == 0 ? 16 : entryCapacity * 2;
+            pLayout->entries = (AtlasEntry *)realloc(pLayout->entries, entryCapacity * sizeof(AtlasEntry));
+        }
+        pLayout->entries[pLayout->entryCount++] = (AtlasEntry){.path = atlasCopyPath(line)};
+    }
+    fclose(pFile);
+    if (pLayout->entryCount == 0) {
+        fprintf(stderr, "ERROR: atlas list %s is empty\n", path);
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    TextureAtlas *pAtlas;
+    // decoded entries of a list, indexed like the layout's entries
+    uint8_t **entryPixels;
+    atomic_bool failed;
+} AtlasBuildData;
+
+void decodeAtlasEntries(void *data, uint32_t begin, uint32_t end) {
+    AtlasBuildData *pData = (AtlasBuildData *)data;
+    AtlasLayout *pLayout = &pData->pAtlas->layout;
+    for (uint32_t i = begin; i < end; i++) {
+        AtlasEntry *pEntry = &pLayout->entries[i];
+        if (pathHasExtension(pEntry->path, ".ktx2")) {
+            // block compressed levels can't be repacked without decoding them
+            fprintf(stderr, "ERROR: %s: only images SDL_image decodes can be packed at startup\n", pEntry->path);
+            atomic_store(&pData->failed, true);
+            continue;
+        }
+        pData->entryPixels[i] = atlasLoadImageRGBA8(pEntry->path, &pEntry->width, &pEntry->height);
+        if (pData->entryPixels[i] == NULL) {
+            atomic_store(&pData->failed, true);
+        } else if (!atlasAccepts(pLayout->pageSize, pLayout->padding, pEntry->width, pEntry->height)) {
+            fprintf(stderr, "ERROR: %s is %ux%u, atlas pages take up to %u texels on either side\n", pEntry->path, pEntry->width, pEntry->height, pLayout->pageSize / 2);
+            atomic_store(&pData->failed, true);
+        }
+    }
+}
+
+void decodeAtlasPages(void *data, uint32_t begin, uint32_t end) {
+    AtlasBuildData *pData = (AtlasBuildData *)data;
+    TextureAtlas *pAtlas = pData->pAtlas;
+    for (uint32_t page = begin; page < end; page++) {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint8_t *pPixels = atlasLoadImageRGBA8(pAtlas->layout.pagePaths[page], &width, &height);
+        if (pPixels == NULL) {
+            atomic_store(&pData->failed, true);
+            continue;
+        }
+        if (width != pAtlas->layout.pageSize || height != pAtlas->layout.pageSize) {
+            fprintf(stderr, "ERROR: atlas page %s is %ux%u, the manifest says %u\n", pAtlas->layout.pagePaths[page], width, height, pAtlas->layout.pageSize);
+            atomic_store(&pData->failed, true);
+        } else {
+            memcpy(pAtlas->pagePixels[page], pPixels, (size_t)width * height * 4);
+        }
+        free(pPixels);
+    }
+}
+
+void buildAtlasPageMips(void *data, uint32_t begin, uint32_t end) {
+    TextureAtlas *pAtlas = ((AtlasBuildData *)data)->pAtlas;
+    uint32_t pageSize = pAtlas->layout.pageSize;
+    size_t offsets[KTX2_MAX_LEVELS];
+    for (uint32_t page = begin; page < end; page++) {
+        buildMipChainRGBA8(pAtlas->pagePixels[page], pageSize, pageSize, pAtlas->mipLevels, true, pAtlas->pagePixels[page], offsets);
+    }
+}
+
+// Decodes (and for a list, packs) the pages on the job system; sets failed if anything went wrong.
+void textureAtlasBuildJob(void *data) {
+    TextureAtlas *pAtlas = (TextureAtlas *)data;
+    AtlasLayout *pLayout = &pAtlas->layout;
+    bool packAtStartup = pLayout->pageCount == 0;
+    AtlasBuildData buildData = {.pAtlas = pAtlas};
+    atomic_init(&buildData.failed, false);
+    JobSystem *pJobSystem = pAtlas->pJobSystem;
+
+    if (packAtStartup) {
+        buildData.entryPixels = (uint8_t **)calloc(pLayout->entryCount, sizeof(uint8_t *));
+        jobSystemParallelFor(pJobSystem, pLayout->entryCount, 1, decodeAtlasEntries, &buildData);
+        if (atomic_load(&buildData.failed) || !atlasPack(pLayout)) {
+            atomic_store(&buildData.failed, true);
+        }
+    }
+    pAtlas->mipLevels = atlasMipLevels(pLayout->padding);
+    size_t pageBytes = mipChainSize(pLayout->pageSize, pLayout->pageSize, pAtlas->mipLevels);
+    for (uint32_t level = 0; level < pAtlas->mipLevels; level++) {
+        pAtlas->levelOffsets[level] = mipChainSize(pLayout->pageSize, pLayout->pageSize, level);
+    }
+    for (uint32_t page = 0; page < pLayout->pageCount && !atomic_load(&buildData.failed); page++) {
+        // calloc so the space between entries stays transparent black
+        pAtlas->pagePixels[page] = (uint8_t *)calloc(1, pageBytes);
+    }
+    if (!atomic_load(&buildData.failed)) {
+        if (packAtStartup) {
+            for (uint32_t i = 0; i < pLayout->entryCount; i++) {
+                const AtlasEntry *pEntry = &pLayout->entries[i];
+                atlasBlitEntry(pAtlas->pagePixels[pEntry->page], pLayout->pageSize, pLayout->padding, pEntry, buildData.entryPixels[i]);
+            }
+        } else {
+            jobSystemParallelFor(pJobSystem, pLayout->pageCount, 1, decodeAtlasPages, &buildData);
+        }
+    }
+    if (!atomic_load(&buildData.failed)) {
+        jobSystemParallelFor(pJobSystem, pLayout->pageCount, 1, buildAtlasPageMips, &buildData);
+    }
+    if (buildData.entryPixels != NULL) {
+        for (uint32_t i = 0; i < pLayout->entryCount; i++) {
+            free(buildData.entryPixels[i]);
+        }
+        free(buildData.entryPixels);
+    }
+    pAtlas->failed = atomic_load(&buildData.failed);
+}
+
+// puts the model into the page holding its texture, a no-op when the texture isn't packed
+void textureAtlasRemapModel(const TextureAtlas *pAtlas, const char *texture, Vertex *pVertices, uint32_t vertexCount) {
+    const AtlasEntry *pEntry = atlasFindEntry(&pAtlas->layout, texture);
+    if (pEntry == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        atlasRemapTexCoord(&pAtlas->layout, pEntry, pVertices[i].texCoord);
+    }
+}
+
+// every page in one submit, each gets its own bindless slot
+void textureAtlasUpload(TextureAtlas *pAtlas, VkSampler sampler, VkApp *pApp) {
+    AtlasLayout *pLayout = &pAtlas->layout;
+    uint32_t pageSize = pLayout->pageSize;
+    VkDeviceSize pageBytes = mipChainSize(pageSize, pageSize, pAtlas->mipLevels);
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    createBuffer(pageBytes * pLayout->pageCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingMemory, pApp);
+    void *pMapped;
+    vkMapMemory(pApp->device, stagingMemory, 0, pageBytes * pLayout->pageCount, 0, &pMapped);
+    for (uint32_t page = 0; page < pLayout->pageCount; page++) {
+        memcpy((uint8_t *)pMapped + page * pageBytes, pAtlas->pagePixels[page], (size_t)pageBytes);
+        free(pAtlas->pagePixels[page]);
+        pAtlas->pagePixels[page] = NULL;
+    }
+    vkUnmapMemory(pApp->device, stagingMemory);
+
+    // one barrier call moves every page in, one moves them all out after the copies
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(pApp);
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pAtlas->mipLevels, 0, 1};
+    BarrierBatch barriers;
+    initBarrierBatch(&barriers, commandBuffer);
+    for (uint32_t page = 0; page < pLayout->pageCount; page++) {
+        createLayeredImage(pageSize, pageSize, pAtlas->mipLevels, 1, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pAtlas->images[page], &pAtlas->imageMemories[page], pApp);
+        barrierBatchImage(&barriers, pAtlas->images[page], range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+    barrierBatchFlush(&barriers);
+
+    for (uint32_t page = 0; page < pLayout->pageCount; page++) {
+        VkBufferImageCopy regions[KTX2_MAX_LEVELS];
+        for (uint32_t level = 0; level < pAtlas->mipLevels; level++) {
+            uint32_t extent = mipLevelExtent(pageSize, level);
+            regions[level] = (VkBufferImageCopy){
+                .bufferOffset = page * pageBytes + pAtlas->levelOffsets[level],
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+                .imageOffset = {0, 0, 0},
+                .imageExtent = {extent, extent, 1}
+            };
+        }
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, pAtlas->images[page], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pAtlas->mipLevels, regions);
+        barrierBatchImage(&barriers, pAtlas->images[page], range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    barrierBatchFlush(&barriers);
+    endSingleTimeCommands(commandBuffer, pApp);
+    vkDestroyBuffer(pApp->device, stagingBuffer, NULL);
+    freeDeviceMemory(stagingMemory, pApp);
+
+    for (uint32_t page = 0; page < pLayout->pageCount; page++) {
+        pAtlas->imageViews[page] = createLayeredImageView(pAtlas->images[page], VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, pAtlas->mipLevels, 1, pApp);
+        pAtlas->slots[page] = bindlessAddTexture(pAtlas->imageViews[page], sampler, pApp);
+    }
+    pAtlas->uploadedBytes = pageBytes * pLayout->pageCount;
+    printf("INFO: atlas: %u textures on %u pages of %u texels, %u levels\n", pLayout->entryCount, pLayout->pageCount, pageSize, pAtlas->mipLevels);
+}
+
+void destroyTextureAtlas(TextureAtlas *pAtlas, VkApp *pApp) {
+    for (uint32_t page = 0; page < pAtlas->layout.pageCount; page++) {
+        bindlessRemoveTexture(pAtlas->slots[page], pApp);
+        vkDestroyImageView(pApp->device, pAtlas->imageViews[page], NULL);
+        vkDestroyImage(pApp->device, pAtlas->images[page], NULL);
+        freeDeviceMemory(pAtlas->imageMemories[page], pApp);
+        free(pAtlas->pagePixels[page]);
+    }
+    freeAtlasLayout(&pAtlas->layout);
+}
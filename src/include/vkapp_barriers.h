@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Barrier batching. Barriers are collected in a BarrierBatch instead of being
+// recorded one vkCmdPipelineBarrier each, and go into the command buffer as a
+// single call when the batch is flushed: the stage masks of everything in it
+// are merged, image barriers for the same subresources and layouts are merged
+// into one, and every buffer and global memory barrier rides along. Flush
+// right before the first command that depends on what was added; anything
+// not needed until later can stay in the batch and share the next call.
+// Batches live on the stack or next to the command buffer they record into.
+// The device only has to support Vulkan 1.0, so this uses the original
+// vkCmdPipelineBarrier rather than synchronization2.
+
+#define BARRIER_BATCH_MAX_IMAGES 32
+#define BARRIER_BATCH_MAX_BUFFERS 16
+
+typedef struct {
+    VkCommandBuffer commandBuffer;
+    VkPipelineStageFlags srcStages;
+    VkPipelineStageFlags dstStages;
+    VkMemoryBarrier memory;
+    VkImageMemoryBarrier images[BARRIER_BATCH_MAX_IMAGES];
+    uint32_t imageCount;
+    VkBufferMemoryBarrier buffers[BARRIER_BATCH_MAX_BUFFERS];
+    uint32_t bufferCount;
+    // vkCmdPipelineBarrier calls made, and the barriers they carried
+    uint64_t flushCount;
+    uint64_t barrierCount;
+} BarrierBatch;
+
+void initBarrierBatch(BarrierBatch *pBatch, VkCommandBuffer commandBuffer) {
+    memset(pBatch, 0, sizeof(*pBatch));
+    pBatch->commandBuffer = commandBuffer;
+    pBatch->memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+}
+
+// a barrier added with no stages still has to be recorded, so it counts too
+bool barrierBatchEmpty(const BarrierBatch *pBatch) {
+    return pBatch->imageCount == 0 && pBatch->bufferCount == 0 && pBatch->memory.srcAccessMask == 0 && pBatch->memory.dstAccessMask == 0 &&
+           pBatch->srcStages == 0 && pBatch->dstStages == 0;
+}
+
+// records everything added so far as one vkCmdPipelineBarrier
+void barrierBatchFlush(BarrierBatch *pBatch) {
+    if (barrierBatchEmpty(pBatch)) {
+        return;
+    }
+    bool hasMemory = pBatch->memory.srcAccessMask != 0 || pBatch->memory.dstAccessMask != 0;
+    vkCmdPipelineBarrier(pBatch->commandBuffer, pBatch->srcStages != 0 ? pBatch->srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         pBatch->dstStages != 0 ? pBatch->dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         hasMemory ? 1 : 0, &pBatch->memory, pBatch->bufferCount, pBatch->buffers, pBatch->imageCount, pBatch->images);
+    pBatch->flushCount++;
+    pBatch->barrierCount += (hasMemory ? 1 : 0) + pBatch->bufferCount + pBatch->imageCount;
+    pBatch->srcStages = 0;
+    pBatch->dstStages = 0;
+    pBatch->memory.srcAccessMask = 0;
+    pBatch->memory.dstAccessMask = 0;
+    pBatch->imageCount = 0;
+    pBatch->bufferCount = 0;
+}
+
+// an execution and memory dependency for no resource in particular
+void barrierBatchMemory(BarrierBatch *pBatch, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+    pBatch->srcStages |= srcStages;
+    pBatch->dstStages |= dstStages;
+    pBatch->memory.srcAccessMask |= srcAccess;
+    pBatch->memory.dstAccessMask |= dstAccess;
+}
+
+void barrierBatchImage(BarrierBatch *pBatch, VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout, VkImageLayout newLayout,
+                       VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+    for (uint32_t i = 0; i < pBatch->imageCount; i++) {
+        VkImageMemoryBarrier *pBarrier = &pBatch->images[i];
+        if (pBarrier->image == image && pBarrier->oldLayout == oldLayout && pBarrier->newLayout == newLayout &&
+            memcmp(&pBarrier->subresourceRange, &range, sizeof(range)) == 0) {
+            pBarrier->srcAccessMask |= srcAccess;
+            pBarrier->dstAccessMask |= dstAccess;
+            pBatch->srcStages |= srcStages;
+            pBatch->dstStages |= dstStages;
+            return;
+        }
+    }
+    if (pBatch->imageCount == BARRIER_BATCH_MAX_IMAGES) {
+        barrierBatchFlush(pBatch);
+    }
+    pBatch->images[pBatch->imageCount++] = (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range
+    };
+    pBatch->srcStages |= srcStages;
+    pBatch->dstStages |= dstStages;
+}
+
+void barrierBatchBuffer(BarrierBatch *pBatch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                        VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+    for (uint32_t i = 0; i < pBatch->bufferCount; i++) {
+        VkBufferMemoryBarrier *pBarrier = &pBatch->buffers[i];
+        if (pBarrier->buffer == buffer && pBarrier->offset == offset && pBarrier->size == size) {
+            pBarrier->srcAccessMask |= srcAccess;
+            pBarrier->dstAccessMask |= dstAccess;
+            pBatch->srcStages |= srcStages;
+            pBatch->dstStages |= dstStages;
+            return;
+        }
+    }
+    if (pBatch->bufferCount == BARRIER_BATCH_MAX_BUFFERS) {
+        barrierBatchFlush(pBatch);
+    }
+    pBatch->buffers[pBatch->bufferCount++] = (VkBufferMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size
+    };
+    pBatch->srcStages |= srcStages;
+    pBatch->dstStages |= dstStages;
+}
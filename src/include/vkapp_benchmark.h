@@ -0,0 +1,84 @@
+#include <sys/resource.h>
+
+// Results of a --benchmark run, written once the render thread has stopped.
+// Frame times only cover the frames after the warmup, startup numbers come
+// from the startup timer, and GPU markers from the timestamp profiler's
+// rolling window over the last frames of the run.
+
+void writeBenchmarkHistogram(FILE *pFile, const char *name, const FrameHistogram *histogram) {
+    if (histogram->total == 0) {
+        fprintf(pFile, "    \"%s\": null,\n", name);
+        return;
+    }
+    fprintf(pFile, "    \"%s\": {\"count\": %llu, \"avg_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"p999_ms\": %.4f, \"max_ms\": %.4f},\n",
+            name, (unsigned long long)histogram->total, histogram->sumUs / (double)histogram->total / 1000.0,
+            frameHistogramPercentile(histogram, 50.0), frameHistogramPercentile(histogram, 90.0),
+            frameHistogramPercentile(histogram, 99.0), frameHistogramPercentile(histogram, 99.9),
+            (double)histogram->maxUs / 1000.0);
+}
+
+bool app_writeBenchmarkReport(VkApp *pApp) {
+    FILE *pFile = fopen(pApp->benchmarkOutputPath, "w");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open benchmark output: %s\n", pApp->benchmarkOutputPath);
+        return false;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "  \"device\": \"%s\",\n", pApp->deviceProperties.deviceName);
+    fprintf(pFile, "  \"frames\": %u,\n", pApp->benchmarkFrames);
+    fprintf(pFile, "  \"warmup_frames\": %u,\n", pApp->benchmarkWarmupFrames);
+    fprintf(pFile, "  \"timestep_s\": %.6f,\n", BENCHMARK_TIMESTEP);
+    fprintf(pFile, "  \"extent\": [%u, %u],\n", pApp->swapChainExtent.width, pApp->swapChainExtent.height);
+    fprintf(pFile, "  \"headless\": %s,\n", pApp->headless ? "true" : "false");
+    fprintf(pFile, "  \"offscreen\": %s,\n", pApp->surface == VK_NULL_HANDLE ? "true" : "false");
+    fprintf(pFile, "  \"uncapped_present\": %s,\n", pApp->uncappedPresent ? "true" : "false");
+    fprintf(pFile, "  \"msaa_samples\": %u,\n", (uint32_t)pApp->msaaSamples);
+
+    uint64_t firstFrame = atomic_load(&pApp->startupTimer.firstFrame);
+    fprintf(pFile, "  \"startup\": {\"time_to_first_frame_ms\": ");
+    if (firstFrame != 0) {
+        fprintf(pFile, "%.3f", startupTimerMs(&pApp->startupTimer, firstFrame));
+    } else {
+        fprintf(pFile, "null");
+    }
+    uint32_t phaseCount = atomic_load(&pApp->startupTimer.phaseCount);
+    for (uint32_t i = 0; i < phaseCount && i < MAX_STARTUP_PHASES; i++) {
+        const StartupPhase *phase = &pApp->startupTimer.phases[i];
+        if (strcmp(phase->name, "init_vulkan") == 0 && phase->end != 0) {
+            fprintf(pFile, ", \"init_vulkan_ms\": %.3f", startupTimerMs(&pApp->startupTimer, phase->end) - startupTimerMs(&pApp->startupTimer, phase->start));
+        }
+    }
+    fprintf(pFile, "},\n");
+
+    SDL_LockMutex(pApp->frameStats.lock);
+    fprintf(pFile, "  \"frame_stats\": {\n");
+    for (int i = 0; i < FRAME_METRIC_COUNT; i++) {
+        writeBenchmarkHistogram(pFile, frameMetricNames[i], &pApp->frameStats.histograms[i]);
+    }
+    fprintf(pFile, "    \"stutters\": %llu\n", (unsigned long long)pApp->frameStats.stutterCount);
+    fprintf(pFile, "  },\n");
+    SDL_UnlockMutex(pApp->frameStats.lock);
+
+    fprintf(pFile, "  \"gpu_markers\": {");
+    bool first = true;
+    for (uint32_t i = 0; i < pApp->gpuProfiler.markerCount; i++) {
+        double min, avg, p99;
+        if (gpuMarkerSummary(&pApp->gpuProfiler.markers[i], &min, &avg, &p99)) {
+            fprintf(pFile, "%s\n    \"%s\": {\"min_ms\": %.4f, \"avg_ms\": %.4f, \"p99_ms\": %.4f}", first ? "" : ",", pApp->gpuProfiler.markers[i].name, min, avg, p99);
+            first = false;
+        }
+    }
+    fprintf(pFile, "%s},\n", first ? "" : "\n  ");
+
+    SDL_LockMutex(pApp->deviceMemory.lock);
+    fprintf(pFile, "  \"memory\": {\"device_live_bytes\": %llu, \"device_peak_bytes\": %llu, \"peak_rss_kb\": %ld}\n",
+            (unsigned long long)pApp->deviceMemory.liveBytes, (unsigned long long)pApp->deviceMemory.peakBytes, usage.ru_maxrss);
+    SDL_UnlockMutex(pApp->deviceMemory.lock);
+    fprintf(pFile, "}\n");
+    fclose(pFile);
+    printf("INFO: wrote benchmark results to %s\n", pApp->benchmarkOutputPath);
+    return true;
+}
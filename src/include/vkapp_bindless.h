@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bindless textures. With VK_EXT_descriptor_indexing every texture lives in
+// one partially bound combined image sampler array, bound once as set 1, and
+// a draw picks its material with a pushed index instead of a descriptor set
+// of its own. The binding is update after bind and update unused while
+// pending, so textures can be added to free slots while command buffers using
+// the set are in flight; a slot must not be rewritten or removed while a frame
+// may still sample it. Binding 1 is the mip feedback buffer the fragment
+// shader writes for texture streaming. Without the extension the app keeps
+// drawing with the single texture at set 0, binding 1.
+
+void createBindlessTextures(VkApp *pApp) {
+    BindlessTextures *pBindless = &pApp->bindless;
+    if (!pBindless->supported) {
+        printf("INFO: descriptor indexing unavailable, drawing with the single texture binding\n");
+        return;
+    }
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = BINDLESS_MAX_TEXTURES,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = NULL
+        }
+    };
+    VkDescriptorBindingFlagsEXT bindingFlags[] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+        0
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        .pNext = NULL,
+        .bindingCount = 2,
+        .pBindingFlags = bindingFlags
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        .bindingCount = 2,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(pApp->device, &layoutInfo, NULL, &pBindless->setLayout) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create bindless descriptor set layout!\n");
+        exit(1);
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = BINDLESS_MAX_TEXTURES},
+        {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1}
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        .maxSets = 1,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(pApp->device, &poolInfo, NULL, &pBindless->pool) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create bindless descriptor pool!\n");
+        exit(1);
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = pBindless->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &pBindless->setLayout
+    };
+    if (vkAllocateDescriptorSets(pApp->device, &allocInfo, &pBindless->set) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to allocate the bindless descriptor set!\n");
+        exit(1);
+    }
+    pBindless->textureCount = 0;
+    pBindless->freeSlotCount = 0;
+
+    // host visible so the streamer reads it right after the frame's fence, nothing else uses it
+    VkDeviceSize feedbackSize = (VkDeviceSize)MAX_FRAMES_IN_FLIGHT * BINDLESS_MAX_TEXTURES * sizeof(uint32_t);
+    createBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pBindless->feedbackBuffer, &pBindless->feedbackMemory, pApp);
+    void *pMapped;
+    vkMapMemory(pApp->device, pBindless->feedbackMemory, 0, feedbackSize, 0, &pMapped);
+    pBindless->feedback = (uint32_t *)pMapped;
+    memset(pBindless->feedback, 0xFF, (size_t)feedbackSize);
+    VkDescriptorBufferInfo feedbackInfo = {
+        .buffer = pBindless->feedbackBuffer,
+        .offset = 0,
+        .range = feedbackSize
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = pBindless->set,
+        .dstBinding = 1,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pImageInfo = NULL,
+        .pBufferInfo = &feedbackInfo,
+        .pTexelBufferView = NULL
+    };
+    vkUpdateDescriptorSets(pApp->device, 1, &write, 0, NULL);
+}
+
+// writes the texture into a free slot and returns the index draws push to sample it,
+// always 0 without bindless support
+uint32_t bindlessAddTexture(VkImageView imageView, VkSampler sampler, VkApp *pApp) {
+    BindlessTextures *pBindless = &pApp->bindless;
+    if (!pBindless->supported) {
+        return 0;
+    }
+    uint32_t index;
+    if (pBindless->freeSlotCount > 0) {
+        index = pBindless->freeSlots[--pBindless->freeSlotCount];
+    } else if (pBindless->textureCount < BINDLESS_MAX_TEXTURES) {
+        index = pBindless->textureCount++;
+    } else {
+        fprintf(stderr, "ERROR: bindless texture array is full (%u textures)\n", BINDLESS_MAX_TEXTURES);
+        exit(1);
+    }
+    VkDescriptorImageInfo imageInfo = {
+        .sampler = sampler,
+        .imageView = imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = pBindless->set,
+        .dstBinding = 0,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = NULL,
+        .pTexelBufferView = NULL
+    };
+    vkUpdateDescriptorSets(pApp->device, 1, &write, 0, NULL);
+    return index;
+}
+
+// the slot is left as it is until it is handed out again, no frame may still sample it
+void bindlessRemoveTexture(uint32_t index, VkApp *pApp) {
+    BindlessTextures *pBindless = &pApp->bindless;
+    if (!pBindless->supported) {
+        return;
+    }
+    pBindless->freeSlots[pBindless->freeSlotCount++] = index;
+}
+
+void destroyBindlessTextures(VkApp *pApp) {
+    if (!pApp->bindless.supported) {
+        return;
+    }
+    vkUnmapMemory(pApp->device, pApp->bindless.feedbackMemory);
+    vkDestroyBuffer(pApp->device, pApp->bindless.feedbackBuffer, NULL);
+    freeDeviceMemory(pApp->bindless.feedbackMemory, pApp);
+    // frees the set along with the pool
+    vkDestroyDescriptorPool(pApp->device, pApp->bindless.pool, NULL);
+    vkDestroyDescriptorSetLayout(pApp->device, pApp->bindless.setLayout, NULL);
+}
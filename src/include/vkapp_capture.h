@@ -0,0 +1,229 @@
+// Asynchronous frame capture. A captured frame's command buffer also copies
+// the color target into one of CAPTURE_RING_SIZE host visible buffers. The
+// buffer is only read once that frame's fence has signalled (the render
+// thread waits on it anyway before reusing the frame slot), and encoding to
+// PNG or raw bytes happens on a job thread. If every buffer is still busy the
+// frame is dropped from the capture instead of stalling rendering.
+
+uint32_t findReadbackMemoryType(uint32_t typeFilter, VkPhysicalDevice physicalDevice, bool *pCoherent) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    // cached memory makes the CPU reads fast, coherent saves the invalidate
+    VkMemoryPropertyFlags preferences[] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    };
+    for (uint32_t p = 0; p < sizeof(preferences) / sizeof(preferences[0]); p++) {
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & preferences[p]) == preferences[p]) {
+                *pCoherent = (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+                return i;
+            }
+        }
+    }
+    fprintf(stderr, "ERROR: failed to find host visible memory for readback!\n");
+    exit(1);
+}
+
+// persistently mapped buffer the GPU copies into and the CPU reads back from
+void createReadbackBuffer(VkDeviceSize size, VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory, void **ppMapped, bool *pCoherent, VkApp *pApp) {
+    VkBufferCreateInfo bufferInfo = {0};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(pApp->device, &bufferInfo, NULL, pBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create readback buffer!\n");
+        exit(1);
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(pApp->device, *pBuffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findReadbackMemoryType(memRequirements.memoryTypeBits, pApp->physicalDevice, pCoherent);
+    if (allocateDeviceMemory(&allocInfo, pBufferMemory, pApp) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to allocate readback buffer memory!\n");
+        exit(1);
+    }
+    vkBindBufferMemory(pApp->device, *pBuffer, *pBufferMemory, 0);
+    vkMapMemory(pApp->device, *pBufferMemory, 0, VK_WHOLE_SIZE, 0, ppMapped);
+}
+
+// makes GPU writes visible to the mapping, only needed for non-coherent memory
+void invalidateReadbackMemory(VkDeviceMemory memory, bool coherent, VkApp *pApp) {
+    if (coherent) {
+        return;
+    }
+    VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext = NULL,
+        .memory = memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkInvalidateMappedMemoryRanges(pApp->device, 1, &range);
+}
+
+// sized for the current swapchain extent, render thread only
+void createCaptureRing(VkApp *pApp) {
+    CaptureRing *ring = &pApp->capture;
+    VkDeviceSize size = (VkDeviceSize)pApp->swapChainExtent.width * pApp->swapChainExtent.height * 4;
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+        CaptureSlot *slot = &ring->slots[i];
+        createReadbackBuffer(size, &slot->buffer, &slot->memory, &slot->mapped, &slot->coherent, pApp);
+        slot->extent = pApp->swapChainExtent;
+        slot->format = pApp->swapChainImageFormat;
+        atomic_init(&slot->state, CAPTURE_SLOT_FREE);
+        initJobCounter(&slot->encoded);
+    }
+    ring->recordSlot = NO_CAPTURE_SLOT;
+    ring->created = true;
+}
+
+void captureEncodeJob(void *data) {
+    CaptureSlot *slot = (CaptureSlot *)data;
+    char path[MAX_CAPTURE_PATH];
+    snprintf(path, sizeof(path), "%s/frame_%06llu.%s", slot->directory, (unsigned long long)slot->frameIndex, slot->raw ? "raw" : "png");
+    size_t size = (size_t)slot->extent.width * slot->extent.height * 4;
+
+    if (slot->raw) {
+        FILE *pFile = fopen(path, "wb");
+        if (pFile == NULL || fwrite(slot->mapped, 1, size, pFile) != size) {
+            fprintf(stderr, "ERROR: unable to write capture: %s\n", path);
+        }
+        if (pFile != NULL) {
+            fclose(pFile);
+        }
+    } else {
+        // byte order in memory matches the Vulkan format name
+        Uint32 pixelFormat = slot->format == VK_FORMAT_B8G8R8A8_SRGB || slot->format == VK_FORMAT_B8G8R8A8_UNORM ? SDL_PIXELFORMAT_BGRA32 : SDL_PIXELFORMAT_RGBA32;
+        SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(slot->mapped, (int)slot->extent.width, (int)slot->extent.height, 32, (int)slot->extent.width * 4, pixelFormat);
+        if (surface == NULL || IMG_SavePNG(surface, path) != 0) {
+            fprintf(stderr, "ERROR: unable to write capture: %s: %s\n", path, SDL_GetError());
+        }
+        SDL_FreeSurface(surface);
+    }
+    atomic_store(&slot->state, CAPTURE_SLOT_FREE);
+}
+
+// The caller idles the device first, so copies still marked in flight are
+// complete and get encoded right here instead of being lost.
+void destroyCaptureRing(VkApp *pApp) {
+    CaptureRing *ring = &pApp->capture;
+    if (!ring->created) {
+        return;
+    }
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+        CaptureSlot *slot = &ring->slots[i];
+        jobSystemWait(&pApp->jobSystem, &slot->encoded);
+        if (atomic_load(&slot->state) == CAPTURE_SLOT_IN_FLIGHT) {
+            invalidateReadbackMemory(slot->memory, slot->coherent, pApp);
+            captureEncodeJob(slot);
+            ring->capturedCount++;
+        }
+        vkUnmapMemory(pApp->device, slot->memory);
+        vkDestroyBuffer(pApp->device, slot->buffer, NULL);
+        freeDeviceMemory(slot->memory, pApp);
+    }
+    ring->recordSlot = NO_CAPTURE_SLOT;
+    ring->created = false;
+}
+
+// Called on the render thread once the current frame's fence has been waited
+// on and an image acquired: hands finished copies to the encoder and picks a
+// slot for this frame.
+void captureBeginFrame(VkApp *pApp, uint64_t frameIndex) {
+    CaptureRing *ring = &pApp->capture;
+    bool wanted = atomic_exchange(&ring->requested, false) || ring->everyFrame;
+    if (wanted && !ring->supported) {
+        fprintf(stderr, "ERROR: swapchain images cannot be copied from, capture disabled\n");
+        ring->everyFrame = false;
+        return;
+    }
+    if (!ring->created && !wanted) {
+        return;
+    }
+    if (!ring->created) {
+        createCaptureRing(pApp);
+    }
+
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+        CaptureSlot *slot = &ring->slots[i];
+        if (atomic_load(&slot->state) != CAPTURE_SLOT_IN_FLIGHT || slot->frameSlot != pApp->currentFrame) {
+            continue;
+        }
+        invalidateReadbackMemory(slot->memory, slot->coherent, pApp);
+        atomic_store(&slot->state, CAPTURE_SLOT_ENCODING);
+        jobSystemRun(&pApp->jobSystem, captureEncodeJob, slot, &slot->encoded);
+        ring->capturedCount++;
+    }
+
+    ring->recordSlot = NO_CAPTURE_SLOT;
+    if (!wanted) {
+        return;
+    }
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; i++) {
+        CaptureSlot *slot = &ring->slots[i];
+        if (atomic_load(&slot->state) == CAPTURE_SLOT_FREE) {
+            slot->frameSlot = pApp->currentFrame;
+            slot->frameIndex = frameIndex;
+            slot->raw = ring->raw;
+            slot->directory = ring->directory;
+            ring->recordSlot = i;
+            return;
+        }
+    }
+    // encoder is behind, skip this frame rather than wait
+    ring->droppedCount++;
+}
+
+// the graph has the backbuffer in TRANSFER_SRC_OPTIMAL and makes the copy visible to the host after it
+void captureRecordCopy(VkApp *pApp, VkCommandBuffer commandBuffer, void *data) {
+    CaptureRing *ring = &pApp->capture;
+    CaptureSlot *slot = &ring->slots[ring->recordSlot];
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = (VkExtent3D){slot->extent.width, slot->extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, pApp->swapChainImages[ring->recordImageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+}
+
+// copies the finished backbuffer into the slot captureBeginFrame picked, if it picked one
+void captureAddPass(VkApp *pApp, RenderGraph *pGraph, uint32_t backbuffer, uint32_t imageIndex) {
+    CaptureRing *ring = &pApp->capture;
+    if (ring->recordSlot == NO_CAPTURE_SLOT) {
+        return;
+    }
+    // the host was done with the slot before it went back to the ring
+    RenderGraphState released = {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0};
+    RenderGraphState readable = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT};
+    uint32_t buffer = renderGraphImportBuffer(pGraph, "capture", ring->slots[ring->recordSlot].buffer, released, readable);
+    ring->recordImageIndex = imageIndex;
+    uint32_t pass = renderGraphAddPass(pGraph, "capture_copy", captureRecordCopy, NULL);
+    renderGraphUse(pGraph, pass, backbuffer, RENDER_GRAPH_TRANSFER_SRC);
+    renderGraphUse(pGraph, pass, buffer, RENDER_GRAPH_TRANSFER_DST);
+}
+
+// the command buffer holding the copy was submitted
+void captureSubmitted(VkApp *pApp) {
+    CaptureRing *ring = &pApp->capture;
+    if (ring->recordSlot == NO_CAPTURE_SLOT) {
+        return;
+    }
+    atomic_store(&ring->slots[ring->recordSlot].state, CAPTURE_SLOT_IN_FLIGHT);
+    ring->recordSlot = NO_CAPTURE_SLOT;
+}
+
+void captureReport(VkApp *pApp, FILE *pFile) {
+    if (pApp->capture.capturedCount > 0 || pApp->capture.droppedCount > 0) {
+        fprintf(pFile, "INFO: captured %llu frames, dropped %llu\n", (unsigned long long)pApp->capture.capturedCount, (unsigned long long)pApp->capture.droppedCount);
+    }
+}
@@ -0,0 +1,280 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Descriptor allocation. A DescriptorAllocator hands out sets from a chain of
+// pools: when the current one runs out it moves on to the next, creating it
+// with twice the sets of the last, and a reset gives every pool back in one
+// vkResetDescriptorPool each instead of freeing sets one by one. Pools are
+// sized by DESCRIPTOR_POOL_RATIOS per set, so any mix of the common layouts
+// fits without knowing them up front.
+//
+// The DescriptorCache sits on top for sets that live until shutdown: a set is
+// looked up by its layout and the exact resources written into it, and only
+// allocated and written the first time. Anything drawing with the same
+// buffers and textures gets the same set. Keys hold raw handles, and a
+// destroyed handle's value can come back for a new object, so whatever a
+// cached set was written with must either outlive the cache or be passed to
+// descriptorCacheEvict before it is destroyed. Neither is thread safe.
+
+#define DESCRIPTOR_INITIAL_POOL_SETS 64
+#define DESCRIPTOR_MAX_POOL_SETS 4096
+#define DESCRIPTOR_CACHE_INITIAL_CAPACITY 64
+
+typedef struct {
+    VkDescriptorType type;
+    // descriptors of the type per set
+    uint32_t ratio;
+} DescriptorPoolRatio;
+
+const DescriptorPoolRatio DESCRIPTOR_POOL_RATIOS[] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1}
+};
+#define DESCRIPTOR_POOL_RATIO_COUNT (sizeof(DESCRIPTOR_POOL_RATIOS) / sizeof(DESCRIPTOR_POOL_RATIOS[0]))
+
+void initDescriptorAllocator(DescriptorAllocator *pAllocator) {
+    memset(pAllocator, 0, sizeof(*pAllocator));
+    pAllocator->setsPerPool = DESCRIPTOR_INITIAL_POOL_SETS;
+}
+
+void descriptorAllocatorAddPool(DescriptorAllocator *pAllocator, VkApp *pApp) {
+    if (pAllocator->poolCount == DESCRIPTOR_MAX_POOLS) {
+        fprintf(stderr, "ERROR: descriptor allocator is out of pools (%u)\n", DESCRIPTOR_MAX_POOLS);
+        exit(1);
+    }
+    VkDescriptorPoolSize poolSizes[DESCRIPTOR_POOL_RATIO_COUNT];
+    for (uint32_t i = 0; i < DESCRIPTOR_POOL_RATIO_COUNT; i++) {
+        poolSizes[i].type = DESCRIPTOR_POOL_RATIOS[i].type;
+        poolSizes[i].descriptorCount = DESCRIPTOR_POOL_RATIOS[i].ratio * pAllocator->setsPerPool;
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = pAllocator->setsPerPool,
+        .poolSizeCount = DESCRIPTOR_POOL_RATIO_COUNT,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(pApp->device, &poolInfo, NULL, &pAllocator->pools[pAllocator->poolCount]) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create descriptor pool!\n");
+        exit(1);
+    }
+    pAllocator->poolCount++;
+    if (pAllocator->setsPerPool < DESCRIPTOR_MAX_POOL_SETS) {
+        pAllocator->setsPerPool *= 2;
+    }
+}
+
+VkDescriptorSet descriptorAllocatorAllocate(DescriptorAllocator *pAllocator, VkDescriptorSetLayout layout, VkApp *pApp) {
+    while (true) {
+        bool newPool = pAllocator->currentPool == pAllocator->poolCount;
+        if (newPool) {
+            descriptorAllocatorAddPool(pAllocator, pApp);
+        }
+        VkDescriptorSetAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = NULL,
+            .descriptorPool = pAllocator->pools[pAllocator->currentPool],
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout
+        };
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(pApp->device, &allocInfo, &set);
+        if (result == VK_SUCCESS) {
+            pAllocator->allocatedSets++;
+            return set;
+        }
+        // an empty pool that can't take the set never will, the layout needs more than the ratios give
+        if (newPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+            fprintf(stderr, "ERROR: failed to allocate descriptor set: %d\n", result);
+            exit(1);
+        }
+        // full until the next reset
+        pAllocator->currentPool++;
+    }
+}
+
+// every set allocated so far becomes invalid; no command buffer using them may still be pending
+void descriptorAllocatorReset(DescriptorAllocator *pAllocator, VkApp *pApp) {
+    for (uint32_t i = 0; i < pAllocator->poolCount && i <= pAllocator->currentPool; i++) {
+        vkResetDescriptorPool(pApp->device, pAllocator->pools[i], 0);
+    }
+    pAllocator->currentPool = 0;
+}
+
+void destroyDescriptorAllocator(DescriptorAllocator *pAllocator, VkApp *pApp) {
+    for (uint32_t i = 0; i < pAllocator->poolCount; i++) {
+        vkDestroyDescriptorPool(pApp->device, pAllocator->pools[i], NULL);
+    }
+    pAllocator->poolCount = 0;
+    pAllocator->currentPool = 0;
+}
+
+void descriptorSetKeyInit(DescriptorSetKey *pKey, VkDescriptorSetLayout layout) {
+    memset(pKey, 0, sizeof(*pKey));
+    pKey->layout = layout;
+}
+
+DescriptorBinding *descriptorSetKeyAdd(DescriptorSetKey *pKey, uint32_t binding, VkDescriptorType type) {
+    if (pKey->bindingCount == DESCRIPTOR_MAX_BINDINGS) {
+        fprintf(stderr, "ERROR: descriptor set key is full (%u bindings)\n", DESCRIPTOR_MAX_BINDINGS);
+        exit(1);
+    }
+    DescriptorBinding *pBinding = &pKey->bindings[pKey->bindingCount++];
+    pBinding->binding = binding;
+    pBinding->type = type;
+    return pBinding;
+}
+
+void descriptorSetKeyBuffer(DescriptorSetKey *pKey, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    DescriptorBinding *pBinding = descriptorSetKeyAdd(pKey, binding, type);
+    pBinding->buffer = buffer;
+    pBinding->offset = offset;
+    pBinding->range = range;
+}
+
+void descriptorSetKeyImage(DescriptorSetKey *pKey, uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout) {
+    DescriptorBinding *pBinding = descriptorSetKeyAdd(pKey, binding, type);
+    pBinding->imageView = imageView;
+    pBinding->sampler = sampler;
+    pBinding->imageLayout = imageLayout;
+}
+
+// every binding of the key in one vkUpdateDescriptorSets
+void writeDescriptorSetKey(VkDescriptorSet set, const DescriptorSetKey *pKey, VkApp *pApp) {
+    VkWriteDescriptorSet writes[DESCRIPTOR_MAX_BINDINGS];
+    VkDescriptorBufferInfo bufferInfos[DESCRIPTOR_MAX_BINDINGS];
+    VkDescriptorImageInfo imageInfos[DESCRIPTOR_MAX_BINDINGS];
+    for (uint32_t i = 0; i < pKey->bindingCount; i++) {
+        const DescriptorBinding *pBinding = &pKey->bindings[i];
+        bool isBuffer = pBinding->buffer != VK_NULL_HANDLE;
+        bufferInfos[i] = (VkDescriptorBufferInfo){pBinding->buffer, pBinding->offset, pBinding->range};
+        imageInfos[i] = (VkDescriptorImageInfo){pBinding->sampler, pBinding->imageView, pBinding->imageLayout};
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = NULL,
+            .dstSet = set,
+            .dstBinding = pBinding->binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = pBinding->type,
+            .pImageInfo = isBuffer ? NULL : &imageInfos[i],
+            .pBufferInfo = isBuffer ? &bufferInfos[i] : NULL,
+            .pTexelBufferView = NULL
+        };
+    }
+    vkUpdateDescriptorSets(pApp->device, pKey->bindingCount, writes, 0, NULL);
+}
+
+// FNV-1a over the whole key, which descriptorSetKeyInit zeroed padding included
+uint64_t hashDescriptorSetKey(const DescriptorSetKey *pKey) {
+    const uint8_t *pBytes = (const uint8_t *)pKey;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(*pKey); i++) {
+        hash = (hash ^ pBytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void initDescriptorCache(DescriptorCache *pCache) {
+    initDescriptorAllocator(&pCache->allocator);
+    pCache->capacity = DESCRIPTOR_CACHE_INITIAL_CAPACITY;
+    pCache->entries = (DescriptorCacheEntry *)calloc(pCache->capacity, sizeof(DescriptorCacheEntry));
+    pCache->count = 0;
+    pCache->hits = 0;
+    pCache->misses = 0;
+}
+
+DescriptorCacheEntry *descriptorCacheFind(DescriptorCacheEntry *entries, uint32_t capacity, uint64_t hash, const DescriptorSetKey *pKey) {
+    for (uint32_t i = (uint32_t)hash & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        DescriptorCacheEntry *pEntry = &entries[i];
+        if (pEntry->set == VK_NULL_HANDLE || (pEntry->hash == hash && memcmp(&pEntry->key, pKey, sizeof(*pKey)) == 0)) {
+            return pEntry;
+        }
+    }
+}
+
+void descriptorCacheGrow(DescriptorCache *pCache) {
+    uint32_t capacity = pCache->capacity * 2;
+    DescriptorCacheEntry *entries = (DescriptorCacheEntry *)calloc(capacity, sizeof(DescriptorCacheEntry));
+    for (uint32_t i = 0; i < pCache->capacity; i++) {
+        if (pCache->entries[i].set != VK_NULL_HANDLE) {
+            *descriptorCacheFind(entries, capacity, pCache->entries[i].hash, &pCache->entries[i].key) = pCache->entries[i];
+        }
+    }
+    free(pCache->entries);
+    pCache->entries = entries;
+    pCache->capacity = capacity;
+}
+
+// the set for exactly these descriptors, allocated and written on first use
+VkDescriptorSet descriptorCacheGet(DescriptorCache *pCache, const DescriptorSetKey *pKey, VkApp *pApp) {
+    uint64_t hash = hashDescriptorSetKey(pKey);
+    DescriptorCacheEntry *pEntry = descriptorCacheFind(pCache->entries, pCache->capacity, hash, pKey);
+    if (pEntry->set != VK_NULL_HANDLE) {
+        pCache->hits++;
+        return pEntry->set;
+    }
+    pCache->misses++;
+    if ((pCache->count + 1) * 4 > pCache->capacity * 3) {
+        descriptorCacheGrow(pCache);
+        pEntry = descriptorCacheFind(pCache->entries, pCache->capacity, hash, pKey);
+    }
+    VkDescriptorSet set = descriptorAllocatorAllocate(&pCache->allocator, pKey->layout, pApp);
+    writeDescriptorSetKey(set, pKey, pApp);
+    pEntry->hash = hash;
+    pEntry->key = *pKey;
+    pEntry->set = set;
+    pCache->count++;
+    return set;
+}
+
+bool descriptorSetKeyUses(const DescriptorSetKey *pKey, VkBuffer buffer, VkImageView imageView, VkSampler sampler) {
+    for (uint32_t i = 0; i < pKey->bindingCount; i++) {
+        const DescriptorBinding *pBinding = &pKey->bindings[i];
+        if ((buffer != VK_NULL_HANDLE && pBinding->buffer == buffer) || (imageView != VK_NULL_HANDLE && pBinding->imageView == imageView) ||
+            (sampler != VK_NULL_HANDLE && pBinding->sampler == sampler)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Forgets every set written with any of the given handles, VK_NULL_HANDLE
+// matching nothing; call it before destroying them. The pools have no
+// FREE_DESCRIPTOR_SET_BIT, so the sets themselves stay allocated until the
+// cache is destroyed, and no pending command buffer may still use them.
+void descriptorCacheEvict(DescriptorCache *pCache, VkBuffer buffer, VkImageView imageView, VkSampler sampler) {
+    DescriptorCacheEntry *entries = (DescriptorCacheEntry *)calloc(pCache->capacity, sizeof(DescriptorCacheEntry));
+    if (entries == NULL) {
+        fprintf(stderr, "ERROR: out of memory evicting descriptor sets\n");
+        exit(1);
+    }
+    // rebuilt rather than deleted in place, which open addressing doesn't allow
+    pCache->count = 0;
+    for (uint32_t i = 0; i < pCache->capacity; i++) {
+        const DescriptorCacheEntry *pEntry = &pCache->entries[i];
+        if (pEntry->set != VK_NULL_HANDLE && !descriptorSetKeyUses(&pEntry->key, buffer, imageView, sampler)) {
+            *descriptorCacheFind(entries, pCache->capacity, pEntry->hash, &pEntry->key) = *pEntry;
+            pCache->count++;
+        }
+    }
+    free(pCache->entries);
+    pCache->entries = entries;
+}
+
+void destroyDescriptorCache(DescriptorCache *pCache, VkApp *pApp) {
+    printf("INFO: descriptor cache: %u sets, %llu hits, %llu misses, %u pools\n", pCache->count, (unsigned long long)pCache->hits,
+           (unsigned long long)pCache->misses, pCache->allocator.poolCount);
+    destroyDescriptorAllocator(&pCache->allocator, pApp);
+    free(pCache->entries);
+    pCache->entries = NULL;
+    pCache->count = 0;
+}
@@ -0,0 +1,58 @@
+#include <stdatomic.h>
+#include "cglm/cglm.h"
+
+// Everything the render thread needs from the simulation to draw one frame.
+// The simulation thread fills one in, the render thread only ever reads it.
+typedef struct {
+    uint64_t frameIndex;
+    double time;
+    mat4 model;
+    mat4 view;
+    float fovY;
+    float nearPlane;
+    float farPlane;
+    VkExtent2D drawableExtent;
+} FrameState;
+
+// Lock-free triple buffer handing FrameStates from one writer to one reader.
+// The writer always owns `back`, the reader always owns `front`, and the
+// third slot sits in `middle` waiting to be swapped by either side. A fresh
+// bit on `middle` tells the reader a new snapshot was published; if the
+// reader falls behind, older snapshots are simply overwritten.
+#define FRAME_STATE_SLOT_COUNT 3
+#define FRAME_STATE_FRESH_BIT 0x4u
+#define FRAME_STATE_INDEX_MASK 0x3u
+
+typedef struct {
+    FrameState slots[FRAME_STATE_SLOT_COUNT];
+    atomic_uint middle;
+    uint32_t back;
+    uint32_t front;
+} FrameStateBuffer;
+
+void initFrameStateBuffer(FrameStateBuffer *buffer) {
+    memset(buffer->slots, 0, sizeof(buffer->slots));
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+// writer side: the slot to fill in before publishing
+FrameState *frameStateBack(FrameStateBuffer *buffer) {
+    return &buffer->slots[buffer->back];
+}
+
+void frameStatePublish(FrameStateBuffer *buffer) {
+    uint32_t previous = atomic_exchange_explicit(&buffer->middle, buffer->back | FRAME_STATE_FRESH_BIT, memory_order_acq_rel);
+    buffer->back = previous & FRAME_STATE_INDEX_MASK;
+}
+
+// reader side: swaps in the newest snapshot, returns NULL if nothing new was published
+const FrameState *frameStateAcquire(FrameStateBuffer *buffer) {
+    if ((atomic_load_explicit(&buffer->middle, memory_order_relaxed) & FRAME_STATE_FRESH_BIT) == 0) {
+        return NULL;
+    }
+    uint32_t previous = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = previous & FRAME_STATE_INDEX_MASK;
+    return &buffer->slots[buffer->front];
+}
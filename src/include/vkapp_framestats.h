@@ -0,0 +1,217 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+// Per frame timing statistics. Every metric goes into a log-linear (HDR
+// style) histogram of microseconds: each power of two range is split into
+// FRAME_HISTOGRAM_HALF_BUCKETS linear buckets, so any recorded value is
+// within ~1.6% of its bucket no matter whether it is 50us or 5s, and
+// percentiles cost a walk over a fixed size array instead of a sort.
+// Recording and querying take a mutex so any thread can read them.
+
+#define FRAME_HISTOGRAM_SUB_BUCKET_BITS 7
+#define FRAME_HISTOGRAM_SUB_BUCKETS (1u << FRAME_HISTOGRAM_SUB_BUCKET_BITS)
+#define FRAME_HISTOGRAM_HALF_BUCKETS (FRAME_HISTOGRAM_SUB_BUCKETS / 2)
+// enough magnitudes for values past an hour
+#define FRAME_HISTOGRAM_MAGNITUDES 26
+#define FRAME_HISTOGRAM_BUCKETS ((FRAME_HISTOGRAM_MAGNITUDES + 2) * FRAME_HISTOGRAM_HALF_BUCKETS)
+// a present interval this many times the recent average counts as a stutter
+#define FRAME_STUTTER_FACTOR 2.0
+// how quickly the recent average follows the present interval
+#define FRAME_STUTTER_SMOOTHING 0.05
+#define FRAME_STATS_REPORT_INTERVAL_MS 5000
+
+typedef enum {
+    FRAME_METRIC_CPU,
+    FRAME_METRIC_GPU,
+    FRAME_METRIC_ACQUIRE,
+    FRAME_METRIC_PRESENT_INTERVAL,
+    FRAME_METRIC_COUNT
+} FrameMetric;
+
+const char *frameMetricNames[FRAME_METRIC_COUNT] = {
+    "cpu",
+    "gpu",
+    "acquire_wait",
+    "present_interval"
+};
+
+typedef struct {
+    uint64_t counts[FRAME_HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t minUs;
+    uint64_t maxUs;
+    double sumUs;
+} FrameHistogram;
+
+typedef struct {
+    SDL_mutex *lock;
+    FrameHistogram histograms[FRAME_METRIC_COUNT];
+    uint64_t stutterCount;
+    double averagePresentIntervalUs;
+    uint64_t lastPresent;
+    uint64_t lastReport;
+} FrameStats;
+
+uint32_t frameHistogramIndex(uint64_t valueUs) {
+    if (valueUs < FRAME_HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t)valueUs;
+    }
+    uint32_t magnitude = 0;
+    while ((valueUs >> magnitude) >= FRAME_HISTOGRAM_SUB_BUCKETS) {
+        magnitude++;
+    }
+    if (magnitude > FRAME_HISTOGRAM_MAGNITUDES) {
+        return FRAME_HISTOGRAM_BUCKETS - 1;
+    }
+    // sub bucket lands in the upper half, the lower half is covered by the previous magnitude
+    return magnitude * FRAME_HISTOGRAM_HALF_BUCKETS + (uint32_t)(valueUs >> magnitude);
+}
+
+// midpoint of the values that map to index
+double frameHistogramValue(uint32_t index) {
+    if (index < FRAME_HISTOGRAM_SUB_BUCKETS) {
+        return (double)index;
+    }
+    uint32_t magnitude = index / FRAME_HISTOGRAM_HALF_BUCKETS - 1;
+    uint64_t subBucket = index - magnitude * FRAME_HISTOGRAM_HALF_BUCKETS;
+    return (double)(subBucket << magnitude) + (double)(1ull << magnitude) * 0.5;
+}
+
+void frameHistogramRecord(FrameHistogram *histogram, uint64_t valueUs) {
+    histogram->counts[frameHistogramIndex(valueUs)]++;
+    if (histogram->total == 0 || valueUs < histogram->minUs) {
+        histogram->minUs = valueUs;
+    }
+    if (valueUs > histogram->maxUs) {
+        histogram->maxUs = valueUs;
+    }
+    histogram->total++;
+    histogram->sumUs += (double)valueUs;
+}
+
+// percentile in [0, 100], returns milliseconds
+double frameHistogramPercentile(const FrameHistogram *histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < FRAME_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            double value = frameHistogramValue(i);
+            // never report past the extremes actually recorded
+            if (value < (double)histogram->minUs) {
+                value = (double)histogram->minUs;
+            }
+            if (value > (double)histogram->maxUs) {
+                value = (double)histogram->maxUs;
+            }
+            return value / 1000.0;
+        }
+    }
+    return (double)histogram->maxUs / 1000.0;
+}
+
+void initFrameStats(FrameStats *stats) {
+    memset(stats->histograms, 0, sizeof(stats->histograms));
+    stats->stutterCount = 0;
+    stats->averagePresentIntervalUs = 0.0;
+    stats->lastPresent = 0;
+    stats->lastReport = SDL_GetPerformanceCounter();
+    stats->lock = SDL_CreateMutex();
+    if (stats->lock == NULL) {
+        fprintf(stderr, "ERROR: failed to create frame stats lock: %s\n", SDL_GetError());
+        exit(1);
+    }
+}
+
+// drops everything recorded so far, e.g. once a warmup is over
+void frameStatsReset(FrameStats *stats) {
+    SDL_LockMutex(stats->lock);
+    memset(stats->histograms, 0, sizeof(stats->histograms));
+    stats->stutterCount = 0;
+    stats->averagePresentIntervalUs = 0.0;
+    stats->lastPresent = 0;
+    SDL_UnlockMutex(stats->lock);
+}
+
+void destroyFrameStats(FrameStats *stats) {
+    SDL_DestroyMutex(stats->lock);
+    stats->lock = NULL;
+}
+
+void frameStatsRecord(FrameStats *stats, FrameMetric metric, double ms) {
+    uint64_t valueUs = ms > 0.0 ? (uint64_t)(ms * 1000.0 + 0.5) : 0;
+    SDL_LockMutex(stats->lock);
+    frameHistogramRecord(&stats->histograms[metric], valueUs);
+    if (metric == FRAME_METRIC_PRESENT_INTERVAL) {
+        if (stats->averagePresentIntervalUs > 0.0 && (double)valueUs > FRAME_STUTTER_FACTOR * stats->averagePresentIntervalUs) {
+            stats->stutterCount++;
+        }
+        if (stats->averagePresentIntervalUs == 0.0) {
+            stats->averagePresentIntervalUs = (double)valueUs;
+        } else {
+            stats->averagePresentIntervalUs += FRAME_STUTTER_SMOOTHING * ((double)valueUs - stats->averagePresentIntervalUs);
+        }
+    }
+    SDL_UnlockMutex(stats->lock);
+}
+
+// counter is SDL_GetPerformanceCounter() right after present, the first call only starts the clock
+void frameStatsRecordPresent(FrameStats *stats, uint64_t counter) {
+    if (stats->lastPresent != 0) {
+        frameStatsRecord(stats, FRAME_METRIC_PRESENT_INTERVAL, (double)(counter - stats->lastPresent) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+    }
+    stats->lastPresent = counter;
+}
+
+double frameStatsPercentile(FrameStats *stats, FrameMetric metric, double percentile) {
+    SDL_LockMutex(stats->lock);
+    double value = frameHistogramPercentile(&stats->histograms[metric], percentile);
+    SDL_UnlockMutex(stats->lock);
+    return value;
+}
+
+uint64_t frameStatsStutterCount(FrameStats *stats) {
+    SDL_LockMutex(stats->lock);
+    uint64_t stutterCount = stats->stutterCount;
+    SDL_UnlockMutex(stats->lock);
+    return stutterCount;
+}
+
+void frameStatsReport(FrameStats *stats, FILE *pFile) {
+    SDL_LockMutex(stats->lock);
+    fprintf(pFile, "Frame statistics (ms), %llu stutters:\n", (unsigned long long)stats->stutterCount);
+    fprintf(pFile, "  %-17s %8s %8s %8s %8s %8s %8s %8s\n", "metric", "frames", "avg", "p50", "p90", "p99", "p99.9", "max");
+    for (int i = 0; i < FRAME_METRIC_COUNT; i++) {
+        const FrameHistogram *histogram = &stats->histograms[i];
+        if (histogram->total == 0) {
+            continue;
+        }
+        fprintf(pFile, "  %-17s %8llu %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", frameMetricNames[i], (unsigned long long)histogram->total,
+                histogram->sumUs / (double)histogram->total / 1000.0,
+                frameHistogramPercentile(histogram, 50.0), frameHistogramPercentile(histogram, 90.0),
+                frameHistogramPercentile(histogram, 99.0), frameHistogramPercentile(histogram, 99.9),
+                (double)histogram->maxUs / 1000.0);
+    }
+    SDL_UnlockMutex(stats->lock);
+}
+
+// prints a report once every FRAME_STATS_REPORT_INTERVAL_MS, call once per frame
+void frameStatsReportPeriodically(FrameStats *stats, FILE *pFile) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    if ((now - stats->lastReport) * 1000 < FRAME_STATS_REPORT_INTERVAL_MS * SDL_GetPerformanceFrequency()) {
+        return;
+    }
+    stats->lastReport = now;
+    frameStatsReport(stats, pFile);
+}
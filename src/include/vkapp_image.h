@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+// CPU side image helpers shared by the app and the offline texture tools.
+// Pixels are tightly packed RGBA8, top row first.
+
+// levels in a full chain down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while (((width | height) >> levels) != 0) {
+        levels++;
+    }
+    return levels;
+}
+
+uint32_t mipLevelExtent(uint32_t extent, uint32_t level) {
+    return extent >> level > 0 ? extent >> level : 1;
+}
+
+// bytes of levels [0, mipLevels) packed one after another
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels) {
+    size_t size = 0;
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        size += (size_t)mipLevelExtent(width, level) * mipLevelExtent(height, level) * 4;
+    }
+    return size;
+}
+
+// Builds the chain with a 2x2 box filter, writing the levels tightly packed
+// one after another into pDst, level 0 included, and each level's offset
+// into pOffsets. sRGB color is averaged in linear space; pass srgb = false
+// for data such as normal maps. Alpha is always averaged as is. pPixels may
+// be pDst itself when level 0 is already in place.
+void buildMipChainRGBA8(const uint8_t *pPixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb, uint8_t *pDst, size_t *pOffsets) {
+    float toLinear[256];
+    for (int i = 0; i < 256; i++) {
+        float c = (float)i / 255.0f;
+        toLinear[i] = !srgb ? c : c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    size_t offset = 0;
+    if (pDst != pPixels) {
+        memcpy(pDst, pPixels, (size_t)width * height * 4);
+    }
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        pOffsets[level] = offset;
+        if (level + 1 == mipLevels) {
+            break;
+        }
+
+        const uint8_t *pSrc = pDst + offset;
+        offset += (size_t)width * height * 4;
+        uint8_t *pNext = pDst + offset;
+        uint32_t nextWidth = width > 1 ? width / 2 : 1;
+        uint32_t nextHeight = height > 1 ? height / 2 : 1;
+        for (uint32_t y = 0; y < nextHeight; y++) {
+            uint32_t y0 = y * 2 < height ? y * 2 : height - 1;
+            uint32_t y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+            for (uint32_t x = 0; x < nextWidth; x++) {
+                uint32_t x0 = x * 2 < width ? x * 2 : width - 1;
+                uint32_t x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+                const uint8_t *p[4] = {
+                    pSrc + ((size_t)y0 * width + x0) * 4, pSrc + ((size_t)y0 * width + x1) * 4,
+                    pSrc + ((size_t)y1 * width + x0) * 4, pSrc + ((size_t)y1 * width + x1) * 4
+                };
+                uint8_t *pOut = pNext + ((size_t)y * nextWidth + x) * 4;
+                for (int c = 0; c < 3; c++) {
+                    float linear = (toLinear[p[0][c]] + toLinear[p[1][c]] + toLinear[p[2][c]] + toLinear[p[3][c]]) * 0.25f;
+                    float encoded = !srgb ? linear : linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+                    pOut[c] = (uint8_t)(encoded * 255.0f + 0.5f);
+                }
+                pOut[3] = (uint8_t)((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) / 4);
+            }
+        }
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
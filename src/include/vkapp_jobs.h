@@ -0,0 +1,435 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "SDL.h"
+
+// Work-stealing job system. Every participating thread owns a Chase-Lev
+// deque: the owner pushes and pops at the bottom, idle threads steal from the
+// top. Background workers are started by jobSystemInit, other threads (main,
+// render) call jobSystemRegisterThread to get a deque of their own and help
+// out whenever they wait on a counter. Threads that never register still can
+// submit, their jobs go through a shared locked queue.
+
+// both must be powers of two
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_POOL_CAPACITY 4096
+#define MAX_JOB_THREADS 64
+#define MAX_JOB_CONTINUATIONS 8
+// how long an idle worker sleeps before looking for work again, wakeups normally come from submits
+#define JOB_WORKER_IDLE_TIMEOUT_MS 10
+#define JOB_SYSTEM_DEFAULT_WORKERS UINT32_MAX
+
+typedef void (*JobFunction)(void *data);
+typedef void (*JobRangeFunction)(void *data, uint32_t begin, uint32_t end);
+
+typedef struct JobCounter JobCounter;
+
+typedef struct {
+    JobFunction function;
+    JobRangeFunction rangeFunction;
+    void *data;
+    uint32_t begin;
+    uint32_t end;
+    JobCounter *counter;
+} Job;
+
+// Counts outstanding jobs. Waiting on it blocks until it drops to zero, and
+// continuations registered with jobSystemRunAfter are submitted at that point.
+// Counters usually live on the waiter's stack, so the waiter also has to wait
+// out every finishing job that may still touch the counter after its
+// decrement; `finishing` counts those and is the last thing they release.
+struct JobCounter {
+    atomic_int value;
+    atomic_int finishing;
+    atomic_flag lock;
+    uint32_t continuationCount;
+    Job continuations[MAX_JOB_CONTINUATIONS];
+};
+
+typedef struct {
+    atomic_llong top;
+    atomic_llong bottom;
+    Job *_Atomic buffer[JOB_DEQUE_CAPACITY];
+} JobDeque;
+
+// per thread storage; a job slot is reused JOB_POOL_CAPACITY submits later, so
+// a single thread must never have more jobs than that in flight
+typedef struct {
+    JobDeque deque;
+    Job pool[JOB_POOL_CAPACITY];
+    uint32_t poolNext;
+    uint32_t stealSeed;
+} JobThread;
+
+typedef struct JobSystem JobSystem;
+
+typedef struct {
+    JobSystem *jobSystem;
+    uint32_t slot;
+    SDL_Thread *thread;
+} JobWorker;
+
+struct JobSystem {
+    uint32_t workerCount;
+    JobWorker workers[MAX_JOB_THREADS];
+    JobThread *threads[MAX_JOB_THREADS];
+    atomic_uint threadCount;
+    // for submits from threads without a deque of their own
+    JobThread *sharedThread;
+    SDL_mutex *sharedLock;
+    SDL_sem *wakeup;
+    atomic_int sleepingCount;
+    atomic_bool quit;
+};
+
+// slot in JobSystem.threads owned by the calling thread, -1 if it has none
+_Thread_local int jobThreadSlot = -1;
+
+void initJobCounter(JobCounter *counter) {
+    atomic_init(&counter->value, 0);
+    atomic_init(&counter->finishing, 0);
+    atomic_flag_clear(&counter->lock);
+    counter->continuationCount = 0;
+}
+
+// once true, no job accesses the counter anymore and it may go away
+bool jobCounterDone(JobCounter *counter) {
+    return atomic_load_explicit(&counter->value, memory_order_acquire) == 0 &&
+           atomic_load_explicit(&counter->finishing, memory_order_acquire) == 0;
+}
+
+void initJobDeque(JobDeque *deque) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    for (uint32_t i = 0; i < JOB_DEQUE_CAPACITY; i++) {
+        atomic_init(&deque->buffer[i], NULL);
+    }
+}
+
+// owner only
+bool jobDequePush(JobDeque *deque, Job *job) {
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top >= JOB_DEQUE_CAPACITY) {
+        return false;
+    }
+    atomic_store_explicit(&deque->buffer[bottom & (JOB_DEQUE_CAPACITY - 1)], job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return true;
+}
+
+// owner only, takes the most recently pushed job
+Job *jobDequePop(JobDeque *deque) {
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        // empty
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+    Job *job = atomic_load_explicit(&deque->buffer[bottom & (JOB_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        // last job, race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            job = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+// any thread, takes the oldest job
+Job *jobDequeSteal(JobDeque *deque) {
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return NULL;
+    }
+    Job *job = atomic_load_explicit(&deque->buffer[top & (JOB_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return job;
+}
+
+JobThread *createJobThread(uint32_t seed) {
+    JobThread *thread = (JobThread *)malloc(sizeof(JobThread));
+    if (thread == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate job thread storage!\n");
+        exit(1);
+    }
+    initJobDeque(&thread->deque);
+    thread->poolNext = 0;
+    thread->stealSeed = seed * 2654435761u + 1;
+    return thread;
+}
+
+void jobSystemSubmit(JobSystem *pJobSystem, Job job);
+
+void jobSystemExecute(JobSystem *pJobSystem, Job *job) {
+    if (job->rangeFunction != NULL) {
+        job->rangeFunction(job->data, job->begin, job->end);
+    } else {
+        job->function(job->data);
+    }
+    JobCounter *counter = job->counter;
+    if (counter == NULL) {
+        return;
+    }
+    atomic_fetch_add_explicit(&counter->finishing, 1, memory_order_acq_rel);
+    uint32_t continuationCount = 0;
+    Job continuations[MAX_JOB_CONTINUATIONS];
+    if (atomic_fetch_sub_explicit(&counter->value, 1, memory_order_acq_rel) == 1) {
+        // last job on this counter, release whatever was waiting on it
+        while (atomic_flag_test_and_set_explicit(&counter->lock, memory_order_acquire)) {}
+        continuationCount = counter->continuationCount;
+        memcpy(continuations, counter->continuations, continuationCount * sizeof(Job));
+        counter->continuationCount = 0;
+        atomic_flag_clear_explicit(&counter->lock, memory_order_release);
+    }
+    // the last access, waiters may drop the counter from here on
+    atomic_fetch_sub_explicit(&counter->finishing, 1, memory_order_release);
+
+    for (uint32_t i = 0; i < continuationCount; i++) {
+        jobSystemSubmit(pJobSystem, continuations[i]);
+    }
+}
+
+// pops from the calling thread's own deque first, then tries to steal
+Job *jobSystemFindJob(JobSystem *pJobSystem) {
+    uint32_t threadCount = atomic_load_explicit(&pJobSystem->threadCount, memory_order_acquire);
+    uint32_t start = 0;
+    if (jobThreadSlot >= 0) {
+        JobThread *self = pJobSystem->threads[jobThreadSlot];
+        Job *job = jobDequePop(&self->deque);
+        if (job != NULL) {
+            return job;
+        }
+        // xorshift so thieves don't all hammer the same victim
+        self->stealSeed ^= self->stealSeed << 13;
+        self->stealSeed ^= self->stealSeed >> 17;
+        self->stealSeed ^= self->stealSeed << 5;
+        start = self->stealSeed;
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        uint32_t victim = (start + i) % threadCount;
+        if ((int)victim == jobThreadSlot) {
+            continue;
+        }
+        Job *job = jobDequeSteal(&pJobSystem->threads[victim]->deque);
+        if (job != NULL) {
+            return job;
+        }
+    }
+    return jobDequeSteal(&pJobSystem->sharedThread->deque);
+}
+
+void jobSystemSubmit(JobSystem *pJobSystem, Job job) {
+    bool pushed;
+    if (jobThreadSlot >= 0) {
+        JobThread *self = pJobSystem->threads[jobThreadSlot];
+        Job *slot = &self->pool[self->poolNext++ & (JOB_POOL_CAPACITY - 1)];
+        *slot = job;
+        pushed = jobDequePush(&self->deque, slot);
+        if (!pushed) {
+            self->poolNext--;
+        }
+    } else {
+        SDL_LockMutex(pJobSystem->sharedLock);
+        JobThread *shared = pJobSystem->sharedThread;
+        Job *slot = &shared->pool[shared->poolNext++ & (JOB_POOL_CAPACITY - 1)];
+        *slot = job;
+        pushed = jobDequePush(&shared->deque, slot);
+        if (!pushed) {
+            shared->poolNext--;
+        }
+        SDL_UnlockMutex(pJobSystem->sharedLock);
+    }
+
+    if (!pushed) {
+        // deque is full, running it right here is the only way to make progress
+        jobSystemExecute(pJobSystem, &job);
+        return;
+    }
+    if (atomic_load(&pJobSystem->sleepingCount) > 0) {
+        SDL_SemPost(pJobSystem->wakeup);
+    }
+}
+
+void jobSystemRun(JobSystem *pJobSystem, JobFunction function, void *data, JobCounter *counter) {
+    if (counter != NULL) {
+        atomic_fetch_add_explicit(&counter->value, 1, memory_order_relaxed);
+    }
+    Job job = {function, NULL, data, 0, 0, counter};
+    jobSystemSubmit(pJobSystem, job);
+}
+
+// submits the job once `dependency` drops to zero, without blocking the caller
+void jobSystemRunAfter(JobSystem *pJobSystem, JobCounter *dependency, JobFunction function, void *data, JobCounter *counter) {
+    if (counter != NULL) {
+        atomic_fetch_add_explicit(&counter->value, 1, memory_order_relaxed);
+    }
+    Job job = {function, NULL, data, 0, 0, counter};
+
+    while (atomic_flag_test_and_set_explicit(&dependency->lock, memory_order_acquire)) {}
+    bool ready = atomic_load_explicit(&dependency->value, memory_order_acquire) == 0;
+    if (!ready) {
+        if (dependency->continuationCount == MAX_JOB_CONTINUATIONS) {
+            fprintf(stderr, "ERROR: too many continuations on one job counter!\n");
+            exit(1);
+        }
+        dependency->continuations[dependency->continuationCount++] = job;
+    }
+    atomic_flag_clear_explicit(&dependency->lock, memory_order_release);
+
+    if (ready) {
+        jobSystemSubmit(pJobSystem, job);
+    }
+}
+
+// runs other jobs while waiting, so waiting from a job or a registered thread never wastes a core
+void jobSystemWait(JobSystem *pJobSystem, JobCounter *counter) {
+    while (!jobCounterDone(counter)) {
+        Job *job = jobSystemFindJob(pJobSystem);
+        if (job != NULL) {
+            jobSystemExecute(pJobSystem, job);
+        } else {
+            SDL_Delay(0);
+        }
+    }
+}
+
+// Splits [0, count) into chunks of `grainSize` and runs them across all
+// threads, returns once every chunk has finished.
+void jobSystemParallelFor(JobSystem *pJobSystem, uint32_t count, uint32_t grainSize, JobRangeFunction function, void *data) {
+    if (grainSize == 0) {
+        grainSize = 1;
+    }
+    if (count <= grainSize) {
+        function(data, 0, count);
+        return;
+    }
+    JobCounter counter;
+    initJobCounter(&counter);
+    // keep the first chunk for ourselves, everyone else can steal the rest
+    for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+        uint32_t end = count - begin < grainSize ? count : begin + grainSize;
+        atomic_fetch_add_explicit(&counter.value, 1, memory_order_relaxed);
+        Job job = {NULL, function, data, begin, end, &counter};
+        jobSystemSubmit(pJobSystem, job);
+    }
+    function(data, 0, grainSize);
+    jobSystemWait(pJobSystem, &counter);
+}
+
+uint32_t jobSystemAddThread(JobSystem *pJobSystem) {
+    uint32_t slot = atomic_load(&pJobSystem->threadCount);
+    if (slot >= MAX_JOB_THREADS) {
+        fprintf(stderr, "ERROR: too many job system threads!\n");
+        exit(1);
+    }
+    pJobSystem->threads[slot] = createJobThread(slot);
+    atomic_store_explicit(&pJobSystem->threadCount, slot + 1, memory_order_release);
+    return slot;
+}
+
+// gives the calling thread its own deque; call once per thread before it submits or waits
+void jobSystemRegisterThread(JobSystem *pJobSystem) {
+    if (jobThreadSlot >= 0) {
+        return;
+    }
+    SDL_LockMutex(pJobSystem->sharedLock);
+    jobThreadSlot = (int)jobSystemAddThread(pJobSystem);
+    SDL_UnlockMutex(pJobSystem->sharedLock);
+}
+
+int jobWorkerMain(void *data) {
+    JobWorker *worker = (JobWorker *)data;
+    JobSystem *pJobSystem = worker->jobSystem;
+    jobThreadSlot = (int)worker->slot;
+
+    while (!atomic_load(&pJobSystem->quit)) {
+        Job *job = jobSystemFindJob(pJobSystem);
+        if (job != NULL) {
+            jobSystemExecute(pJobSystem, job);
+            continue;
+        }
+        // announce we're going to sleep, then look once more so a submit racing with us isn't missed
+        atomic_fetch_add(&pJobSystem->sleepingCount, 1);
+        job = jobSystemFindJob(pJobSystem);
+        if (job == NULL) {
+            SDL_SemWaitTimeout(pJobSystem->wakeup, JOB_WORKER_IDLE_TIMEOUT_MS);
+        }
+        atomic_fetch_sub(&pJobSystem->sleepingCount, 1);
+        if (job != NULL) {
+            jobSystemExecute(pJobSystem, job);
+        }
+    }
+    return 0;
+}
+
+// JOB_SYSTEM_DEFAULT_WORKERS means one background worker per core, minus the calling
+// thread; with 0 every job runs on the threads that wait on it
+void jobSystemInit(JobSystem *pJobSystem, uint32_t workerCount) {
+    if (workerCount == JOB_SYSTEM_DEFAULT_WORKERS) {
+        int cpuCount = SDL_GetCPUCount();
+        workerCount = cpuCount > 1 ? (uint32_t)cpuCount - 1 : 1;
+    }
+    if (workerCount > MAX_JOB_THREADS / 2) {
+        workerCount = MAX_JOB_THREADS / 2;
+    }
+    pJobSystem->workerCount = workerCount;
+    atomic_init(&pJobSystem->threadCount, 0);
+    atomic_init(&pJobSystem->sleepingCount, 0);
+    atomic_init(&pJobSystem->quit, false);
+    pJobSystem->sharedThread = createJobThread(MAX_JOB_THREADS);
+    pJobSystem->sharedLock = SDL_CreateMutex();
+    pJobSystem->wakeup = SDL_CreateSemaphore(0);
+    if (pJobSystem->sharedLock == NULL || pJobSystem->wakeup == NULL) {
+        fprintf(stderr, "ERROR: failed to create job system primitives: %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    // create every worker's deque before any of them starts stealing
+    for (uint32_t i = 0; i < workerCount; i++) {
+        pJobSystem->workers[i].jobSystem = pJobSystem;
+        pJobSystem->workers[i].slot = jobSystemAddThread(pJobSystem);
+    }
+    for (uint32_t i = 0; i < workerCount; i++) {
+        pJobSystem->workers[i].thread = SDL_CreateThread(jobWorkerMain, "job worker", &pJobSystem->workers[i]);
+        if (pJobSystem->workers[i].thread == NULL) {
+            fprintf(stderr, "ERROR: failed to create job worker thread: %s\n", SDL_GetError());
+            exit(1);
+        }
+    }
+    printf("INFO: job system running with %u workers\n", workerCount);
+}
+
+// outstanding jobs must have been waited on already
+void jobSystemShutdown(JobSystem *pJobSystem) {
+    atomic_store(&pJobSystem->quit, true);
+    for (uint32_t i = 0; i < pJobSystem->workerCount; i++) {
+        SDL_SemPost(pJobSystem->wakeup);
+    }
+    for (uint32_t i = 0; i < pJobSystem->workerCount; i++) {
+        SDL_WaitThread(pJobSystem->workers[i].thread, NULL);
+    }
+    uint32_t threadCount = atomic_load(&pJobSystem->threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        free(pJobSystem->threads[i]);
+    }
+    free(pJobSystem->sharedThread);
+    SDL_DestroyMutex(pJobSystem->sharedLock);
+    SDL_DestroySemaphore(pJobSystem->wakeup);
+    // registered threads keep a stale slot otherwise
+    jobThreadSlot = -1;
+}
@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+// KTX2 container for block compressed textures with their mip chain, as
+// written by tools/ktxconv. Only what the app uploads is accepted: a single
+// 2D image (no layers, faces or depth), no supercompression, BC7 or BC5
+// blocks and at least one level. Levels are kept as raw blocks and go to the
+// GPU as they are.
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_INDEX_ENTRY_SIZE 24
+#define KTX2_MAX_LEVELS 32
+// block compressed levels start on a multiple of the block size
+#define KTX2_LEVEL_ALIGNMENT 16
+
+const uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+typedef struct {
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    // the whole file, levels point into it
+    uint8_t *fileData;
+    size_t levelOffsets[KTX2_MAX_LEVELS];
+    size_t levelSizes[KTX2_MAX_LEVELS];
+} KtxTexture;
+
+uint32_t ktxReadU32(const uint8_t *pData) {
+    return (uint32_t)pData[0] | (uint32_t)pData[1] << 8 | (uint32_t)pData[2] << 16 | (uint32_t)pData[3] << 24;
+}
+
+uint64_t ktxReadU64(const uint8_t *pData) {
+    return (uint64_t)ktxReadU32(pData) | (uint64_t)ktxReadU32(pData + 4) << 32;
+}
+
+bool ktxIsSupportedFormat(VkFormat format) {
+    return format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK ||
+           format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC5_SNORM_BLOCK;
+}
+
+// both supported formats use 16 byte 4x4 blocks
+size_t ktxLevelSize(uint32_t width, uint32_t height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+}
+
+// checks the header and level index at the start of pData (available bytes of a fileSize byte file)
+// and fills in everything but fileData, returns what is wrong or NULL
+const char *ktxParseIndex(const uint8_t *pData, size_t available, size_t fileSize, KtxTexture *pTexture) {
+    if (available < KTX2_HEADER_SIZE || memcmp(pData, ktx2Identifier, sizeof(ktx2Identifier)) != 0) {
+        return "not a KTX2 file";
+    }
+    uint32_t levelCount = ktxReadU32(pData + 40);
+    pTexture->format = (VkFormat)ktxReadU32(pData + 12);
+    pTexture->width = ktxReadU32(pData + 20);
+    pTexture->height = ktxReadU32(pData + 24);
+    uint32_t depth = ktxReadU32(pData + 28);
+    uint32_t layerCount = ktxReadU32(pData + 32);
+    uint32_t faceCount = ktxReadU32(pData + 36);
+    uint32_t supercompression = ktxReadU32(pData + 44);
+    if (!ktxIsSupportedFormat(pTexture->format)) {
+        return "unsupported format, expected BC7 or BC5";
+    } else if (depth != 0 || layerCount > 1 || faceCount != 1 || pTexture->width == 0 || pTexture->height == 0) {
+        return "only single 2D images are supported";
+    } else if (supercompression != 0) {
+        return "supercompressed files are not supported";
+    } else if (levelCount == 0 || levelCount > KTX2_MAX_LEVELS || levelCount > mipLevelCount(pTexture->width, pTexture->height)) {
+        return "invalid level count";
+    } else if (available < KTX2_HEADER_SIZE + (size_t)levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE) {
+        return "truncated level index";
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+        const uint8_t *pEntry = pData + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        uint64_t offset = ktxReadU64(pEntry);
+        uint64_t length = ktxReadU64(pEntry + 8);
+        size_t expected = ktxLevelSize(mipLevelExtent(pTexture->width, level), mipLevelExtent(pTexture->height, level));
+        if (length != expected || offset % KTX2_LEVEL_ALIGNMENT != 0 || offset > fileSize || length > fileSize - offset) {
+            return "invalid level index";
+        }
+        pTexture->levelOffsets[level] = (size_t)offset;
+        pTexture->levelSizes[level] = (size_t)length;
+    }
+    pTexture->levelCount = levelCount;
+    return NULL;
+}
+
+// false with a message on stderr if the file can't be read or isn't something the app can upload
+bool loadKtx2File(const char *path, KtxTexture *pTexture) {
+    memset(pTexture, 0, sizeof(KtxTexture));
+    FILE *pFile = fopen(path, "rb");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open %s\n", path);
+        return false;
+    }
+    fseek(pFile, 0, SEEK_END);
+    long fileSize = ftell(pFile);
+    rewind(pFile);
+    uint8_t *pData = fileSize > 0 ? (uint8_t *)malloc((size_t)fileSize) : NULL;
+    if (pData == NULL || fread(pData, 1, (size_t)fileSize, pFile) != (size_t)fileSize) {
+        fprintf(stderr, "ERROR: unable to read %s\n", path);
+        fclose(pFile);
+        free(pData);
+        return false;
+    }
+    fclose(pFile);
+
+    const char *problem = ktxParseIndex(pData, (size_t)fileSize, (size_t)fileSize, pTexture);
+    if (problem != NULL) {
+        fprintf(stderr, "ERROR: %s: %s\n", path, problem);
+        free(pData);
+        memset(pTexture, 0, sizeof(KtxTexture));
+        return false;
+    }
+    pTexture->fileData = pData;
+    return true;
+}
+
+// like loadKtx2File but only reads the header and level index, fileData stays NULL;
+// the levels are read on demand with readKtx2Level
+bool loadKtx2Index(const char *path, KtxTexture *pTexture) {
+    memset(pTexture, 0, sizeof(KtxTexture));
+    FILE *pFile = fopen(path, "rb");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open %s\n", path);
+        return false;
+    }
+    fseek(pFile, 0, SEEK_END);
+    long fileSize = ftell(pFile);
+    rewind(pFile);
+    uint8_t index[KTX2_HEADER_SIZE + KTX2_MAX_LEVELS * KTX2_LEVEL_INDEX_ENTRY_SIZE];
+    size_t available = fread(index, 1, sizeof(index), pFile);
+    fclose(pFile);
+    const char *problem = fileSize > 0 ? ktxParseIndex(index, available, (size_t)fileSize, pTexture) : "empty file";
+    if (problem != NULL) {
+        fprintf(stderr, "ERROR: %s: %s\n", path, problem);
+        memset(pTexture, 0, sizeof(KtxTexture));
+        return false;
+    }
+    return true;
+}
+
+// reads one level of a texture opened with loadKtx2Index into pDst
+bool readKtx2Level(const char *path, const KtxTexture *pTexture, uint32_t level, uint8_t *pDst) {
+    FILE *pFile = fopen(path, "rb");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open %s\n", path);
+        return false;
+    }
+    bool read = fseek(pFile, (long)pTexture->levelOffsets[level], SEEK_SET) == 0 &&
+                fread(pDst, 1, pTexture->levelSizes[level], pFile) == pTexture->levelSizes[level];
+    fclose(pFile);
+    if (!read) {
+        fprintf(stderr, "ERROR: unable to read level %u of %s\n", level, path);
+    }
+    return read;
+}
+
+void freeKtxTexture(KtxTexture *pTexture) {
+    free(pTexture->fileData);
+    memset(pTexture, 0, sizeof(KtxTexture));
+}
+
+bool pathHasExtension(const char *path, const char *extension) {
+    size_t pathLength = strlen(path);
+    size_t extensionLength = strlen(extension);
+    return pathLength >= extensionLength && strcmp(path + pathLength - extensionLength, extension) == 0;
+}
@@ -0,0 +1,408 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+// Texture atlas layout shared by the app and tools/atlaspack. Small textures
+// are packed into square pages with a skyline packer (bottom-left rule, every
+// page tried in order before a new one is opened); a model that samples one
+// of them has its texture coordinates remapped into the page when it is
+// loaded, so all of them cost one image, one allocation and one descriptor
+// per page instead of one each.
+//
+// Every entry gets ATLAS_PADDING texels of its own edge replicated around it
+// and starts on a multiple of ATLAS_PADDING, which keeps it from bleeding
+// into its neighbours through bilinear filtering down to the last mip level
+// the padding still covers, see atlasMipLevels. Pages stop there.
+//
+// A .atlas manifest records a packed layout next to its page images:
+//
+//   atlas <page size> <padding>
+//   page <image path>                                    once per page
+//   entry <page> <x> <y> <width> <height> <image path>   once per texture
+//
+// x and y are where the texture itself starts, inside its padding.
+
+#define ATLAS_DEFAULT_PAGE_SIZE 2048
+#define ATLAS_PADDING 4
+#define ATLAS_MAX_PAGES 16
+#define ATLAS_MAX_PATH 1024
+
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+} SkylineNode;
+
+// the top edge of everything placed on a page so far, left to right
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    SkylineNode *nodes;
+    uint32_t nodeCount;
+    uint32_t nodeCapacity;
+    uint64_t usedArea;
+} SkylinePacker;
+
+typedef struct {
+    char *path;
+    uint32_t page;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} AtlasEntry;
+
+typedef struct {
+    uint32_t pageSize;
+    uint32_t padding;
+    uint32_t pageCount;
+    // only known for layouts read from a manifest
+    char *pagePaths[ATLAS_MAX_PAGES];
+    AtlasEntry *entries;
+    uint32_t entryCount;
+} AtlasLayout;
+
+void initSkylinePacker(SkylinePacker *pPacker, uint32_t width, uint32_t height) {
+    pPacker->width = width;
+    pPacker->height = height;
+    // one more than there can ever be, a node is at least a texel wide
+    pPacker->nodeCapacity = width + 1;
+    pPacker->nodes = (SkylineNode *)malloc(pPacker->nodeCapacity * sizeof(SkylineNode));
+    pPacker->nodes[0] = (SkylineNode){0, 0, width};
+    pPacker->nodeCount = 1;
+    pPacker->usedArea = 0;
+}
+
+void destroySkylinePacker(SkylinePacker *pPacker) {
+    free(pPacker->nodes);
+    pPacker->nodes = NULL;
+}
+
+// lowest y a width wide rectangle can sit at when its left edge is on node `index`, UINT32_MAX if it doesn't fit
+uint32_t skylineFit(const SkylinePacker *pPacker, uint32_t index, uint32_t width, uint32_t height) {
+    uint32_t x = pPacker->nodes[index].x;
+    if (x + width > pPacker->width) {
+        return UINT32_MAX;
+    }
+    uint32_t y = 0;
+    uint32_t remaining = width;
+    for (uint32_t i = index; remaining > 0; i++) {
+        if (pPacker->nodes[i].y > y) {
+            y = pPacker->nodes[i].y;
+        }
+        if (y + height > pPacker->height) {
+            return UINT32_MAX;
+        }
+        remaining = pPacker->nodes[i].width >= remaining ? 0 : remaining - pPacker->nodes[i].width;
+    }
+    return y;
+}
+
+// bottom-left rule: the position with the lowest top edge, the narrower node on ties
+bool skylineInsert(SkylinePacker *pPacker, uint32_t width, uint32_t height, uint32_t *pX, uint32_t *pY) {
+    uint32_t bestIndex = UINT32_MAX;
+    uint32_t bestTop = UINT32_MAX;
+    uint32_t bestWidth = UINT32_MAX;
+    for (uint32_t i = 0; i < pPacker->nodeCount; i++) {
+        uint32_t y = skylineFit(pPacker, i, width, height);
+        if (y == UINT32_MAX) {
+            continue;
+        }
+        if (y + height < bestTop || (y + height == bestTop && pPacker->nodes[i].width < bestWidth)) {
+            bestIndex = i;
+            bestTop = y + height;
+            bestWidth = pPacker->nodes[i].width;
+        }
+    }
+    if (bestIndex == UINT32_MAX) {
+        return false;
+    }
+    *pX = pPacker->nodes[bestIndex].x;
+    *pY = bestTop - height;
+
+    // the new node covers [x, x + width), nodes under it shrink or go
+    SkylineNode *nodes = pPacker->nodes;
+    memmove(&nodes[bestIndex + 1], &nodes[bestIndex], (pPacker->nodeCount - bestIndex) * sizeof(SkylineNode));
+    nodes[bestIndex] = (SkylineNode){*pX, bestTop, width};
+    pPacker->nodeCount++;
+    uint32_t i = bestIndex + 1;
+    while (i < pPacker->nodeCount) {
+        uint32_t previousEnd = nodes[i - 1].x + nodes[i - 1].width;
+        if (nodes[i].x >= previousEnd) {
+            break;
+        }
+        uint32_t overlap = previousEnd - nodes[i].x;
+        if (overlap < nodes[i].width) {
+            nodes[i].x += overlap;
+            nodes[i].width -= overlap;
+            break;
+        }
+        memmove(&nodes[i], &nodes[i + 1], (pPacker->nodeCount - i - 1) * sizeof(SkylineNode));
+        pPacker->nodeCount--;
+    }
+    for (i = 0; i + 1 < pPacker->nodeCount;) {
+        if (nodes[i].y == nodes[i + 1].y) {
+            nodes[i].width += nodes[i + 1].width;
+            memmove(&nodes[i + 1], &nodes[i + 2], (pPacker->nodeCount - i - 2) * sizeof(SkylineNode));
+            pPacker->nodeCount--;
+        } else {
+            i++;
+        }
+    }
+    pPacker->usedArea += (uint64_t)width * height;
+    return true;
+}
+
+// the padded footprint of a texture, a multiple of the padding so every entry stays aligned to it
+uint32_t atlasPaddedExtent(uint32_t extent, uint32_t padding) {
+    return (extent + 2 * padding + padding - 1) / padding * padding;
+}
+
+// the levels over which the padding still keeps entries apart: it halves with every level
+uint32_t atlasMipLevels(uint32_t padding) {
+    uint32_t levels = 1;
+    while ((padding >> levels) != 0) {
+        levels++;
+    }
+    return levels;
+}
+
+// textures up to half a page on either side are worth packing, bigger ones keep their own image
+bool atlasAccepts(uint32_t pageSize, uint32_t padding, uint32_t width, uint32_t height) {
+    return width <= pageSize / 2 && height <= pageSize / 2 && atlasPaddedExtent(width, padding) <= pageSize && atlasPaddedExtent(height, padding) <= pageSize;
+}
+
+int compareAtlasEntryHeight(const void *a, const void *b) {
+    const AtlasEntry *pA = *(const AtlasEntry *const *)a;
+    const AtlasEntry *pB = *(const AtlasEntry *const *)b;
+    if (pA->height != pB->height) {
+        return pA->height < pB->height ? 1 : -1;
+    }
+    return pA->width < pB->width ? 1 : pA->width > pB->width ? -1 : 0;
+}
+
+// Places every entry (path, width and height filled in, all accepted by
+// atlasAccepts) and sets pageCount. Tallest first, which is what keeps a
+// skyline flat. Fails once more than ATLAS_MAX_PAGES would be needed.
+bool atlasPack(AtlasLayout *pLayout) {
+    AtlasEntry **sorted = (AtlasEntry **)malloc(pLayout->entryCount * sizeof(AtlasEntry *));
+    for (uint32_t i = 0; i < pLayout->entryCount; i++) {
+        sorted[i] = &pLayout->entries[i];
+    }
+    qsort(sorted, pLayout->entryCount, sizeof(AtlasEntry *), compareAtlasEntryHeight);
+
+    SkylinePacker pages[ATLAS_MAX_PAGES];
+    pLayout->pageCount = 0;
+    bool packed = true;
+    for (uint32_t i = 0; i < pLayout->entryCount && packed; i++) {
+        AtlasEntry *pEntry = sorted[i];
+        uint32_t width = atlasPaddedExtent(pEntry->width, pLayout->padding);
+        uint32_t height = atlasPaddedExtent(pEntry->height, pLayout->padding);
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t page = 0;
+        while (page < pLayout->pageCount && !skylineInsert(&pages[page], width, height, &x, &y)) {
+            page++;
+        }
+        if (page == pLayout->pageCount) {
+            if (pLayout->pageCount == ATLAS_MAX_PAGES) {
+                fprintf(stderr, "ERROR: atlas needs more than %u pages of %u texels\n", ATLAS_MAX_PAGES, pLayout->pageSize);
+                packed = false;
+                break;
+            }
+            initSkylinePacker(&pages[pLayout->pageCount++], pLayout->pageSize, pLayout->pageSize);
+            skylineInsert(&pages[page], width, height, &x, &y);
+        }
+        pEntry->page = page;
+        pEntry->x = x + pLayout->padding;
+        pEntry->y = y + pLayout->padding;
+    }
+    for (uint32_t page = 0; page < pLayout->pageCount; page++) {
+        if (packed) {
+            printf("INFO: atlas page %u: %.1f%% used\n", page, 100.0 * (double)pages[page].usedArea / ((double)pLayout->pageSize * pLayout->pageSize));
+        }
+        destroySkylinePacker(&pages[page]);
+    }
+    free(sorted);
+    return packed;
+}
+
+// Copies the tightly packed RGBA8 pixels of an entry into its page and
+// replicates its outermost texels over the padding around it.
+void atlasBlitEntry(uint8_t *pPage, uint32_t pageSize, uint32_t padding, const AtlasEntry *pEntry, const uint8_t *pPixels) {
+    uint32_t left = pEntry->x - padding;
+    uint32_t top = pEntry->y - padding;
+    for (uint32_t y = 0; y < pEntry->height + 2 * padding; y++) {
+        uint32_t sy = y < padding ? 0 : y - padding < pEntry->height ? y - padding : pEntry->height - 1;
+        const uint8_t *pSrcRow = pPixels + (size_t)sy * pEntry->width * 4;
+        uint8_t *pDstRow = pPage + ((size_t)(top + y) * pageSize + left) * 4;
+        for (uint32_t x = 0; x < padding; x++) {
+            memcpy(pDstRow + (size_t)x * 4, pSrcRow, 4);
+            memcpy(pDstRow + (size_t)(padding + pEntry->width + x) * 4, pSrcRow + (size_t)(pEntry->width - 1) * 4, 4);
+        }
+        memcpy(pDstRow + (size_t)padding * 4, pSrcRow, (size_t)pEntry->width * 4);
+    }
+}
+
+// maps a [0, 1] coordinate of the entry's own texture to the page; wrapping doesn't survive packing, so it is clamped
+void atlasRemapTexCoord(const AtlasLayout *pLayout, const AtlasEntry *pEntry, float texCoord[2]) {
+    float u = texCoord[0] < 0.0f ? 0.0f : texCoord[0] > 1.0f ? 1.0f : texCoord[0];
+    float v = texCoord[1] < 0.0f ? 0.0f : texCoord[1] > 1.0f ? 1.0f : texCoord[1];
+    texCoord[0] = ((float)pEntry->x + u * (float)pEntry->width) / (float)pLayout->pageSize;
+    texCoord[1] = ((float)pEntry->y + v * (float)pEntry->height) / (float)pLayout->pageSize;
+}
+
+const AtlasEntry *atlasFindEntry(const AtlasLayout *pLayout, const char *path) {
+    for (uint32_t i = 0; i < pLayout->entryCount; i++) {
+        if (strcmp(pLayout->entries[i].path, path) == 0) {
+            return &pLayout->entries[i];
+        }
+    }
+    return NULL;
+}
+
+void freeAtlasLayout(AtlasLayout *pLayout) {
+    for (uint32_t i = 0; i < pLayout->entryCount; i++) {
+        free(pLayout->entries[i].path);
+    }
+    for (uint32_t page = 0; page < ATLAS_MAX_PAGES; page++) {
+        free(pLayout->pagePaths[page]);
+        pLayout->pagePaths[page] = NULL;
+    }
+    free(pLayout->entries);
+    pLayout->entries = NULL;
+    pLayout->entryCount = 0;
+    pLayout->pageCount = 0;
+}
+
+// strdup isn't part of C11, the paths are freed by freeAtlasLayout
+char *atlasCopyPath(const char *path) {
+    size_t size = strlen(path) + 1;
+    char *copy = (char *)malloc(size);
+    if (copy == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate atlas path!\n");
+        exit(1);
+    }
+    memcpy(copy, path, size);
+    return copy;
+}
+
+// strips the newline and returns false for blank lines and comments
+bool atlasTrimLine(char *line) {
+    line[strcspn(line, "\r\n")] = '\0';
+    return line[0] != '\0' && line[0] != '#';
+}
+
+bool writeAtlasManifest(const char *path, const AtlasLayout *pLayout) {
+    FILE *pFile = fopen(path, "w");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to write %s\n", path);
+        return false;
+    }
+    fprintf(pFile, "atlas %u %u\n", pLayout->pageSize, pLayout->padding);
+    for (uint32_t page = 0; page < pLayout->pageCount; page++) {
+        fprintf(pFile, "page %s\n", pLayout->pagePaths[page]);
+    }
+    for (uint32_t i = 0; i < pLayout->entryCount; i++) {
+        const AtlasEntry *pEntry = &pLayout->entries[i];
+        fprintf(pFile, "entry %u %u %u %u %u %s\n", pEntry->page, pEntry->x, pEntry->y, pEntry->width, pEntry->height, pEntry->path);
+    }
+    bool written = ferror(pFile) == 0;
+    return fclose(pFile) == 0 && written;
+}
+
+bool readAtlasManifest(const char *path, AtlasLayout *pLayout) {
+    *pLayout = (AtlasLayout){0};
+    FILE *pFile = fopen(path, "r");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open atlas manifest %s\n", path);
+        return false;
+    }
+    char line[ATLAS_MAX_PATH + 64];
+    uint32_t entryCapacity = 0;
+    const char *problem = NULL;
+    while (problem == NULL && fgets(line, sizeof(line), pFile) != NULL) {
+        if (!atlasTrimLine(line)) {
+            continue;
+        }
+        int pathStart = 0;
+        AtlasEntry entry = {0};
+        if (sscanf(line, "atlas %u %u", &pLayout->pageSize, &pLayout->padding) == 2) {
+            if (pLayout->pageSize == 0 || pLayout->padding == 0) {
+                problem = "bad page size or padding";
+            }
+        } else if (strncmp(line, "page ", 5) == 0) {
+            if (pLayout->pageCount == ATLAS_MAX_PAGES) {
+                problem = "too many pages";
+                continue;
+            }
+            pLayout->pagePaths[pLayout->pageCount++] = atlasCopyPath(line + 5);
+        } else if (sscanf(line, "entry %u %u %u %u %u %n", &entry.page, &entry.x, &entry.y, &entry.width, &entry.height, &pathStart) == 5 && pathStart > 0) {
+            if (pLayout->pageSize == 0 || entry.x + entry.width > pLayout->pageSize || entry.y + entry.height > pLayout->pageSize) {
+                problem = "entry outside its page";
+                continue;
+            }
+            if (pLayout->entryCount == entryCapacity) {
+                entryCapacity = entryCapacity == 0 ? 16 : entryCapacity * 2;
+                pLayout->entries = (AtlasEntry *)realloc(pLayout->entries, entryCapacity * sizeof(AtlasEntry));
+            }
+            entry.path = atlasCopyPath(line + pathStart);
+            pLayout->entries[pLayout->entryCount++] = entry;
+        } else {
+            problem = "unknown line";
+        }
+    }
+    fclose(pFile);
+    for (uint32_t i = 0; problem == NULL && i < pLayout->entryCount; i++) {
+        if (pLayout->entries[i].page >= pLayout->pageCount) {
+            problem = "entry on a missing page";
+        }
+    }
+    if (problem == NULL && pLayout->pageCount == 0) {
+        problem = "no pages";
+    }
+    if (problem != NULL) {
+        fprintf(stderr, "ERROR: %s: %s\n", path, problem);
+        freeAtlasLayout(pLayout);
+        return false;
+    }
+    return true;
+}
+
+// decodes any image SDL_image reads into tightly packed RGBA8, NULL on failure
+uint8_t *atlasLoadImageRGBA8(const char *path, uint32_t *pWidth, uint32_t *pHeight) {
+    SDL_Surface *pSurface = IMG_Load(path);
+    if (pSurface == NULL) {
+        fprintf(stderr, "ERROR: image can't load: %s: %s\n", path, SDL_GetError());
+        return NULL;
+    }
+    uint8_t *pPixels = (uint8_t *)calloc((size_t)pSurface->w * pSurface->h, 4);
+    bool converted = false;
+    if (pPixels != NULL && !SDL_ISPIXELFORMAT_INDEXED(pSurface->format->format)) {
+        converted = SDL_ConvertPixels(pSurface->w, pSurface->h, pSurface->format->format, pSurface->pixels, pSurface->pitch,
+                                      SDL_PIXELFORMAT_RGBA32, pPixels, pSurface->w * 4) == 0;
+    } else if (pPixels != NULL) {
+        // SDL_ConvertPixels can't read palettized surfaces, blit into one wrapping the pixels instead
+        SDL_Surface *pTarget = SDL_CreateRGBSurfaceWithFormatFrom(pPixels, pSurface->w, pSurface->h, 32, pSurface->w * 4, SDL_PIXELFORMAT_RGBA32);
+        if (pTarget != NULL) {
+            SDL_SetSurfaceBlendMode(pSurface, SDL_BLENDMODE_NONE);
+            converted = SDL_BlitSurface(pSurface, NULL, pTarget, NULL) == 0;
+            SDL_FreeSurface(pTarget);
+        }
+    }
+    if (!converted) {
+        fprintf(stderr, "ERROR: failed to convert %s to RGBA: %s\n", path, SDL_GetError());
+        free(pPixels);
+        pPixels = NULL;
+    }
+    *pWidth = (uint32_t)pSurface->w;
+    *pHeight = (uint32_t)pSurface->h;
+    SDL_FreeSurface(pSurface);
+    return pPixels;
+}
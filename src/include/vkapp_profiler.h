@@ -0,0 +1,191 @@
+#include <stdlib.h>
+
+// GPU timestamp profiler. Every frame in flight owns a query pool; named
+// scopes write a timestamp pair into the frame's pool while recording, and
+// the results are collected the next time that frame slot records, after its
+// fence has been waited on, so reading them back never stalls. Each marker
+// keeps a rolling window of durations for min/avg/p99.
+
+#define GPU_QUERIES_PER_FRAME (MAX_GPU_MARKERS * 2)
+#define NO_GPU_SCOPE UINT32_MAX
+
+void createGpuProfiler(VkApp *pApp) {
+    GpuProfiler *profiler = &pApp->gpuProfiler;
+    const VkPhysicalDeviceProperties *pProperties = &pApp->deviceProperties;
+
+    QueueFamilyIndices indices = findQueueFamilies(pApp->physicalDevice, pApp->surface);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(pApp->physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties *queueFamilies = (VkQueueFamilyProperties *)malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(pApp->physicalDevice, &queueFamilyCount, queueFamilies);
+    uint32_t validBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+    free(queueFamilies);
+
+    if (validBits == 0 || pProperties->limits.timestampPeriod == 0.0f) {
+        printf("INFO: graphics queue has no timestamp support, GPU profiling disabled\n");
+        profiler->enabled = false;
+        return;
+    }
+    profiler->timestampPeriod = pProperties->limits.timestampPeriod;
+    profiler->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = GPU_QUERIES_PER_FRAME,
+        .pipelineStatistics = 0
+    };
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (vkCreateQueryPool(pApp->device, &poolInfo, NULL, &profiler->queryPools[i]) != VK_SUCCESS) {
+            fprintf(stderr, "ERROR: failed to create timestamp query pool!\n");
+            exit(1);
+        }
+        profiler->scopeCounts[i] = 0;
+    }
+    profiler->enabled = true;
+}
+
+void destroyGpuProfiler(VkApp *pApp) {
+    if (!pApp->gpuProfiler.enabled) {
+        return;
+    }
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroyQueryPool(pApp->device, pApp->gpuProfiler.queryPools[i], NULL);
+    }
+    pApp->gpuProfiler.enabled = false;
+}
+
+uint32_t gpuProfilerMarker(GpuProfiler *profiler, const char *name) {
+    for (uint32_t i = 0; i < profiler->markerCount; i++) {
+        if (strcmp(profiler->markers[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (profiler->markerCount == MAX_GPU_MARKERS) {
+        return NO_GPU_SCOPE;
+    }
+    GpuMarkerStats *marker = &profiler->markers[profiler->markerCount];
+    marker->name = name;
+    marker->sampleCount = 0;
+    marker->nextSample = 0;
+    return profiler->markerCount++;
+}
+
+void gpuMarkerAddSample(GpuMarkerStats *marker, double ms) {
+    marker->samplesMs[marker->nextSample] = ms;
+    marker->nextSample = (marker->nextSample + 1) % GPU_MARKER_HISTORY;
+    if (marker->sampleCount < GPU_MARKER_HISTORY) {
+        marker->sampleCount++;
+    }
+}
+
+// Called right after vkBeginCommandBuffer, once the frame's fence has
+// signalled. Folds last use's timestamps into the stats and resets the pool.
+void gpuProfilerBeginFrame(VkApp *pApp, VkCommandBuffer commandBuffer, uint64_t frameIndex) {
+    GpuProfiler *profiler = &pApp->gpuProfiler;
+    if (!profiler->enabled) {
+        return;
+    }
+    uint32_t frame = pApp->currentFrame;
+    uint32_t scopeCount = profiler->scopeCounts[frame];
+    if (scopeCount > 0 && profiler->poolFrames[frame] >= profiler->firstSampledFrame) {
+        // value, availability pairs
+        uint64_t results[GPU_QUERIES_PER_FRAME * 2];
+        VkResult result = vkGetQueryPoolResults(pApp->device, profiler->queryPools[frame], 0, scopeCount * 2, sizeof(results), results,
+                                                2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result == VK_SUCCESS || result == VK_NOT_READY) {
+            for (uint32_t i = 0; i < scopeCount; i++) {
+                uint64_t *begin = &results[i * 4];
+                uint64_t *end = &results[i * 4 + 2];
+                if (begin[1] == 0 || end[1] == 0 || profiler->scopeMarkers[frame][i] == NO_GPU_SCOPE) {
+                    continue;
+                }
+                uint64_t ticks = (end[0] - begin[0]) & profiler->timestampMask;
+                double ms = (double)ticks * profiler->timestampPeriod * 1e-6;
+                gpuMarkerAddSample(&profiler->markers[profiler->scopeMarkers[frame][i]], ms);
+                // the first scope spans the whole command buffer
+                if (i == 0) {
+                    frameStatsRecord(&pApp->frameStats, FRAME_METRIC_GPU, ms);
+                }
+            }
+        }
+    }
+    vkCmdResetQueryPool(commandBuffer, profiler->queryPools[frame], 0, GPU_QUERIES_PER_FRAME);
+    profiler->scopeCounts[frame] = 0;
+    profiler->poolFrames[frame] = frameIndex;
+}
+
+// returns the scope to hand to gpuProfilerEnd
+uint32_t gpuProfilerBegin(VkApp *pApp, VkCommandBuffer commandBuffer, const char *name) {
+    GpuProfiler *profiler = &pApp->gpuProfiler;
+    uint32_t frame = pApp->currentFrame;
+    if (!profiler->enabled || profiler->scopeCounts[frame] == MAX_GPU_MARKERS) {
+        return NO_GPU_SCOPE;
+    }
+    uint32_t scope = profiler->scopeCounts[frame]++;
+    profiler->scopeMarkers[frame][scope] = gpuProfilerMarker(profiler, name);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->queryPools[frame], scope * 2);
+    return scope;
+}
+
+void gpuProfilerEnd(VkApp *pApp, VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (scope == NO_GPU_SCOPE) {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pApp->gpuProfiler.queryPools[pApp->currentFrame], scope * 2 + 1);
+}
+
+// Render thread only, keeps the markers but forgets their samples. Results
+// come back MAX_FRAMES_IN_FLIGHT frames late, so those of frames recorded
+// before firstFrame are dropped as they arrive rather than counted.
+void gpuProfilerResetStats(VkApp *pApp, uint64_t firstFrame) {
+    GpuProfiler *profiler = &pApp->gpuProfiler;
+    profiler->firstSampledFrame = firstFrame;
+    for (uint32_t i = 0; i < profiler->markerCount; i++) {
+        profiler->markers[i].sampleCount = 0;
+        profiler->markers[i].nextSample = 0;
+    }
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// false if the marker has no samples yet
+bool gpuMarkerSummary(const GpuMarkerStats *marker, double *pMin, double *pAvg, double *pP99) {
+    if (marker->sampleCount == 0) {
+        return false;
+    }
+    double sorted[GPU_MARKER_HISTORY];
+    double sum = 0.0;
+    for (uint32_t i = 0; i < marker->sampleCount; i++) {
+        sorted[i] = marker->samplesMs[i];
+        sum += sorted[i];
+    }
+    qsort(sorted, marker->sampleCount, sizeof(double), compareDoubles);
+    uint32_t p99Index = (uint32_t)(0.99 * (double)(marker->sampleCount - 1) + 0.5);
+    *pMin = sorted[0];
+    *pAvg = sum / (double)marker->sampleCount;
+    *pP99 = sorted[p99Index];
+    return true;
+}
+
+// must run on the thread recording frames, or once that thread has stopped
+void gpuProfilerReport(VkApp *pApp, FILE *pFile) {
+    GpuProfiler *profiler = &pApp->gpuProfiler;
+    if (!profiler->enabled) {
+        return;
+    }
+    fprintf(pFile, "GPU timings over the last %d frames (ms):\n", GPU_MARKER_HISTORY);
+    fprintf(pFile, "  %-20s %9s %9s %9s\n", "marker", "min", "avg", "p99");
+    for (uint32_t i = 0; i < profiler->markerCount; i++) {
+        double min, avg, p99;
+        if (gpuMarkerSummary(&profiler->markers[i], &min, &avg, &p99)) {
+            fprintf(pFile, "  %-20s %9.3f %9.3f %9.3f\n", profiler->markers[i].name, min, avg, p99);
+        }
+    }
+}
@@ -0,0 +1,873 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Render graph. Every frame declares its passes again, in the order they run,
+// with each resource they read or write and how (RenderGraphUsage). Images
+// and buffers owned elsewhere are imported together with the state they are
+// in before the frame and the one they must be left in after it; attachments
+// only the frame needs are declared transient and owned by the graph.
+//
+// Compiling culls the passes nothing depends on: a pass is kept when it writes
+// something imported or something a kept pass after it reads. It then walks
+// the kept passes tracking every resource's layout, last writer and readers
+// since, and places the barriers and layout transitions each pass needs in
+// front of it, one vkCmdPipelineBarrier per pass, plus the moves into the
+// imported resources' final states after the last. Passes with attachments
+// get a render pass whose load and store ops follow from the same walk:
+// contents nobody declared a need for are neither loaded nor stored. The
+// declaration order is a valid order to run in, since a pass can only read
+// what was declared before it, so it is kept. The result only depends on the
+// shape of the frame and not on its handles, so it is reused until a frame is
+// declared differently.
+//
+// Transient images are placed in one memory block by their lifetimes, the
+// first to the last kept pass using them: images whose lifetimes don't
+// overlap may share memory. The first use of a transient in a frame discards
+// its contents and waits on the last use of everything sharing its memory,
+// the previous frame's included. A transient only ever used as an attachment
+// of a single pass is neither loaded nor stored, so it never has to exist
+// outside the tile memory of a tiling GPU: it is created as a transient
+// attachment and, where the device has LAZILY_ALLOCATED memory, gets its own
+// lazily allocated block that may never be backed at all. Multisampled color
+// attachments are resolved in the render pass, into an attachment declared
+// with renderGraphResolve. Everything here runs on the render thread.
+
+#define NO_RENDER_GRAPH_RESOURCE UINT32_MAX
+
+typedef struct {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    bool write;
+    // what a transient image needs to be created with for it
+    VkImageUsageFlags imageUsage;
+} RenderGraphUsageInfo;
+
+const RenderGraphUsageInfo RENDER_GRAPH_USAGES[RENDER_GRAPH_USAGE_COUNT] = {
+    [RENDER_GRAPH_COLOR_ATTACHMENT] = {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                       VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT},
+    [RENDER_GRAPH_DEPTH_ATTACHMENT] = {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT},
+    [RENDER_GRAPH_FRAGMENT_SAMPLED] = {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                       VK_ACCESS_SHADER_READ_BIT, false, VK_IMAGE_USAGE_SAMPLED_BIT},
+    [RENDER_GRAPH_FRAGMENT_STORAGE] = {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true, VK_IMAGE_USAGE_STORAGE_BIT},
+    [RENDER_GRAPH_TRANSFER_SRC] = {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_ACCESS_TRANSFER_READ_BIT, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT},
+    [RENDER_GRAPH_TRANSFER_DST] = {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_ACCESS_TRANSFER_WRITE_BIT, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT},
+    [RENDER_GRAPH_RESOLVE_ATTACHMENT] = {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT}
+};
+
+// usages that only touch an image inside a render pass
+#define RENDER_GRAPH_ATTACHMENT_USAGE (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+
+// the accesses a later access has to be made to wait for, reads need none
+#define RENDER_GRAPH_WRITE_ACCESS (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | \
+                                   VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+// a resource while compiling: its layout, the last write and the reads since
+typedef struct {
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages;
+    // stages the last write has already been made visible to
+    VkPipelineStageFlags visibleStages;
+    // holds something worth loading
+    bool defined;
+} RenderGraphTracker;
+
+void initRenderGraph(RenderGraph *pGraph) {
+    memset(pGraph, 0, sizeof(*pGraph));
+}
+
+// starts declaring a frame; the compiled plan and transients stay
+void renderGraphBegin(RenderGraph *pGraph) {
+    pGraph->resourceCount = 0;
+    pGraph->passCount = 0;
+}
+
+RenderGraphResource *renderGraphAddResource(RenderGraph *pGraph, const char *name, uint32_t *pIndex) {
+    if (pGraph->resourceCount == RENDER_GRAPH_MAX_RESOURCES) {
+        fprintf(stderr, "ERROR: render graph is out of resources (%u) at %s\n", RENDER_GRAPH_MAX_RESOURCES, name);
+        exit(1);
+    }
+    *pIndex = pGraph->resourceCount++;
+    RenderGraphResource *pResource = &pGraph->resources[*pIndex];
+    memset(pResource, 0, sizeof(*pResource));
+    pResource->name = name;
+    return pResource;
+}
+
+uint32_t renderGraphImportImage(RenderGraph *pGraph, const char *name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+                                VkImageAspectFlags aspect, RenderGraphState initial, RenderGraphState final) {
+    uint32_t index;
+    RenderGraphResource *pResource = renderGraphAddResource(pGraph, name, &index);
+    pResource->imported = true;
+    pResource->image = image;
+    pResource->view = view;
+    pResource->format = format;
+    pResource->extent = extent;
+    pResource->aspect = aspect;
+    pResource->samples = VK_SAMPLE_COUNT_1_BIT;
+    pResource->initial = initial;
+    pResource->final = final;
+    return index;
+}
+
+uint32_t renderGraphImportBuffer(RenderGraph *pGraph, const char *name, VkBuffer buffer, RenderGraphState initial, RenderGraphState final) {
+    uint32_t index;
+    RenderGraphResource *pResource = renderGraphAddResource(pGraph, name, &index);
+    pResource->imported = true;
+    pResource->isBuffer = true;
+    pResource->buffer = buffer;
+    pResource->initial = initial;
+    pResource->final = final;
+    return index;
+}
+
+// an image only this frame uses, created by the graph with whatever usages the passes declare
+uint32_t renderGraphCreateImage(RenderGraph *pGraph, const char *name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect, VkSampleCountFlagBits samples) {
+    uint32_t index;
+    RenderGraphResource *pResource = renderGraphAddResource(pGraph, name, &index);
+    pResource->format = format;
+    pResource->extent = extent;
+    pResource->aspect = aspect;
+    pResource->samples = samples;
+    return index;
+}
+
+uint32_t renderGraphAddPass(RenderGraph *pGraph, const char *name, RenderGraphRecordFn record, void *data) {
+    if (pGraph->passCount == RENDER_GRAPH_MAX_PASSES) {
+        fprintf(stderr, "ERROR: render graph is out of passes (%u) at %s\n", RENDER_GRAPH_MAX_PASSES, name);
+        exit(1);
+    }
+    RenderGraphPass *pPass = &pGraph->passes[pGraph->passCount];
+    memset(pPass, 0, sizeof(*pPass));
+    pPass->name = name;
+    pPass->record = record;
+    pPass->data = data;
+    return pGraph->passCount++;
+}
+
+// one access per resource and pass
+RenderGraphAccess *renderGraphUse(RenderGraph *pGraph, uint32_t pass, uint32_t resource, RenderGraphUsage usage) {
+    RenderGraphPass *pPass = &pGraph->passes[pass];
+    for (uint32_t i = 0; i < pPass->accessCount; i++) {
+        if (pPass->accesses[i].resource == resource) {
+            fprintf(stderr, "ERROR: %s uses %s twice\n", pPass->name, pGraph->resources[resource].name);
+            exit(1);
+        }
+    }
+    if (pPass->accessCount == RENDER_GRAPH_MAX_ACCESSES) {
+        fprintf(stderr, "ERROR: %s uses more than %u resources\n", pPass->name, RENDER_GRAPH_MAX_ACCESSES);
+        exit(1);
+    }
+    RenderGraphAccess *pAccess = &pPass->accesses[pPass->accessCount++];
+    memset(pAccess, 0, sizeof(*pAccess));
+    pAccess->resource = resource;
+    pAccess->usage = usage;
+    return pAccess;
+}
+
+// an attachment written from scratch, cleared to clearValue when the pass begins
+void renderGraphClear(RenderGraph *pGraph, uint32_t pass, uint32_t resource, RenderGraphUsage usage, VkClearValue clearValue) {
+    RenderGraphAccess *pAccess = renderGraphUse(pGraph, pass, resource, usage);
+    pAccess->clear = true;
+    pAccess->clearValue = clearValue;
+}
+
+// target is written with the resolved samples of source, a multisampled color attachment of the same pass
+void renderGraphResolve(RenderGraph *pGraph, uint32_t pass, uint32_t source, uint32_t target) {
+    RenderGraphAccess *pAccess = renderGraphUse(pGraph, pass, target, RENDER_GRAPH_RESOLVE_ATTACHMENT);
+    pAccess->resolveSource = source;
+}
+
+bool renderGraphIsAttachment(RenderGraphUsage usage) {
+    return usage == RENDER_GRAPH_COLOR_ATTACHMENT || usage == RENDER_GRAPH_DEPTH_ATTACHMENT || usage == RENDER_GRAPH_RESOLVE_ATTACHMENT;
+}
+
+// FNV-1a, fed field by field so struct padding never counts
+uint64_t renderGraphHashBytes(uint64_t hash, const void *pData, size_t size) {
+    const uint8_t *pBytes = (const uint8_t *)pData;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ pBytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t renderGraphHashState(uint64_t hash, const RenderGraphState *pState) {
+    hash = renderGraphHashBytes(hash, &pState->layout, sizeof(pState->layout));
+    hash = renderGraphHashBytes(hash, &pState->stages, sizeof(pState->stages));
+    return renderGraphHashBytes(hash, &pState->access, sizeof(pState->access));
+}
+
+// everything compiling depends on, which leaves out the handles and clear values
+uint64_t hashRenderGraph(const RenderGraph *pGraph) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = renderGraphHashBytes(hash, &pGraph->resourceCount, sizeof(pGraph->resourceCount));
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        const RenderGraphResource *pResource = &pGraph->resources[i];
+        hash = renderGraphHashBytes(hash, &pResource->imported, sizeof(pResource->imported));
+        hash = renderGraphHashBytes(hash, &pResource->isBuffer, sizeof(pResource->isBuffer));
+        hash = renderGraphHashBytes(hash, &pResource->format, sizeof(pResource->format));
+        hash = renderGraphHashBytes(hash, &pResource->extent.width, sizeof(pResource->extent.width));
+        hash = renderGraphHashBytes(hash, &pResource->extent.height, sizeof(pResource->extent.height));
+        hash = renderGraphHashBytes(hash, &pResource->aspect, sizeof(pResource->aspect));
+        hash = renderGraphHashBytes(hash, &pResource->samples, sizeof(pResource->samples));
+        hash = renderGraphHashState(hash, &pResource->initial);
+        hash = renderGraphHashState(hash, &pResource->final);
+    }
+    hash = renderGraphHashBytes(hash, &pGraph->passCount, sizeof(pGraph->passCount));
+    for (uint32_t i = 0; i < pGraph->passCount; i++) {
+        const RenderGraphPass *pPass = &pGraph->passes[i];
+        hash = renderGraphHashBytes(hash, &pPass->record, sizeof(pPass->record));
+        hash = renderGraphHashBytes(hash, &pPass->accessCount, sizeof(pPass->accessCount));
+        for (uint32_t j = 0; j < pPass->accessCount; j++) {
+            const RenderGraphAccess *pAccess = &pPass->accesses[j];
+            hash = renderGraphHashBytes(hash, &pAccess->resource, sizeof(pAccess->resource));
+            hash = renderGraphHashBytes(hash, &pAccess->usage, sizeof(pAccess->usage));
+            hash = renderGraphHashBytes(hash, &pAccess->clear, sizeof(pAccess->clear));
+            hash = renderGraphHashBytes(hash, &pAccess->resolveSource, sizeof(pAccess->resolveSource));
+        }
+    }
+    return hash;
+}
+
+// walks the passes backwards: a pass is kept if it writes something imported or needed
+// by a kept pass after it; whatever a kept pass touches without clearing or resolving into it is needed in turn
+void renderGraphCull(const RenderGraph *pGraph, bool *pKept) {
+    bool needed[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        needed[i] = pGraph->resources[i].imported;
+    }
+    for (uint32_t i = pGraph->passCount; i-- > 0;) {
+        const RenderGraphPass *pPass = &pGraph->passes[i];
+        pKept[i] = false;
+        for (uint32_t j = 0; j < pPass->accessCount; j++) {
+            const RenderGraphAccess *pAccess = &pPass->accesses[j];
+            if (RENDER_GRAPH_USAGES[pAccess->usage].write && needed[pAccess->resource]) {
+                pKept[i] = true;
+            }
+        }
+        if (!pKept[i]) {
+            continue;
+        }
+        for (uint32_t j = 0; j < pPass->accessCount; j++) {
+            const RenderGraphAccess *pAccess = &pPass->accesses[j];
+            bool discard = pAccess->clear || pAccess->usage == RENDER_GRAPH_RESOLVE_ATTACHMENT;
+            needed[pAccess->resource] = pGraph->resources[pAccess->resource].imported || !discard;
+        }
+    }
+}
+
+bool renderGraphLifetimesOverlap(const uint32_t *pFirst, const uint32_t *pLast, uint32_t a, uint32_t b) {
+    return pFirst[a] <= pLast[b] && pFirst[b] <= pLast[a];
+}
+
+// drops the framebuffers, which may point at transient or swapchain views; the device must be idle
+void renderGraphDestroyFramebuffers(RenderGraph *pGraph, VkApp *pApp) {
+    for (uint32_t i = 0; i < pGraph->framebufferCount; i++) {
+        vkDestroyFramebuffer(pApp->device, pGraph->framebuffers[i].framebuffer, NULL);
+    }
+    pGraph->framebufferCount = 0;
+}
+
+// lazily allocated transients have no shared memory block, so the images are checked too
+bool renderGraphHasTransients(const RenderGraph *pGraph) {
+    const RenderGraphTransients *pTransients = &pGraph->transients;
+    if (pTransients->memory != VK_NULL_HANDLE || pTransients->lazyCount > 0) {
+        return true;
+    }
+    for (uint32_t i = 0; i < RENDER_GRAPH_MAX_RESOURCES; i++) {
+        if (pTransients->images[i] != VK_NULL_HANDLE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void renderGraphDestroyTransients(RenderGraph *pGraph, VkApp *pApp) {
+    RenderGraphTransients *pTransients = &pGraph->transients;
+    for (uint32_t i = 0; i < RENDER_GRAPH_MAX_RESOURCES; i++) {
+        if (pTransients->images[i] != VK_NULL_HANDLE) {
+            vkDestroyImageView(pApp->device, pTransients->views[i], NULL);
+            vkDestroyImage(pApp->device, pTransients->images[i], NULL);
+        }
+        if (pTransients->lazyMemories[i] != VK_NULL_HANDLE) {
+            freeDeviceMemory(pTransients->lazyMemories[i], pApp);
+        }
+    }
+    if (pTransients->memory != VK_NULL_HANDLE) {
+        freeDeviceMemory(pTransients->memory, pApp);
+    }
+    memset(pTransients, 0, sizeof(*pTransients));
+}
+
+// false when the device has no lazily allocated memory the image can use, which is usual outside tiling GPUs
+bool renderGraphFindLazyMemoryType(uint32_t typeFilter, VkPhysicalDevice physicalDevice, uint32_t *pIndex) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            *pIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Creates every transient a kept pass uses. Transient attachments go into
+// lazily allocated memory of their own if there is any; the rest are placed
+// in one block, largest first, each at the lowest offset not overlapping an
+// image already placed whose lifetime overlaps its own.
+void renderGraphAllocateTransients(RenderGraph *pGraph, const uint32_t *pFirst, const uint32_t *pLast, const VkImageUsageFlags *pUsage, VkApp *pApp) {
+    RenderGraphTransients *pTransients = &pGraph->transients;
+    VkMemoryRequirements requirements[RENDER_GRAPH_MAX_RESOURCES];
+    VkDeviceSize offsets[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t order[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t orderCount = 0;
+    uint32_t memoryTypeBits = UINT32_MAX;
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        const RenderGraphResource *pResource = &pGraph->resources[i];
+        if (pResource->imported || pUsage[i] == 0) {
+            continue;
+        }
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = pResource->format,
+            .extent = {pResource->extent.width, pResource->extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = pResource->samples,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = pUsage[i],
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = NULL,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        if (vkCreateImage(pApp->device, &imageInfo, NULL, &pTransients->images[i]) != VK_SUCCESS) {
+            fprintf(stderr, "ERROR: failed to create transient image %s!\n", pResource->name);
+            exit(1);
+        }
+        vkGetImageMemoryRequirements(pApp->device, pTransients->images[i], &requirements[i]);
+        uint32_t lazyType;
+        if ((pUsage[i] & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && renderGraphFindLazyMemoryType(requirements[i].memoryTypeBits, pApp->physicalDevice, &lazyType)) {
+            // nothing to alias with, the memory is only committed as far as the GPU ends up needing it
+            VkMemoryAllocateInfo lazyInfo = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                .pNext = NULL,
+                .allocationSize = requirements[i].size,
+                .memoryTypeIndex = lazyType
+            };
+            if (allocateDeviceMemory(&lazyInfo, &pTransients->lazyMemories[i], pApp) != VK_SUCCESS) {
+                fprintf(stderr, "ERROR: failed to allocate lazy memory for %s!\n", pResource->name);
+                exit(1);
+            }
+            vkBindImageMemory(pApp->device, pTransients->images[i], pTransients->lazyMemories[i], 0);
+            pTransients->views[i] = createImageView(pTransients->images[i], pResource->format, pResource->aspect, pApp);
+            pTransients->aliases[i] = 1u << i;
+            pTransients->lazyCount++;
+            continue;
+        }
+        memoryTypeBits &= requirements[i].memoryTypeBits;
+        uint32_t position = orderCount++;
+        while (position > 0 && requirements[order[position - 1]].size < requirements[i].size) {
+            order[position] = order[position - 1];
+            position--;
+        }
+        order[position] = i;
+    }
+    if (pTransients->lazyCount > 0) {
+        printf("INFO: render graph: %u transient attachments in lazily allocated memory\n", pTransients->lazyCount);
+    }
+    if (orderCount == 0) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < orderCount; i++) {
+        uint32_t resource = order[i];
+        VkDeviceSize alignment = requirements[resource].alignment;
+        VkDeviceSize offset = 0;
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            offset = (offset + alignment - 1) / alignment * alignment;
+            for (uint32_t j = 0; j < i; j++) {
+                uint32_t placed = order[j];
+                if (renderGraphLifetimesOverlap(pFirst, pLast, resource, placed) &&
+                    offset < offsets[placed] + requirements[placed].size && offsets[placed] < offset + requirements[resource].size) {
+                    offset = offsets[placed] + requirements[placed].size;
+                    moved = true;
+                }
+            }
+        }
+        offsets[resource] = offset;
+        if (offset + requirements[resource].size > pTransients->size) {
+            pTransients->size = offset + requirements[resource].size;
+        }
+    }
+    for (uint32_t i = 0; i < orderCount; i++) {
+        for (uint32_t j = 0; j < orderCount; j++) {
+            uint32_t a = order[i];
+            uint32_t b = order[j];
+            if (offsets[a] < offsets[b] + requirements[b].size && offsets[b] < offsets[a] + requirements[a].size) {
+                pTransients->aliases[a] |= 1u << b;
+            }
+        }
+    }
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = pTransients->size,
+        .memoryTypeIndex = findMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pApp->physicalDevice)
+    };
+    if (allocateDeviceMemory(&allocInfo, &pTransients->memory, pApp) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to allocate transient attachment memory!\n");
+        exit(1);
+    }
+    VkDeviceSize separateSize = 0;
+    for (uint32_t i = 0; i < orderCount; i++) {
+        uint32_t resource = order[i];
+        const RenderGraphResource *pResource = &pGraph->resources[resource];
+        vkBindImageMemory(pApp->device, pTransients->images[resource], pTransients->memory, offsets[resource]);
+        pTransients->views[resource] = createImageView(pTransients->images[resource], pResource->format, pResource->aspect, pApp);
+        separateSize += requirements[resource].size;
+    }
+    printf("INFO: render graph: %u transient images in %.1f MiB (%.1f MiB unaliased)\n", orderCount,
+           pTransients->size / (1024.0 * 1024.0), separateSize / (1024.0 * 1024.0));
+}
+
+// render passes are only told the attachments' formats, samples, ops, layouts and resolves, so they are shared by every pass describing them the same
+VkRenderPass renderGraphGetRenderPass(RenderGraph *pGraph, const RenderGraphRenderPass *pKey, const RenderGraphUsage *pUsages, VkApp *pApp) {
+    for (uint32_t i = 0; i < pGraph->renderPassCount; i++) {
+        RenderGraphRenderPass *pCached = &pGraph->renderPasses[i];
+        if (pCached->attachmentCount == pKey->attachmentCount && memcmp(pCached->attachments, pKey->attachments, sizeof(pKey->attachments)) == 0 &&
+            memcmp(pCached->resolves, pKey->resolves, sizeof(pKey->resolves)) == 0) {
+            return pCached->renderPass;
+        }
+    }
+    if (pGraph->renderPassCount == RENDER_GRAPH_MAX_RENDER_PASSES) {
+        fprintf(stderr, "ERROR: render graph is out of render passes (%u)\n", RENDER_GRAPH_MAX_RENDER_PASSES);
+        exit(1);
+    }
+    VkAttachmentReference colorRefs[RENDER_GRAPH_MAX_ACCESSES];
+    // one per color attachment
+    VkAttachmentReference resolveRefs[RENDER_GRAPH_MAX_ACCESSES];
+    uint32_t colorCount = 0;
+    bool hasResolve = false;
+    VkAttachmentReference depthRef = {0};
+    bool hasDepth = false;
+    for (uint32_t i = 0; i < pKey->attachmentCount; i++) {
+        VkAttachmentReference ref = {i, pKey->attachments[i].initialLayout};
+        if (pUsages[i] == RENDER_GRAPH_DEPTH_ATTACHMENT) {
+            depthRef = ref;
+            hasDepth = true;
+        } else if (pUsages[i] == RENDER_GRAPH_COLOR_ATTACHMENT) {
+            uint32_t resolve = pKey->resolves[i];
+            resolveRefs[colorCount] = (VkAttachmentReference){resolve, resolve != VK_ATTACHMENT_UNUSED ? pKey->attachments[resolve].initialLayout : VK_IMAGE_LAYOUT_UNDEFINED};
+            hasResolve |= resolve != VK_ATTACHMENT_UNUSED;
+            colorRefs[colorCount++] = ref;
+        }
+    }
+    VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = colorCount,
+        .pColorAttachments = colorRefs,
+        .pResolveAttachments = hasResolve ? resolveRefs : NULL,
+        .pDepthStencilAttachment = hasDepth ? &depthRef : NULL,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL
+    };
+    // the graph's barriers do every transition and wait, the attachments stay in one layout
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = pKey->attachmentCount,
+        .pAttachments = pKey->attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 0,
+        .pDependencies = NULL
+    };
+    RenderGraphRenderPass *pCached = &pGraph->renderPasses[pGraph->renderPassCount];
+    if (vkCreateRenderPass(pApp->device, &renderPassInfo, NULL, &pCached->renderPass) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create render graph render pass!\n");
+        exit(1);
+    }
+    memcpy(pCached->attachments, pKey->attachments, sizeof(pKey->attachments));
+    memcpy(pCached->resolves, pKey->resolves, sizeof(pKey->resolves));
+    pCached->attachmentCount = pKey->attachmentCount;
+    pGraph->renderPassCount++;
+    return pCached->renderPass;
+}
+
+RenderGraphBarrier *renderGraphAddBarrier(RenderGraphPlan *pPlan, uint32_t resource) {
+    if (pPlan->barrierCount == RENDER_GRAPH_MAX_BARRIERS) {
+        fprintf(stderr, "ERROR: render graph is out of barriers (%u)\n", RENDER_GRAPH_MAX_BARRIERS);
+        exit(1);
+    }
+    RenderGraphBarrier *pBarrier = &pPlan->barriers[pPlan->barrierCount++];
+    pBarrier->resource = resource;
+    return pBarrier;
+}
+
+// points the transient resources of the frame being declared at the graph's images
+void renderGraphBindTransients(RenderGraph *pGraph) {
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        if (!pGraph->resources[i].imported) {
+            pGraph->resources[i].image = pGraph->transients.images[i];
+            pGraph->resources[i].view = pGraph->transients.views[i];
+        }
+    }
+}
+
+// points every color attachment of the step at the attachment it is resolved into
+void renderGraphMatchResolves(const RenderGraph *pGraph, const RenderGraphPass *pPass, const RenderGraphStep *pStep, const RenderGraphUsage *pUsages, RenderGraphRenderPass *pKey) {
+    for (uint32_t i = 0; i < pStep->attachmentCount; i++) {
+        pKey->resolves[i] = VK_ATTACHMENT_UNUSED;
+    }
+    for (uint32_t i = 0; i < pStep->attachmentCount; i++) {
+        if (pUsages[i] != RENDER_GRAPH_RESOLVE_ATTACHMENT) {
+            continue;
+        }
+        uint32_t source = pPass->accesses[pStep->attachments[i]].resolveSource;
+        uint32_t match = VK_ATTACHMENT_UNUSED;
+        for (uint32_t j = 0; j < pStep->attachmentCount; j++) {
+            if (pUsages[j] == RENDER_GRAPH_COLOR_ATTACHMENT && pPass->accesses[pStep->attachments[j]].resource == source) {
+                match = j;
+            }
+        }
+        if (match == VK_ATTACHMENT_UNUSED || pGraph->resources[source].samples == VK_SAMPLE_COUNT_1_BIT || pKey->resolves[match] != VK_ATTACHMENT_UNUSED) {
+            fprintf(stderr, "ERROR: %s resolves %s, which is not one of its multisampled color attachments\n", pPass->name, pGraph->resources[source].name);
+            exit(1);
+        }
+        pKey->resolves[match] = i;
+    }
+}
+
+void renderGraphCompile(RenderGraph *pGraph, VkApp *pApp) {
+    RenderGraphPlan *pPlan = &pGraph->plan;
+    uint64_t hash = hashRenderGraph(pGraph);
+    if (pPlan->compiled && pPlan->hash == hash) {
+        renderGraphBindTransients(pGraph);
+        return;
+    }
+    pGraph->compileCount++;
+
+    bool kept[RENDER_GRAPH_MAX_PASSES];
+    renderGraphCull(pGraph, kept);
+    pPlan->stepCount = 0;
+    pPlan->barrierCount = 0;
+    for (uint32_t i = 0; i < pGraph->passCount; i++) {
+        if (kept[i]) {
+            pPlan->steps[pPlan->stepCount++].pass = i;
+        }
+    }
+
+    // lifetimes, usages and everything touching each resource over the frame
+    uint32_t first[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t last[RENDER_GRAPH_MAX_RESOURCES];
+    VkImageUsageFlags usage[RENDER_GRAPH_MAX_RESOURCES];
+    VkPipelineStageFlags frameStages[RENDER_GRAPH_MAX_RESOURCES];
+    VkAccessFlags frameWrites[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        first[i] = UINT32_MAX;
+        last[i] = 0;
+        usage[i] = 0;
+        frameStages[i] = 0;
+        frameWrites[i] = 0;
+    }
+    for (uint32_t step = 0; step < pPlan->stepCount; step++) {
+        const RenderGraphPass *pPass = &pGraph->passes[pPlan->steps[step].pass];
+        for (uint32_t j = 0; j < pPass->accessCount; j++) {
+            const RenderGraphAccess *pAccess = &pPass->accesses[j];
+            const RenderGraphUsageInfo *pInfo = &RENDER_GRAPH_USAGES[pAccess->usage];
+            uint32_t resource = pAccess->resource;
+            first[resource] = first[resource] < step ? first[resource] : step;
+            last[resource] = step;
+            usage[resource] |= pInfo->imageUsage;
+            frameStages[resource] |= pInfo->stages;
+            frameWrites[resource] |= pInfo->access & RENDER_GRAPH_WRITE_ACCESS;
+        }
+    }
+    // attachments of a single pass are never loaded or stored, so their contents can stay on chip
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        if (!pGraph->resources[i].imported && usage[i] != 0 && (usage[i] & ~RENDER_GRAPH_ATTACHMENT_USAGE) == 0 && first[i] == last[i]) {
+            usage[i] |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+    }
+
+    uint64_t transientHash = 14695981039346656037ull;
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        const RenderGraphResource *pResource = &pGraph->resources[i];
+        if (pResource->imported || usage[i] == 0) {
+            continue;
+        }
+        transientHash = renderGraphHashBytes(transientHash, &i, sizeof(i));
+        transientHash = renderGraphHashBytes(transientHash, &pResource->format, sizeof(pResource->format));
+        transientHash = renderGraphHashBytes(transientHash, &pResource->extent.width, sizeof(pResource->extent.width));
+        transientHash = renderGraphHashBytes(transientHash, &pResource->extent.height, sizeof(pResource->extent.height));
+        transientHash = renderGraphHashBytes(transientHash, &pResource->aspect, sizeof(pResource->aspect));
+        transientHash = renderGraphHashBytes(transientHash, &pResource->samples, sizeof(pResource->samples));
+        transientHash = renderGraphHashBytes(transientHash, &usage[i], sizeof(usage[i]));
+        transientHash = renderGraphHashBytes(transientHash, &first[i], sizeof(first[i]));
+        transientHash = renderGraphHashBytes(transientHash, &last[i], sizeof(last[i]));
+    }
+    if (pGraph->transients.hash != transientHash) {
+        // only after a resize or a new kind of frame; earlier frames may still use the old images
+        if (renderGraphHasTransients(pGraph)) {
+            vkDeviceWaitIdle(pApp->device);
+            renderGraphDestroyFramebuffers(pGraph, pApp);
+            renderGraphDestroyTransients(pGraph, pApp);
+        }
+        renderGraphAllocateTransients(pGraph, first, last, usage, pApp);
+        pGraph->transients.hash = transientHash;
+    }
+    renderGraphBindTransients(pGraph);
+
+    RenderGraphTracker trackers[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        const RenderGraphResource *pResource = &pGraph->resources[i];
+        RenderGraphTracker *pTracker = &trackers[i];
+        memset(pTracker, 0, sizeof(*pTracker));
+        if (pResource->imported) {
+            pTracker->layout = pResource->initial.layout;
+            pTracker->writeStages = pResource->initial.stages;
+            pTracker->writeAccess = pResource->initial.access;
+            pTracker->defined = pResource->isBuffer || pResource->initial.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+            continue;
+        }
+        // whatever last touched this memory, in this frame or the one before
+        pTracker->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        for (uint32_t j = 0; j < pGraph->resourceCount; j++) {
+            if (pGraph->transients.aliases[i] & (1u << j)) {
+                pTracker->writeStages |= frameStages[j];
+                pTracker->writeAccess |= frameWrites[j];
+            }
+        }
+    }
+
+    for (uint32_t step = 0; step < pPlan->stepCount; step++) {
+        RenderGraphStep *pStep = &pPlan->steps[step];
+        const RenderGraphPass *pPass = &pGraph->passes[pStep->pass];
+        RenderGraphRenderPass key;
+        memset(&key, 0, sizeof(key));
+        RenderGraphUsage attachmentUsages[RENDER_GRAPH_MAX_ACCESSES];
+        pStep->firstBarrier = pPlan->barrierCount;
+        pStep->attachmentCount = 0;
+        for (uint32_t j = 0; j < pPass->accessCount; j++) {
+            const RenderGraphAccess *pAccess = &pPass->accesses[j];
+            const RenderGraphUsageInfo *pInfo = &RENDER_GRAPH_USAGES[pAccess->usage];
+            const RenderGraphResource *pResource = &pGraph->resources[pAccess->resource];
+            RenderGraphTracker *pTracker = &trackers[pAccess->resource];
+
+            // cleared or resolved into, the old contents don't have to survive
+            bool discard = pAccess->clear || pAccess->usage == RENDER_GRAPH_RESOLVE_ATTACHMENT;
+            bool layoutChange = !pResource->isBuffer && pTracker->layout != pInfo->layout;
+            bool needed;
+            if (pInfo->write) {
+                needed = layoutChange || pTracker->writeStages != 0 || pTracker->readStages != 0;
+            } else {
+                needed = layoutChange || (pTracker->writeStages != 0 && (pInfo->stages & ~pTracker->visibleStages) != 0);
+            }
+            if (needed) {
+                RenderGraphBarrier *pBarrier = renderGraphAddBarrier(pPlan, pAccess->resource);
+                pBarrier->src.layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : pTracker->layout;
+                pBarrier->src.stages = pTracker->writeStages | pTracker->readStages;
+                pBarrier->src.access = pTracker->writeAccess;
+                pBarrier->dst.layout = pInfo->layout;
+                pBarrier->dst.stages = pInfo->stages;
+                pBarrier->dst.access = pInfo->access;
+            }
+
+            if (renderGraphIsAttachment(pAccess->usage)) {
+                VkAttachmentDescription *pAttachment = &key.attachments[pStep->attachmentCount];
+                pAttachment->format = pResource->format;
+                pAttachment->samples = pResource->samples;
+                pAttachment->loadOp = pAccess->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : pTracker->defined && !discard ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                pAttachment->storeOp = pResource->imported || last[pAccess->resource] > step ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                pAttachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                pAttachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                pAttachment->initialLayout = pInfo->layout;
+                pAttachment->finalLayout = pInfo->layout;
+                attachmentUsages[pStep->attachmentCount] = pAccess->usage;
+                pStep->attachments[pStep->attachmentCount++] = j;
+            }
+
+            if (pInfo->write) {
+                pTracker->writeStages = pInfo->stages;
+                pTracker->writeAccess = pInfo->access & RENDER_GRAPH_WRITE_ACCESS;
+                pTracker->readStages = 0;
+                pTracker->visibleStages = 0;
+                pTracker->defined = true;
+            } else {
+                pTracker->readStages |= pInfo->stages;
+                if (needed) {
+                    pTracker->visibleStages |= pInfo->stages;
+                }
+            }
+            if (!pResource->isBuffer) {
+                pTracker->layout = pInfo->layout;
+            }
+        }
+        pStep->barrierCount = pPlan->barrierCount - pStep->firstBarrier;
+        renderGraphMatchResolves(pGraph, pPass, pStep, attachmentUsages, &key);
+        key.attachmentCount = pStep->attachmentCount;
+        pStep->renderPass = pStep->attachmentCount > 0 ? renderGraphGetRenderPass(pGraph, &key, attachmentUsages, pApp) : VK_NULL_HANDLE;
+    }
+
+    pPlan->firstFinalBarrier = pPlan->barrierCount;
+    for (uint32_t i = 0; i < pGraph->resourceCount; i++) {
+        const RenderGraphResource *pResource = &pGraph->resources[i];
+        const RenderGraphTracker *pTracker = &trackers[i];
+        if (!pResource->imported) {
+            continue;
+        }
+        bool layoutChange = !pResource->isBuffer && pResource->final.layout != VK_IMAGE_LAYOUT_UNDEFINED && pResource->final.layout != pTracker->layout;
+        if (!layoutChange && (pTracker->writeAccess == 0 || pResource->final.access == 0)) {
+            continue;
+        }
+        RenderGraphBarrier *pBarrier = renderGraphAddBarrier(pPlan, i);
+        pBarrier->src.layout = pTracker->layout;
+        pBarrier->src.stages = pTracker->writeStages | pTracker->readStages;
+        pBarrier->src.access = pTracker->writeAccess;
+        pBarrier->dst = pResource->final;
+        if (!layoutChange) {
+            pBarrier->dst.layout = pTracker->layout;
+        }
+    }
+    pPlan->finalBarrierCount = pPlan->barrierCount - pPlan->firstFinalBarrier;
+    pPlan->hash = hash;
+    pPlan->compiled = true;
+}
+
+// the barriers of one step in a single vkCmdPipelineBarrier
+void renderGraphRecordBarriers(const RenderGraph *pGraph, uint32_t firstBarrier, uint32_t barrierCount, BarrierBatch *pBatch) {
+    for (uint32_t i = firstBarrier; i < firstBarrier + barrierCount; i++) {
+        const RenderGraphBarrier *pBarrier = &pGraph->plan.barriers[i];
+        const RenderGraphResource *pResource = &pGraph->resources[pBarrier->resource];
+        if (pResource->isBuffer) {
+            barrierBatchBuffer(pBatch, pResource->buffer, 0, VK_WHOLE_SIZE, pBarrier->src.stages, pBarrier->src.access, pBarrier->dst.stages, pBarrier->dst.access);
+            continue;
+        }
+        VkImageAspectFlags aspect = pResource->aspect;
+        if ((aspect & VK_IMAGE_ASPECT_DEPTH_BIT) && hasStencilComponent(pResource->format)) {
+            aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        VkImageSubresourceRange range = {aspect, 0, 1, 0, 1};
+        barrierBatchImage(pBatch, pResource->image, range, pBarrier->src.layout, pBarrier->dst.layout,
+                          pBarrier->src.stages, pBarrier->src.access, pBarrier->dst.stages, pBarrier->dst.access);
+    }
+    barrierBatchFlush(pBatch);
+}
+
+// framebuffers are kept per render pass and set of views until the swapchain or the transients change
+VkFramebuffer renderGraphGetFramebuffer(RenderGraph *pGraph, const RenderGraphStep *pStep, VkExtent2D *pExtent, VkApp *pApp) {
+    const RenderGraphPass *pPass = &pGraph->passes[pStep->pass];
+    RenderGraphFramebuffer key;
+    memset(&key, 0, sizeof(key));
+    key.renderPass = pStep->renderPass;
+    key.viewCount = pStep->attachmentCount;
+    key.extent = pGraph->resources[pPass->accesses[pStep->attachments[0]].resource].extent;
+    for (uint32_t i = 0; i < pStep->attachmentCount; i++) {
+        key.views[i] = pGraph->resources[pPass->accesses[pStep->attachments[i]].resource].view;
+    }
+    *pExtent = key.extent;
+    for (uint32_t i = 0; i < pGraph->framebufferCount; i++) {
+        RenderGraphFramebuffer *pCached = &pGraph->framebuffers[i];
+        if (pCached->renderPass == key.renderPass && pCached->viewCount == key.viewCount && pCached->extent.width == key.extent.width &&
+            pCached->extent.height == key.extent.height && memcmp(pCached->views, key.views, sizeof(key.views)) == 0) {
+            return pCached->framebuffer;
+        }
+    }
+    if (pGraph->framebufferCount == RENDER_GRAPH_MAX_FRAMEBUFFERS) {
+        fprintf(stderr, "ERROR: render graph is out of framebuffers (%u)\n", RENDER_GRAPH_MAX_FRAMEBUFFERS);
+        exit(1);
+    }
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = key.renderPass,
+        .attachmentCount = key.viewCount,
+        .pAttachments = key.views,
+        .width = key.extent.width,
+        .height = key.extent.height,
+        .layers = 1
+    };
+    if (vkCreateFramebuffer(pApp->device, &framebufferInfo, NULL, &key.framebuffer) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: vulkan unable to create framebuffer!\n");
+        exit(1);
+    }
+    pGraph->framebuffers[pGraph->framebufferCount++] = key;
+    return key.framebuffer;
+}
+
+// compiles the declared frame if its shape changed and records it
+void renderGraphExecute(RenderGraph *pGraph, VkCommandBuffer commandBuffer, VkApp *pApp) {
+    renderGraphCompile(pGraph, pApp);
+    const RenderGraphPlan *pPlan = &pGraph->plan;
+    BarrierBatch barriers;
+    initBarrierBatch(&barriers, commandBuffer);
+    for (uint32_t step = 0; step < pPlan->stepCount; step++) {
+        const RenderGraphStep *pStep = &pPlan->steps[step];
+        const RenderGraphPass *pPass = &pGraph->passes[pStep->pass];
+        renderGraphRecordBarriers(pGraph, pStep->firstBarrier, pStep->barrierCount, &barriers);
+        uint32_t scope = gpuProfilerBegin(pApp, commandBuffer, pPass->name);
+        if (pStep->renderPass == VK_NULL_HANDLE) {
+            pPass->record(pApp, commandBuffer, pPass->data);
+            gpuProfilerEnd(pApp, commandBuffer, scope);
+            continue;
+        }
+        VkClearValue clearValues[RENDER_GRAPH_MAX_ACCESSES];
+        for (uint32_t i = 0; i < pStep->attachmentCount; i++) {
+            clearValues[i] = pPass->accesses[pStep->attachments[i]].clearValue;
+        }
+        VkExtent2D extent;
+        VkRenderPassBeginInfo renderPassInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = NULL,
+            .renderPass = pStep->renderPass,
+            .framebuffer = renderGraphGetFramebuffer(pGraph, pStep, &extent, pApp),
+            .renderArea.offset.x = 0,
+            .renderArea.offset.y = 0,
+            .renderArea.extent = extent,
+            .clearValueCount = pStep->attachmentCount,
+            .pClearValues = clearValues
+        };
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        pPass->record(pApp, commandBuffer, pPass->data);
+        vkCmdEndRenderPass(commandBuffer);
+        gpuProfilerEnd(pApp, commandBuffer, scope);
+    }
+    renderGraphRecordBarriers(pGraph, pPlan->firstFinalBarrier, pPlan->finalBarrierCount, &barriers);
+}
+
+// before the swapchain goes away, with the device idle; the next frame recompiles
+void renderGraphReleaseTargets(RenderGraph *pGraph, VkApp *pApp) {
+    renderGraphDestroyFramebuffers(pGraph, pApp);
+    renderGraphDestroyTransients(pGraph, pApp);
+    pGraph->plan.compiled = false;
+}
+
+void destroyRenderGraph(RenderGraph *pGraph, VkApp *pApp) {
+    printf("INFO: render graph: compiled %llu times, %u render passes\n", (unsigned long long)pGraph->compileCount, pGraph->renderPassCount);
+    renderGraphReleaseTargets(pGraph, pApp);
+    for (uint32_t i = 0; i < pGraph->renderPassCount; i++) {
+        vkDestroyRenderPass(pApp->device, pGraph->renderPasses[i].renderPass, NULL);
+    }
+    pGraph->renderPassCount = 0;
+}
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Sampler cache. A sampler only describes how to filter and address, so every
+// texture asking for the same state gets the same VkSampler instead of its own;
+// devices may cap the number of live samplers as low as 4000
+// (maxSamplerAllocationCount). Requests are clamped to the device limits
+// before the lookup, so asking for more anisotropy than the device has lands on
+// the same sampler as asking for exactly that. The handful of distinct states
+// a scene uses is searched linearly. Samplers live until destroySamplerCache.
+
+#define SAMPLER_CACHE_INITIAL_CAPACITY 8
+
+void initSamplerCache(SamplerCache *pCache) {
+    pCache->capacity = SAMPLER_CACHE_INITIAL_CAPACITY;
+    pCache->entries = (SamplerCacheEntry *)calloc(pCache->capacity, sizeof(SamplerCacheEntry));
+    pCache->count = 0;
+    pCache->hits = 0;
+}
+
+// zeroed first so keys can be compared as bytes
+void samplerKeyInit(SamplerKey *pKey, VkFilter filter, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressMode) {
+    memset(pKey, 0, sizeof(*pKey));
+    pKey->magFilter = filter;
+    pKey->minFilter = filter;
+    pKey->mipmapMode = mipmapMode;
+    pKey->addressModeU = addressMode;
+    pKey->addressModeV = addressMode;
+    pKey->addressModeW = addressMode;
+    pKey->maxAnisotropy = 0.0f;
+    pKey->minLod = 0.0f;
+    pKey->maxLod = VK_LOD_CLAMP_NONE;
+}
+
+VkSampler createSamplerFromKey(const SamplerKey *pKey, VkApp *pApp) {
+    VkSamplerCreateInfo samplerInfo = {0};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = pKey->magFilter;
+    samplerInfo.minFilter = pKey->minFilter;
+    samplerInfo.addressModeU = pKey->addressModeU;
+    samplerInfo.addressModeV = pKey->addressModeV;
+    samplerInfo.addressModeW = pKey->addressModeW;
+    samplerInfo.anisotropyEnable = pKey->maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = pKey->maxAnisotropy > 1.0f ? pKey->maxAnisotropy : 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = pKey->mipmapMode;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = pKey->minLod;
+    samplerInfo.maxLod = pKey->maxLod;
+    VkSampler sampler;
+    if (vkCreateSampler(pApp->device, &samplerInfo, NULL, &sampler) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create sampler!\n");
+        exit(1);
+    }
+    return sampler;
+}
+
+// the shared sampler for this state, created on first use
+VkSampler samplerCacheGet(SamplerCache *pCache, const SamplerKey *pRequested, VkApp *pApp) {
+    SamplerKey key = *pRequested;
+    float maxAnisotropy = pApp->deviceProperties.limits.maxSamplerAnisotropy;
+    if (key.maxAnisotropy > maxAnisotropy) {
+        key.maxAnisotropy = maxAnisotropy;
+    }
+    if (key.maxAnisotropy <= 1.0f) {
+        key.maxAnisotropy = 0.0f;
+    }
+    for (uint32_t i = 0; i < pCache->count; i++) {
+        if (memcmp(&pCache->entries[i].key, &key, sizeof(key)) == 0) {
+            pCache->hits++;
+            return pCache->entries[i].sampler;
+        }
+    }
+    if (pCache->count == pApp->deviceProperties.limits.maxSamplerAllocationCount) {
+        fprintf(stderr, "ERROR: out of samplers, the device allows %u\n", pApp->deviceProperties.limits.maxSamplerAllocationCount);
+        exit(1);
+    }
+    if (pCache->count == pCache->capacity) {
+        pCache->capacity *= 2;
+        pCache->entries = (SamplerCacheEntry *)realloc(pCache->entries, pCache->capacity * sizeof(SamplerCacheEntry));
+    }
+    SamplerCacheEntry *pEntry = &pCache->entries[pCache->count++];
+    pEntry->key = key;
+    pEntry->sampler = createSamplerFromKey(&key, pApp);
+    return pEntry->sampler;
+}
+
+void destroySamplerCache(SamplerCache *pCache, VkApp *pApp) {
+    printf("INFO: sampler cache: %u samplers, %llu shared requests\n", pCache->count, (unsigned long long)pCache->hits);
+    for (uint32_t i = 0; i < pCache->count; i++) {
+        vkDestroySampler(pApp->device, pCache->entries[i].sampler, NULL);
+    }
+    free(pCache->entries);
+    pCache->entries = NULL;
+    pCache->count = 0;
+}
@@ -0,0 +1,838 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Batch render service for --serve <socket>. The device, pipeline and
+// texture stay resident from app_initVulkan, meshes stay resident once a job
+// has asked for them, and render targets are kept per batch slot and only
+// rebuilt when a job changes their size. Every request that is pending when
+// the service wakes up, from any client, goes into one command buffer and
+// one submit.
+//
+// Requests are one line each:
+//   <mesh.obj> <width> <height> <eye x> <eye y> <eye z> <target x> <target y> <target z> [<eye xyz> <target xyz>]...
+// and are answered in order with either
+//   OK <width> <height> <byte count>\n followed by BGRA8 sRGB pixels, top row first
+//   ERR <reason>\n
+// A line reading "quit" stops the service.
+//
+// A request with several cameras is drawn once, with a multiview render
+// pass writing camera i into layer i of the target, so the geometry is only
+// submitted once for all of them. The images follow each other in the reply
+// in request order and the byte count covers all of them. Devices without
+// multiview only take single camera requests.
+//
+// Sockets are non-blocking and replies are queued per client, so a client
+// that stops reading only holds up itself: its queue is flushed whenever
+// poll says the socket has room, and no more of its requests are taken
+// until the queue has drained.
+
+#define SERVICE_MAX_BATCH 8
+#define SERVICE_MAX_MESHES 16
+#define SERVICE_MAX_CLIENTS 16
+#define SERVICE_MAX_LINE 1024
+#define SERVICE_MAX_EXTENT 4096
+#define SERVICE_FOV_DEGREES 45.0f
+#define SERVICE_NEAR_PLANE 0.1f
+#define SERVICE_FAR_PLANE 100.0f
+
+typedef struct {
+    char path[SERVICE_MAX_LINE];
+    bool loaded;
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexBufferMemory;
+    VkBuffer indexBuffer;
+    VkDeviceMemory indexBufferMemory;
+    uint32_t indexCount;
+    // batch that last drew it, for eviction
+    uint64_t lastUsed;
+} ServiceMesh;
+
+// one per batch slot
+typedef struct {
+    VkExtent2D extent;
+    VkImage colorImage;
+    VkDeviceMemory colorImageMemory;
+    VkImageView colorImageView;
+    VkImage depthImage;
+    VkDeviceMemory depthImageMemory;
+    VkImageView depthImageView;
+    VkFramebuffer framebuffer;
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackMemory;
+    // views the framebuffer was built for
+    uint32_t viewCount;
+    VkDeviceSize readbackSize;
+    void *readbackMapped;
+    bool readbackCoherent;
+    VkBuffer uniformBuffer;
+    VkDeviceMemory uniformBufferMemory;
+    void *uniformBufferMapped;
+    VkDescriptorSet descriptorSet;
+} ServiceTarget;
+
+typedef struct {
+    int fd;
+    char buffer[SERVICE_MAX_LINE];
+    size_t length;
+    // replies not yet taken by the socket, output[outputSent..outputLength)
+    char *output;
+    size_t outputLength;
+    size_t outputSent;
+    size_t outputCapacity;
+    // close once the output has drained, nothing more is read
+    bool hangUp;
+} ServiceClient;
+
+typedef struct {
+    uint32_t client;
+    // the slot may be reused by a new connection before the reply
+    int fd;
+    char meshPath[SERVICE_MAX_LINE];
+    VkExtent2D extent;
+    uint32_t viewCount;
+    vec3 eyes[MULTIVIEW_MAX_VIEWS];
+    vec3 targets[MULTIVIEW_MAX_VIEWS];
+    ServiceMesh *pMesh;
+    const char *error;
+} ServiceJob;
+
+typedef struct {
+    const char *path;
+    int listenFd;
+    ServiceClient clients[SERVICE_MAX_CLIENTS];
+    // where the next batch starts taking requests, so one busy client can't starve the rest
+    uint32_t nextClient;
+    ServiceMesh meshes[SERVICE_MAX_MESHES];
+    ServiceTarget targets[SERVICE_MAX_BATCH];
+    // largest width or height a job may ask for
+    uint32_t maxExtent;
+    // indexed by view count, 1 is the app's own pass and pipeline
+    uint32_t maxViews;
+    VkRenderPass renderPasses[MULTIVIEW_MAX_VIEWS + 1];
+    VkPipeline pipelines[MULTIVIEW_MAX_VIEWS + 1];
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    uint64_t batchCount;
+    uint64_t jobCount;
+    bool quit;
+} RenderService;
+
+volatile sig_atomic_t serviceStopRequested = 0;
+
+void serviceHandleSignal(int signal) {
+    (void)signal;
+    serviceStopRequested = 1;
+}
+
+bool serviceOpenSocket(RenderService *pService) {
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(pService->path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: socket path too long: %s\n", pService->path);
+        return false;
+    }
+    strcpy(address.sun_path, pService->path);
+    // a stale socket from a previous run would make bind fail
+    unlink(pService->path);
+
+    pService->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (pService->listenFd < 0) {
+        fprintf(stderr, "ERROR: unable to create socket: %s\n", strerror(errno));
+        return false;
+    }
+    if (bind(pService->listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(pService->listenFd, SERVICE_MAX_CLIENTS) != 0) {
+        fprintf(stderr, "ERROR: unable to listen on %s: %s\n", pService->path, strerror(errno));
+        close(pService->listenFd);
+        return false;
+    }
+    return true;
+}
+
+void serviceCloseClient(ServiceClient *pClient) {
+    close(pClient->fd);
+    pClient->fd = -1;
+    pClient->length = 0;
+    pClient->outputLength = 0;
+    pClient->outputSent = 0;
+    pClient->hangUp = false;
+}
+
+bool serviceOutputPending(const ServiceClient *pClient) {
+    return pClient->fd >= 0 && pClient->outputSent < pClient->outputLength;
+}
+
+void serviceAcceptClient(RenderService *pService) {
+    int fd = accept(pService->listenFd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        close(fd);
+        return;
+    }
+    for (uint32_t i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        if (pService->clients[i].fd < 0) {
+            pService->clients[i].fd = fd;
+            pService->clients[i].length = 0;
+            return;
+        }
+    }
+    // fits in an empty socket buffer, and if not the client is dropped anyway
+    const char *busy = "ERR too many clients\n";
+    send(fd, busy, strlen(busy), MSG_NOSIGNAL);
+    close(fd);
+}
+
+void serviceQueue(ServiceClient *pClient, const void *data, size_t size) {
+    if (pClient->outputSent == pClient->outputLength) {
+        pClient->outputLength = 0;
+        pClient->outputSent = 0;
+    }
+    if (pClient->outputLength + size > pClient->outputCapacity && pClient->outputSent > 0) {
+        // drop what has been sent before growing
+        memmove(pClient->output, pClient->output + pClient->outputSent, pClient->outputLength - pClient->outputSent);
+        pClient->outputLength -= pClient->outputSent;
+        pClient->outputSent = 0;
+    }
+    if (pClient->outputLength + size > pClient->outputCapacity) {
+        size_t capacity = pClient->outputCapacity > 0 ? pClient->outputCapacity : SERVICE_MAX_LINE;
+        while (capacity < pClient->outputLength + size) {
+            capacity *= 2;
+        }
+        char *output = (char *)realloc(pClient->output, capacity);
+        if (output == NULL) {
+            fprintf(stderr, "ERROR: out of memory queueing a render service reply!\n");
+            exit(1);
+        }
+        pClient->output = output;
+        pClient->outputCapacity = capacity;
+    }
+    memcpy(pClient->output + pClient->outputLength, data, size);
+    pClient->outputLength += size;
+}
+
+// sends as much of the queue as the socket takes without blocking
+void serviceFlushClient(ServiceClient *pClient) {
+    while (pClient->outputSent < pClient->outputLength) {
+        ssize_t sent = send(pClient->fd, pClient->output + pClient->outputSent, pClient->outputLength - pClient->outputSent, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (sent <= 0) {
+            serviceCloseClient(pClient);
+            return;
+        }
+        pClient->outputSent += (size_t)sent;
+    }
+    if (pClient->hangUp) {
+        serviceCloseClient(pClient);
+    }
+}
+
+// only called once poll says there is data
+void serviceReadClient(ServiceClient *pClient) {
+    ssize_t received = recv(pClient->fd, pClient->buffer + pClient->length, SERVICE_MAX_LINE - pClient->length, 0);
+    if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (received <= 0) {
+        serviceCloseClient(pClient);
+        return;
+    }
+    pClient->length += (size_t)received;
+    if (pClient->length == SERVICE_MAX_LINE && memchr(pClient->buffer, '\n', pClient->length) == NULL) {
+        // after any replies still queued for it
+        const char *tooLong = "ERR request too long\n";
+        pClient->length = 0;
+        pClient->hangUp = true;
+        serviceQueue(pClient, tooLong, strlen(tooLong));
+        serviceFlushClient(pClient);
+    }
+}
+
+// pops the next complete line off the client's buffer, without the newline
+bool serviceNextLine(ServiceClient *pClient, char *line) {
+    // a client with replies still queued waits until it has read them
+    if (pClient->fd < 0 || pClient->hangUp || serviceOutputPending(pClient)) {
+        return false;
+    }
+    char *newline = (char *)memchr(pClient->buffer, '\n', pClient->length);
+    if (newline == NULL) {
+        return false;
+    }
+    size_t lineLength = (size_t)(newline - pClient->buffer);
+    memcpy(line, pClient->buffer, lineLength);
+    line[lineLength] = '\0';
+    if (lineLength > 0 && line[lineLength - 1] == '\r') {
+        line[lineLength - 1] = '\0';
+    }
+    pClient->length -= lineLength + 1;
+    memmove(pClient->buffer, newline + 1, pClient->length);
+    return true;
+}
+
+void serviceParseJob(const char *line, ServiceJob *pJob, uint32_t maxExtent, uint32_t maxViews) {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    int consumed = 0;
+    char format[64];
+    // field width keeps the path inside meshPath
+    snprintf(format, sizeof(format), "%%%ds %%u %%u %%n", SERVICE_MAX_LINE - 1);
+    int fields = sscanf(line, format, pJob->meshPath, &width, &height, &consumed);
+    pJob->pMesh = NULL;
+    pJob->error = NULL;
+    pJob->viewCount = 0;
+
+    // then eye and target pairs, six floats per camera
+    float values[MULTIVIEW_MAX_VIEWS * 6];
+    uint32_t valueCount = 0;
+    const char *cursor = line + consumed;
+    while (fields == 3 && valueCount <= MULTIVIEW_MAX_VIEWS * 6) {
+        char *end;
+        float value = strtof(cursor, &end);
+        if (end == cursor) {
+            break;
+        }
+        if (valueCount < MULTIVIEW_MAX_VIEWS * 6) {
+            values[valueCount] = value;
+        }
+        valueCount++;
+        cursor = end;
+    }
+    while (*cursor == ' ' || *cursor == '\t') {
+        cursor++;
+    }
+    if (fields == 3 && valueCount > MULTIVIEW_MAX_VIEWS * 6) {
+        pJob->error = "too many views for this device";
+        return;
+    }
+    if (fields != 3 || *cursor != '\0' || valueCount == 0 || valueCount % 6 != 0) {
+        pJob->error = "expected: <mesh> <width> <height> <eye x y z> <target x y z> [<eye x y z> <target x y z>]...";
+        return;
+    }
+    if (valueCount / 6 > maxViews) {
+        pJob->error = "too many views for this device";
+        return;
+    }
+    if (width == 0 || height == 0 || width > maxExtent || height > maxExtent) {
+        pJob->error = "unsupported resolution";
+        return;
+    }
+    pJob->extent = (VkExtent2D){width, height};
+    pJob->viewCount = valueCount / 6;
+    for (uint32_t i = 0; i < pJob->viewCount; i++) {
+        glm_vec3_copy(&values[i * 6], pJob->eyes[i]);
+        glm_vec3_copy(&values[i * 6 + 3], pJob->targets[i]);
+    }
+}
+
+// Takes requests from every client round robin until the batch is full.
+// Returns the number of jobs, including ones that already failed to parse.
+uint32_t serviceCollectJobs(RenderService *pService, ServiceJob *jobs) {
+    char line[SERVICE_MAX_LINE];
+    uint32_t jobCount = 0;
+    bool progress = true;
+    while (progress && jobCount < SERVICE_MAX_BATCH && !pService->quit) {
+        progress = false;
+        for (uint32_t n = 0; n < SERVICE_MAX_CLIENTS && jobCount < SERVICE_MAX_BATCH; n++) {
+            uint32_t c = (pService->nextClient + n) % SERVICE_MAX_CLIENTS;
+            ServiceClient *pClient = &pService->clients[c];
+            if (!serviceNextLine(pClient, line)) {
+                continue;
+            }
+            progress = true;
+            if (strcmp(line, "quit") == 0) {
+                pService->quit = true;
+                break;
+            }
+            if (line[0] == '\0') {
+                continue;
+            }
+            ServiceJob *pJob = &jobs[jobCount++];
+            pJob->client = c;
+            pJob->fd = pClient->fd;
+            serviceParseJob(line, pJob, pService->maxExtent, pService->maxViews);
+        }
+    }
+    pService->nextClient = (pService->nextClient + 1) % SERVICE_MAX_CLIENTS;
+    return jobCount;
+}
+
+void serviceUnloadMesh(ServiceMesh *pMesh, VkApp *pApp) {
+    vkDestroyBuffer(pApp->device, pMesh->vertexBuffer, NULL);
+    freeDeviceMemory(pMesh->vertexBufferMemory, pApp);
+    vkDestroyBuffer(pApp->device, pMesh->indexBuffer, NULL);
+    freeDeviceMemory(pMesh->indexBufferMemory, pApp);
+    pMesh->loaded = false;
+}
+
+// Cached meshes are reused as is, misses are parsed and uploaded, evicting
+// the least recently drawn mesh the current batch doesn't use. NULL if the
+// file can't be loaded. Only called while the device is idle.
+ServiceMesh *serviceFindMesh(RenderService *pService, const char *path, VkApp *pApp) {
+    ServiceMesh *pVictim = NULL;
+    for (uint32_t i = 0; i < SERVICE_MAX_MESHES; i++) {
+        ServiceMesh *pMesh = &pService->meshes[i];
+        if (pMesh->loaded && strcmp(pMesh->path, path) == 0) {
+            pMesh->lastUsed = pService->batchCount;
+            return pMesh;
+        }
+    }
+    for (uint32_t i = 0; i < SERVICE_MAX_MESHES && (pVictim == NULL || pVictim->loaded); i++) {
+        ServiceMesh *pMesh = &pService->meshes[i];
+        if (!pMesh->loaded || (pMesh->lastUsed != pService->batchCount && (pVictim == NULL || pMesh->lastUsed < pVictim->lastUsed))) {
+            pVictim = pMesh;
+        }
+    }
+    // can't happen while SERVICE_MAX_MESHES >= SERVICE_MAX_BATCH
+    if (pVictim == NULL) {
+        return NULL;
+    }
+
+    // tinyobj has no way to report a missing file
+    FILE *pFile = fopen(path, "r");
+    if (pFile == NULL) {
+        return NULL;
+    }
+    fclose(pFile);
+    Vertex *vertices;
+    uint32_t vertexCount;
+    uint32_t *indices;
+    uint32_t indexCount;
+    bool loaded;
+    TRACE_SCOPE("service_model_parse", loaded = loadModelFile(path, &vertices, &vertexCount, &indices, &indexCount));
+    if (!loaded || vertexCount == 0 || indexCount == 0) {
+        if (loaded) {
+            free(vertices);
+            free(indices);
+        }
+        return NULL;
+    }
+
+    if (pVictim->loaded) {
+        printf("INFO: render service evicting %s\n", pVictim->path);
+        serviceUnloadMesh(pVictim, pApp);
+    }
+    createDeviceLocalBuffer(vertices, sizeof(Vertex) * vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &pVictim->vertexBuffer, &pVictim->vertexBufferMemory, pApp);
+    createDeviceLocalBuffer(indices, sizeof(uint32_t) * indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &pVictim->indexBuffer, &pVictim->indexBufferMemory, pApp);
+    free(vertices);
+    free(indices);
+    snprintf(pVictim->path, SERVICE_MAX_LINE, "%s", path);
+    pVictim->indexCount = indexCount;
+    pVictim->lastUsed = pService->batchCount;
+    pVictim->loaded = true;
+    printf("INFO: render service loaded %s, %u vertices\n", path, vertexCount);
+    return pVictim;
+}
+
+void serviceDestroyTargetImages(ServiceTarget *pTarget, VkApp *pApp) {
+    if (pTarget->framebuffer == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyFramebuffer(pApp->device, pTarget->framebuffer, NULL);
+    vkDestroyImageView(pApp->device, pTarget->colorImageView, NULL);
+    vkDestroyImage(pApp->device, pTarget->colorImage, NULL);
+    freeDeviceMemory(pTarget->colorImageMemory, pApp);
+    vkDestroyImageView(pApp->device, pTarget->depthImageView, NULL);
+    vkDestroyImage(pApp->device, pTarget->depthImage, NULL);
+    freeDeviceMemory(pTarget->depthImageMemory, pApp);
+    pTarget->framebuffer = VK_NULL_HANDLE;
+    pTarget->extent = (VkExtent2D){0, 0};
+    pTarget->viewCount = 0;
+}
+
+// rebuilds the slot's images only when the size or view count changed, the readback buffer only grows
+void serviceEnsureTarget(RenderService *pService, ServiceTarget *pTarget, VkExtent2D extent, uint32_t viewCount, VkApp *pApp) {
+    if (pTarget->framebuffer == VK_NULL_HANDLE || pTarget->extent.width != extent.width || pTarget->extent.height != extent.height || pTarget->viewCount != viewCount) {
+        serviceDestroyTargetImages(pTarget, pApp);
+        createLayeredImage(extent.width, extent.height, 1, viewCount, OFFSCREEN_COLOR_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pTarget->colorImage, &pTarget->colorImageMemory, pApp);
+        pTarget->colorImageView = createLayeredImageView(pTarget->colorImage, OFFSCREEN_COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, viewCount, pApp);
+        VkFormat depthFormat = pApp->depthFormat;
+        createLayeredImage(extent.width, extent.height, 1, viewCount, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pTarget->depthImage, &pTarget->depthImageMemory, pApp);
+        pTarget->depthImageView = createLayeredImageView(pTarget->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1, viewCount, pApp);
+
+        VkImageView attachments[] = {pTarget->colorImageView, pTarget->depthImageView};
+        VkFramebufferCreateInfo framebufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .renderPass = pService->renderPasses[viewCount],
+            .attachmentCount = 2,
+            .pAttachments = attachments,
+            .width = extent.width,
+            .height = extent.height,
+            // multiview picks the layers through the view mask
+            .layers = 1
+        };
+        if (vkCreateFramebuffer(pApp->device, &framebufferInfo, NULL, &pTarget->framebuffer) != VK_SUCCESS) {
+            fprintf(stderr, "ERROR: vulkan unable to create framebuffer!\n");
+            exit(1);
+        }
+        pTarget->extent = extent;
+        pTarget->viewCount = viewCount;
+    }
+
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4 * viewCount;
+    if (pTarget->readbackSize < size) {
+        if (pTarget->readbackSize > 0) {
+            vkUnmapMemory(pApp->device, pTarget->readbackMemory);
+            vkDestroyBuffer(pApp->device, pTarget->readbackBuffer, NULL);
+            freeDeviceMemory(pTarget->readbackMemory, pApp);
+        }
+        createReadbackBuffer(size, &pTarget->readbackBuffer, &pTarget->readbackMemory, &pTarget->readbackMapped, &pTarget->readbackCoherent, pApp);
+        pTarget->readbackSize = size;
+    }
+}
+
+void createRenderService(RenderService *pService, VkApp *pApp) {
+    const VkPhysicalDeviceLimits *pLimits = &pApp->deviceProperties.limits;
+    pService->maxExtent = pLimits->maxImageDimension2D < SERVICE_MAX_EXTENT ? pLimits->maxImageDimension2D : SERVICE_MAX_EXTENT;
+
+    pService->renderPasses[1] = pApp->renderPass;
+    pService->pipelines[1] = pApp->graphicsPipeline;
+    pService->maxViews = pApp->maxMultiviewViews < pLimits->maxImageArrayLayers ? pApp->maxMultiviewViews : pLimits->maxImageArrayLayers;
+    if (pService->maxViews > 1) {
+        ShaderFile vertexShaderFile;
+        ShaderFile fragmentShaderFile;
+        loadShaderFile("shaders/multiview_vert.spv", &vertexShaderFile);
+        loadShaderFile("shaders/frag.spv", &fragmentShaderFile);
+        VkShaderModule vertexShaderModule = createShaderModule(pApp, &vertexShaderFile);
+        VkShaderModule fragmentShaderModule = createShaderModule(pApp, &fragmentShaderFile);
+        for (uint32_t views = 2; views <= pService->maxViews; views++) {
+            createRenderPassWithViews(pApp, views, VK_SAMPLE_COUNT_1_BIT, &pService->renderPasses[views]);
+            createPipelineForPass(pApp, vertexShaderModule, fragmentShaderModule, pService->renderPasses[views], VK_SAMPLE_COUNT_1_BIT, &pService->pipelines[views]);
+        }
+        vkDestroyShaderModule(pApp->device, fragmentShaderModule, NULL);
+        vkDestroyShaderModule(pApp->device, vertexShaderModule, NULL);
+        free(vertexShaderFile.byteCode);
+        free(fragmentShaderFile.byteCode);
+        printf("INFO: render service draws up to %u cameras per job with multiview\n", pService->maxViews);
+    }
+
+    for (uint32_t i = 0; i < SERVICE_MAX_BATCH; i++) {
+        ServiceTarget *pTarget = &pService->targets[i];
+        // big enough for either shader's uniforms
+        createBuffer(sizeof(MultiviewCameraUniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pTarget->uniformBuffer, &pTarget->uniformBufferMemory, pApp);
+        vkMapMemory(pApp->device, pTarget->uniformBufferMemory, 0, sizeof(MultiviewCameraUniformBufferObject), 0, &pTarget->uniformBufferMapped);
+        pTarget->descriptorSet = getDescriptorSet(pTarget->uniformBuffer, sizeof(MultiviewCameraUniformBufferObject), pApp);
+    }
+
+    VkCommandBufferAllocateInfo commandBufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = pApp->commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+    VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0
+    };
+    if (vkAllocateCommandBuffers(pApp->device, &commandBufferInfo, &pService->commandBuffer) != VK_SUCCESS ||
+        vkCreateFence(pApp->device, &fenceInfo, NULL, &pService->fence) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create render service command buffer!\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        pService->clients[i].fd = -1;
+    }
+}
+
+void destroyRenderService(RenderService *pService, VkApp *pApp) {
+    for (uint32_t i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+        if (pService->clients[i].fd >= 0) {
+            serviceCloseClient(&pService->clients[i]);
+        }
+        free(pService->clients[i].output);
+    }
+    close(pService->listenFd);
+    unlink(pService->path);
+
+    for (uint32_t i = 0; i < SERVICE_MAX_MESHES; i++) {
+        if (pService->meshes[i].loaded) {
+            serviceUnloadMesh(&pService->meshes[i], pApp);
+        }
+    }
+    for (uint32_t i = 0; i < SERVICE_MAX_BATCH; i++) {
+        ServiceTarget *pTarget = &pService->targets[i];
+        serviceDestroyTargetImages(pTarget, pApp);
+        if (pTarget->readbackSize > 0) {
+            vkUnmapMemory(pApp->device, pTarget->readbackMemory);
+            vkDestroyBuffer(pApp->device, pTarget->readbackBuffer, NULL);
+            freeDeviceMemory(pTarget->readbackMemory, pApp);
+        }
+        descriptorCacheEvict(&pApp->descriptorCache, pTarget->uniformBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE);
+        vkDestroyBuffer(pApp->device, pTarget->uniformBuffer, NULL);
+        freeDeviceMemory(pTarget->uniformBufferMemory, pApp);
+    }
+    for (uint32_t views = 2; views <= pService->maxViews; views++) {
+        vkDestroyPipeline(pApp->device, pService->pipelines[views], NULL);
+        vkDestroyRenderPass(pApp->device, pService->renderPasses[views], NULL);
+    }
+    vkFreeCommandBuffers(pApp->device, pApp->commandPool, 1, &pService->commandBuffer);
+    vkDestroyFence(pApp->device, pService->fence, NULL);
+}
+
+void serviceRecordJob(RenderService *pService, VkApp *pApp, VkCommandBuffer commandBuffer, const ServiceJob *pJob, ServiceTarget *pTarget) {
+    mat4 proj;
+    glm_perspective(glm_rad(SERVICE_FOV_DEGREES), pJob->extent.width / (float)pJob->extent.height, SERVICE_NEAR_PLANE, SERVICE_FAR_PLANE, proj);
+    proj[1][1] *= -1;
+    if (pJob->viewCount == 1) {
+        CameraUniformBufferObject ubo;
+        glm_lookat((float *)pJob->eyes[0], (float *)pJob->targets[0], (vec3){0.0f, 0.0f, 1.0f}, ubo.view);
+        glm_mat4_copy(proj, ubo.proj);
+        memcpy(pTarget->uniformBufferMapped, &ubo, sizeof(ubo));
+    } else {
+        MultiviewCameraUniformBufferObject ubo = {0};
+        for (uint32_t i = 0; i < pJob->viewCount; i++) {
+            glm_lookat((float *)pJob->eyes[i], (float *)pJob->targets[i], (vec3){0.0f, 0.0f, 1.0f}, ubo.view[i]);
+            glm_mat4_copy(proj, ubo.proj[i]);
+        }
+        memcpy(pTarget->uniformBufferMapped, &ubo, sizeof(ubo));
+    }
+
+    VkClearValue clearColors[2];
+    clearColors[0].color = (VkClearColorValue){{0.0f, 0.0f, 0.0f, 1.0f}};
+    clearColors[1].depthStencil = (VkClearDepthStencilValue){1.0f, 0};
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = pService->renderPasses[pJob->viewCount],
+        .framebuffer = pTarget->framebuffer,
+        .renderArea.offset.x = 0,
+        .renderArea.offset.y = 0,
+        .renderArea.extent = pJob->extent,
+        .clearValueCount = 2,
+        .pClearValues = clearColors
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pService->pipelines[pJob->viewCount]);
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)pJob->extent.width,
+        .height = (float)pJob->extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {
+        .offset = {0, 0},
+        .extent = pJob->extent
+    };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &pJob->pMesh->vertexBuffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, pJob->pMesh->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pApp->pipelineLayout, 0, 1, &pTarget->descriptorSet, 0, NULL);
+    // meshes are rendered where they are
+    mat4 model = GLM_MAT4_IDENTITY_INIT;
+    DrawPushConstants drawConstants = {0};
+    memcpy(drawConstants.model, model, sizeof(drawConstants.model));
+    vkCmdPushConstants(commandBuffer, pApp->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, DRAW_PUSH_MODEL_OFFSET, sizeof(drawConstants.model), drawConstants.model);
+    vkCmdDrawIndexed(commandBuffer, pJob->pMesh->indexCount, 1, 0, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+
+    // the offscreen render pass already leaves the image in TRANSFER_SRC_OPTIMAL
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = pTarget->colorImage,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, pJob->viewCount}
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+
+    VkBufferImageCopy region = {0};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    // layers are tightly packed one after another, in view order
+    region.imageSubresource.layerCount = pJob->viewCount;
+    region.imageExtent = (VkExtent3D){pJob->extent.width, pJob->extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, pTarget->colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pTarget->readbackBuffer, 1, &region);
+
+    VkBufferMemoryBarrier toHost = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = pTarget->readbackBuffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &toHost, 0, NULL);
+}
+
+void serviceReply(RenderService *pService, const ServiceJob *pJob, const ServiceTarget *pTarget) {
+    ServiceClient *pClient = &pService->clients[pJob->client];
+    if (pClient->fd != pJob->fd) {
+        // hung up while the batch was rendering
+        return;
+    }
+    // queued, since the readback buffer is reused by the next batch
+    char header[SERVICE_MAX_LINE];
+    if (pJob->error != NULL) {
+        snprintf(header, sizeof(header), "ERR %s\n", pJob->error);
+        serviceQueue(pClient, header, strlen(header));
+    } else {
+        size_t size = (size_t)pJob->extent.width * pJob->extent.height * 4 * pJob->viewCount;
+        snprintf(header, sizeof(header), "OK %u %u %zu\n", pJob->extent.width, pJob->extent.height, size);
+        serviceQueue(pClient, header, strlen(header));
+        serviceQueue(pClient, pTarget->readbackMapped, size);
+    }
+    serviceFlushClient(pClient);
+}
+
+// one command buffer and one submit for the whole batch
+void serviceRunBatch(RenderService *pService, ServiceJob *jobs, uint32_t jobCount, VkApp *pApp) {
+    uint64_t batchStart = traceBegin();
+    pService->batchCount++;
+    for (uint32_t i = 0; i < jobCount; i++) {
+        if (jobs[i].error == NULL) {
+            jobs[i].pMesh = serviceFindMesh(pService, jobs[i].meshPath, pApp);
+            if (jobs[i].pMesh == NULL) {
+                jobs[i].error = "unable to load mesh";
+            }
+        }
+    }
+
+    VkCommandBuffer commandBuffer = pService->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL
+    };
+    vkResetCommandBuffer(commandBuffer, 0);
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: unable to begin recording render service batch!\n");
+        exit(1);
+    }
+    uint32_t recorded = 0;
+    for (uint32_t i = 0; i < jobCount; i++) {
+        if (jobs[i].error == NULL) {
+            serviceEnsureTarget(pService, &pService->targets[i], jobs[i].extent, jobs[i].viewCount, pApp);
+            serviceRecordJob(pService, pApp, commandBuffer, &jobs[i], &pService->targets[i]);
+            recorded++;
+        }
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to record render service batch!\n");
+        exit(1);
+    }
+
+    if (recorded > 0) {
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = NULL,
+            .waitSemaphoreCount = 0,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer,
+            .signalSemaphoreCount = 0
+        };
+        if (vkQueueSubmit(pApp->graphicsQueue, 1, &submitInfo, pService->fence) != VK_SUCCESS) {
+            fprintf(stderr, "ERROR: failed to submit render service batch!\n");
+            exit(1);
+        }
+        TRACE_SCOPE("service_wait", vkWaitForFences(pApp->device, 1, &pService->fence, VK_TRUE, UINT64_MAX));
+        vkResetFences(pApp->device, 1, &pService->fence);
+    }
+
+    for (uint32_t i = 0; i < jobCount; i++) {
+        if (jobs[i].error == NULL) {
+            invalidateReadbackMemory(pService->targets[i].readbackMemory, pService->targets[i].readbackCoherent, pApp);
+        }
+        serviceReply(pService, &jobs[i], &pService->targets[i]);
+    }
+    pService->jobCount += recorded;
+    traceEnd("service_batch", batchStart);
+}
+
+void app_serve(VkApp *pApp) {
+    if (pApp->surface != VK_NULL_HANDLE) {
+        fprintf(stderr, "ERROR: --serve renders offscreen, it can't be combined with --headless-surface\n");
+        exit(1);
+    }
+    RenderService *pService = (RenderService *)calloc(1, sizeof(RenderService));
+    if (pService == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate the render service\n");
+        exit(1);
+    }
+    pService->path = pApp->servicePath;
+    if (!serviceOpenSocket(pService)) {
+        free(pService);
+        return;
+    }
+    createRenderService(pService, pApp);
+    signal(SIGINT, serviceHandleSignal);
+    signal(SIGTERM, serviceHandleSignal);
+    printf("INFO: render service listening on %s\n", pService->path);
+
+    ServiceJob jobs[SERVICE_MAX_BATCH];
+    while (!pService->quit && !serviceStopRequested) {
+        uint32_t jobCount = serviceCollectJobs(pService, jobs);
+        if (jobCount > 0) {
+            serviceRunBatch(pService, jobs, jobCount, pApp);
+            continue;
+        }
+        if (pService->quit) {
+            break;
+        }
+
+        struct pollfd fds[SERVICE_MAX_CLIENTS + 1];
+        fds[0] = (struct pollfd){.fd = pService->listenFd, .events = POLLIN, .revents = 0};
+        for (uint32_t i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+            // poll skips negative descriptors; requests from a client with
+            // queued output stay in the socket until it has caught up
+            ServiceClient *pClient = &pService->clients[i];
+            short events = serviceOutputPending(pClient) ? POLLOUT : POLLIN;
+            fds[i + 1] = (struct pollfd){.fd = pClient->fd, .events = events, .revents = 0};
+        }
+        if (poll(fds, SERVICE_MAX_CLIENTS + 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "ERROR: render service poll failed: %s\n", strerror(errno));
+            break;
+        }
+        for (uint32_t i = 0; i < SERVICE_MAX_CLIENTS; i++) {
+            ServiceClient *pClient = &pService->clients[i];
+            if (fds[i + 1].revents == 0 || pClient->fd < 0) {
+                continue;
+            }
+            if (serviceOutputPending(pClient)) {
+                serviceFlushClient(pClient);
+            } else {
+                serviceReadClient(pClient);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            serviceAcceptClient(pService);
+        }
+    }
+
+    vkDeviceWaitIdle(pApp->device);
+    printf("INFO: render service rendered %llu images in %llu batches\n", (unsigned long long)pService->jobCount, (unsigned long long)pService->batchCount);
+    destroyRenderService(pService, pApp);
+    free(pService);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
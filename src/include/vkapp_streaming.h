@@ -0,0 +1,509 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Texture streaming. Every streamed texture keeps a small tail, the levels no
+// bigger than STREAMING_TAIL_SIZE, resident from startup on; finer levels
+// only come in when the GPU asks for them. bindless.frag writes the finest
+// level each bindless slot was sampled at into the feedback buffer, and once
+// a frame's fence has signalled the streamer turns that into the level every
+// texture wants. A worker job reads the missing levels (only those levels of
+// a .ktx2, the whole image for anything else) into a staging buffer, the
+// render thread uploads them into a new image holding the wanted level and
+// everything coarser, and once that upload is done the texture switches to a
+// new bindless slot. The old image and slot are freed MAX_FRAMES_IN_FLIGHT
+// frames later, when no frame can sample them anymore.
+//
+// Detail images count against the budget; when a new one doesn't fit, the
+// least recently sampled textures fall back to their tail, and if that still
+// isn't enough the request is made coarser until it fits.
+
+#define STREAMING_MAX_TEXTURES 64
+#define STREAMING_TAIL_SIZE 64
+// detail images waiting for the last frames that may sample them
+#define STREAMING_MAX_RETIRED (STREAMING_MAX_TEXTURES * 2)
+// loads started per frame, keeps a camera cut from flooding the job system
+#define STREAMING_MAX_REQUESTS_PER_FRAME 2
+#define NO_STREAMED_TEXTURE UINT32_MAX
+
+typedef enum {
+    STREAM_REQUEST_IDLE,
+    // a job is reading the levels into the staging buffer
+    STREAM_REQUEST_LOADING,
+    STREAM_REQUEST_LOADED,
+    // the upload is submitted, waiting on the request fence
+    STREAM_REQUEST_UPLOADING
+} StreamRequestState;
+
+typedef struct {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    uint32_t slot;
+    // level of the full texture the image's level 0 is
+    uint32_t baseLevel;
+    VkDeviceSize size;
+} StreamedImage;
+
+typedef struct {
+    const char *path;
+    TextureStreamer *pStreamer;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    // .ktx2 sources read single levels, the index is kept to find them
+    bool ktx;
+    KtxTexture ktxIndex;
+    // permanently resident, also what the texture falls back to
+    StreamedImage tail;
+    // finer than the tail once streamed in, image is VK_NULL_HANDLE otherwise
+    StreamedImage detail;
+    // finest level the GPU sampled, and on which frame, for LRU eviction
+    uint32_t wantedLevel;
+    uint64_t lastUsedFrame;
+    // failed loads aren't retried
+    bool failed;
+
+    atomic_int requestState;
+    bool requestFailed;
+    uint32_t requestLevel;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    VkBufferImageCopy regions[KTX2_MAX_LEVELS];
+    uint32_t regionCount;
+    StreamedImage pending;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+} StreamedTexture;
+
+typedef struct {
+    StreamedImage image;
+    uint64_t frame;
+} RetiredStreamedImage;
+
+struct TextureStreamer {
+    VkApp *pApp;
+    VkSampler sampler;
+    VkDeviceSize budget;
+    // detail images, retired ones included until they are destroyed
+    VkDeviceSize residentBytes;
+    // the retired part of residentBytes, already given up and counted as free by the budget
+    VkDeviceSize retiringBytes;
+    StreamedTexture textures[STREAMING_MAX_TEXTURES];
+    uint32_t textureCount;
+    // the slot and first level each texture had when a frame slot was recorded,
+    // its feedback is relative to those
+    uint32_t recordedSlots[MAX_FRAMES_IN_FLIGHT][STREAMING_MAX_TEXTURES];
+    uint32_t recordedLevels[MAX_FRAMES_IN_FLIGHT][STREAMING_MAX_TEXTURES];
+    RetiredStreamedImage retired[STREAMING_MAX_RETIRED];
+    uint32_t retiredCount;
+    uint64_t frame;
+    JobCounter loads;
+    uint64_t streamedInCount;
+    uint64_t evictedCount;
+};
+
+VkDeviceSize streamedLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+    return ktxIsSupportedFormat(format) ? (VkDeviceSize)ktxLevelSize(width, height) : (VkDeviceSize)width * height * 4;
+}
+
+// bytes of an image holding firstLevel and every coarser level
+VkDeviceSize streamedImageSize(const StreamedTexture *pTexture, uint32_t firstLevel) {
+    VkDeviceSize size = 0;
+    for (uint32_t level = firstLevel; level < pTexture->mipLevels; level++) {
+        size += streamedLevelSize(pTexture->format, mipLevelExtent(pTexture->width, level), mipLevelExtent(pTexture->height, level));
+    }
+    return size;
+}
+
+uint32_t streamedTailLevel(const StreamedTexture *pTexture) {
+    uint32_t level = 0;
+    while (level + 1 < pTexture->mipLevels &&
+           (mipLevelExtent(pTexture->width, level) > STREAMING_TAIL_SIZE || mipLevelExtent(pTexture->height, level) > STREAMING_TAIL_SIZE)) {
+        level++;
+    }
+    return level;
+}
+
+const StreamedImage *streamedCurrentImage(const StreamedTexture *pTexture) {
+    return pTexture->detail.image != VK_NULL_HANDLE ? &pTexture->detail : &pTexture->tail;
+}
+
+// Fills a new staging buffer with requestLevel and every coarser level, and the copy regions
+// for an image whose level 0 is requestLevel. Runs on a job thread, or the caller's for the tail.
+bool streamReadLevels(StreamedTexture *pTexture, VkApp *pApp) {
+    uint32_t firstLevel = pTexture->requestLevel;
+    VkDeviceSize size = streamedImageSize(pTexture, firstLevel);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pTexture->stagingBuffer, &pTexture->stagingMemory, pApp);
+    void *pMapped;
+    vkMapMemory(pApp->device, pTexture->stagingMemory, 0, size, 0, &pMapped);
+    uint8_t *pDst = (uint8_t *)pMapped;
+
+    bool read = true;
+    size_t chainOffsets[KTX2_MAX_LEVELS];
+    uint8_t *pChain = NULL;
+    if (!pTexture->ktx) {
+        // no per level access, decode the whole image and build the chain on the CPU
+        SDL_Surface *pSurface = IMG_Load(pTexture->path);
+        pChain = pSurface != NULL ? (uint8_t *)malloc(mipChainSize(pTexture->width, pTexture->height, pTexture->mipLevels)) : NULL;
+        read = pChain != NULL && (uint32_t)pSurface->w == pTexture->width && (uint32_t)pSurface->h == pTexture->height &&
+               textureConvertRGBA8(pSurface, pChain);
+        if (read) {
+            buildMipChainRGBA8(pChain, pTexture->width, pTexture->height, pTexture->mipLevels, true, pChain, chainOffsets);
+        } else {
+            fprintf(stderr, "ERROR: unable to stream %s: %s\n", pTexture->path, SDL_GetError());
+        }
+        if (pSurface != NULL) {
+            SDL_FreeSurface(pSurface);
+        }
+    }
+
+    VkDeviceSize offset = 0;
+    pTexture->regionCount = 0;
+    for (uint32_t level = firstLevel; read && level < pTexture->mipLevels; level++) {
+        uint32_t width = mipLevelExtent(pTexture->width, level);
+        uint32_t height = mipLevelExtent(pTexture->height, level);
+        VkDeviceSize levelSize = streamedLevelSize(pTexture->format, width, height);
+        if (pTexture->ktx) {
+            read = readKtx2Level(pTexture->path, &pTexture->ktxIndex, level, pDst + offset);
+        } else {
+            memcpy(pDst + offset, pChain + chainOffsets[level], (size_t)levelSize);
+        }
+        VkBufferImageCopy *pRegion = &pTexture->regions[pTexture->regionCount++];
+        *pRegion = (VkBufferImageCopy){0};
+        pRegion->bufferOffset = offset;
+        pRegion->imageSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, level - firstLevel, 0, 1};
+        pRegion->imageExtent = (VkExtent3D){width, height, 1};
+        offset += levelSize;
+    }
+    free(pChain);
+    vkUnmapMemory(pApp->device, pTexture->stagingMemory);
+    if (!read) {
+        vkDestroyBuffer(pApp->device, pTexture->stagingBuffer, NULL);
+        freeDeviceMemory(pTexture->stagingMemory, pApp);
+        pTexture->stagingBuffer = VK_NULL_HANDLE;
+    }
+    return read;
+}
+
+void streamLoadJob(void *data) {
+    StreamedTexture *pTexture = (StreamedTexture *)data;
+    pTexture->requestFailed = !streamReadLevels(pTexture, pTexture->pStreamer->pApp);
+    atomic_store_explicit(&pTexture->requestState, STREAM_REQUEST_LOADED, memory_order_release);
+}
+
+// creates the image for the staged levels and records their upload, leaving it shader readable
+void streamRecordUpload(StreamedTexture *pTexture, VkCommandBuffer commandBuffer, StreamedImage *pImage, VkApp *pApp) {
+    uint32_t levels = pTexture->mipLevels - pTexture->requestLevel;
+    pImage->baseLevel = pTexture->requestLevel;
+    pImage->size = streamedImageSize(pTexture, pTexture->requestLevel);
+    createLayeredImage(mipLevelExtent(pTexture->width, pImage->baseLevel), mipLevelExtent(pTexture->height, pImage->baseLevel), levels, 1, pTexture->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pImage->image, &pImage->memory, pApp);
+    pImage->view = createLayeredImageView(pImage->image, pTexture->format, VK_IMAGE_ASPECT_COLOR_BIT, levels, 1, pApp);
+
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pImage->image;
+    barrier.subresourceRange = (VkImageSubresourceRange){VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    vkCmdCopyBufferToImage(commandBuffer, pTexture->stagingBuffer, pImage->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pTexture->regionCount, pTexture->regions);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void streamFreeStaging(StreamedTexture *pTexture, VkApp *pApp) {
+    if (pTexture->stagingBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(pApp->device, pTexture->stagingBuffer, NULL);
+        freeDeviceMemory(pTexture->stagingMemory, pApp);
+        pTexture->stagingBuffer = VK_NULL_HANDLE;
+    }
+}
+
+void destroyStreamedImage(StreamedImage *pImage, VkApp *pApp) {
+    vkDestroyImageView(pApp->device, pImage->view, NULL);
+    vkDestroyImage(pApp->device, pImage->image, NULL);
+    freeDeviceMemory(pImage->memory, pApp);
+    *pImage = (StreamedImage){0};
+}
+
+// frees the image and slot once every frame that may sample them has finished
+void streamRetire(TextureStreamer *pStreamer, StreamedImage *pImage) {
+    if (pStreamer->retiredCount == STREAMING_MAX_RETIRED) {
+        // can't happen with a request per texture at a time, each retires at most one image per frame
+        fprintf(stderr, "ERROR: too many retired streamed images\n");
+        exit(1);
+    }
+    pStreamer->retired[pStreamer->retiredCount++] = (RetiredStreamedImage){*pImage, pStreamer->frame};
+    pStreamer->retiringBytes += pImage->size;
+    *pImage = (StreamedImage){0};
+}
+
+void createTextureStreamer(TextureStreamer *pStreamer, VkDeviceSize budget, VkSampler sampler, VkApp *pApp) {
+    memset(pStreamer, 0, sizeof(TextureStreamer));
+    pStreamer->pApp = pApp;
+    pStreamer->sampler = sampler;
+    pStreamer->budget = budget;
+    initJobCounter(&pStreamer->loads);
+}
+
+// Loads the tail right away and returns the texture's index, NO_STREAMED_TEXTURE with a message
+// on stderr if it can't be read. Needs the command pool; call before the first frame.
+uint32_t textureStreamerAdd(TextureStreamer *pStreamer, const char *path, VkApp *pApp) {
+    if (pStreamer->textureCount == STREAMING_MAX_TEXTURES) {
+        fprintf(stderr, "ERROR: more than %u streamed textures\n", STREAMING_MAX_TEXTURES);
+        return NO_STREAMED_TEXTURE;
+    }
+    StreamedTexture *pTexture = &pStreamer->textures[pStreamer->textureCount];
+    memset(pTexture, 0, sizeof(StreamedTexture));
+    pTexture->path = path;
+    pTexture->pStreamer = pStreamer;
+    pTexture->ktx = pathHasExtension(path, ".ktx2");
+    if (pTexture->ktx) {
+        if (!loadKtx2Index(path, &pTexture->ktxIndex)) {
+            return NO_STREAMED_TEXTURE;
+        }
+        pTexture->format = pTexture->ktxIndex.format;
+        pTexture->width = pTexture->ktxIndex.width;
+        pTexture->height = pTexture->ktxIndex.height;
+        pTexture->mipLevels = pTexture->ktxIndex.levelCount;
+        if (!pApp->textureCompressionBC) {
+            fprintf(stderr, "ERROR: device can't sample the format of %s\n", path);
+            return NO_STREAMED_TEXTURE;
+        }
+    } else {
+        // only for the size, every later load decodes it again
+        SDL_Surface *pSurface = IMG_Load(path);
+        if (pSurface == NULL) {
+            fprintf(stderr, "ERROR: image can't load: %s: %s\n", path, SDL_GetError());
+            return NO_STREAMED_TEXTURE;
+        }
+        pTexture->format = VK_FORMAT_R8G8B8A8_SRGB;
+        pTexture->width = (uint32_t)pSurface->w;
+        pTexture->height = (uint32_t)pSurface->h;
+        pTexture->mipLevels = mipLevelCount(pTexture->width, pTexture->height);
+        SDL_FreeSurface(pSurface);
+    }
+
+    pTexture->requestLevel = streamedTailLevel(pTexture);
+    if (!streamReadLevels(pTexture, pApp)) {
+        return NO_STREAMED_TEXTURE;
+    }
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(pApp);
+    streamRecordUpload(pTexture, commandBuffer, &pTexture->tail, pApp);
+    endSingleTimeCommands(commandBuffer, pApp);
+    streamFreeStaging(pTexture, pApp);
+    pTexture->tail.slot = bindlessAddTexture(pTexture->tail.view, pStreamer->sampler, pApp);
+    pTexture->wantedLevel = pTexture->tail.baseLevel;
+
+    VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0
+    };
+    if (vkCreateFence(pApp->device, &fenceInfo, NULL, &pTexture->fence) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to create texture streaming fence!\n");
+        exit(1);
+    }
+    atomic_init(&pTexture->requestState, STREAM_REQUEST_IDLE);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        pStreamer->recordedSlots[i][pStreamer->textureCount] = pTexture->tail.slot;
+        pStreamer->recordedLevels[i][pStreamer->textureCount] = pTexture->tail.baseLevel;
+    }
+    return pStreamer->textureCount++;
+}
+
+// the bindless slot a draw samples the texture through this frame
+uint32_t textureStreamerSlot(TextureStreamer *pStreamer, uint32_t texture) {
+    return streamedCurrentImage(&pStreamer->textures[texture])->slot;
+}
+
+bool streamEvictable(const TextureStreamer *pStreamer, const StreamedTexture *pTexture, const StreamedTexture *pKeep) {
+    return pTexture != pKeep && pTexture->detail.image != VK_NULL_HANDLE && pTexture->lastUsedFrame != pStreamer->frame;
+}
+
+// Drops the least recently sampled detail images not sampled this frame
+// until needed bytes fit, counting retired images as gone already. Nothing is
+// dropped when even dropping everything wouldn't make it fit.
+bool streamMakeRoom(TextureStreamer *pStreamer, VkDeviceSize needed, const StreamedTexture *pKeep) {
+    VkDeviceSize live = pStreamer->residentBytes - pStreamer->retiringBytes;
+    if (live + needed <= pStreamer->budget) {
+        return true;
+    }
+    VkDeviceSize evictable = 0;
+    for (uint32_t i = 0; i < pStreamer->textureCount; i++) {
+        if (streamEvictable(pStreamer, &pStreamer->textures[i], pKeep)) {
+            evictable += pStreamer->textures[i].detail.size;
+        }
+    }
+    if (live - evictable + needed > pStreamer->budget) {
+        return false;
+    }
+    while (pStreamer->residentBytes - pStreamer->retiringBytes + needed > pStreamer->budget) {
+        StreamedTexture *pVictim = NULL;
+        for (uint32_t i = 0; i < pStreamer->textureCount; i++) {
+            StreamedTexture *pTexture = &pStreamer->textures[i];
+            if (!streamEvictable(pStreamer, pTexture, pKeep)) {
+                continue;
+            }
+            if (pVictim == NULL || pTexture->lastUsedFrame < pVictim->lastUsedFrame) {
+                pVictim = pTexture;
+            }
+        }
+        if (pVictim == NULL) {
+            return false;
+        }
+        streamRetire(pStreamer, &pVictim->detail);
+        pStreamer->evictedCount++;
+    }
+    return true;
+}
+
+void streamUpdateTexture(TextureStreamer *pStreamer, StreamedTexture *pTexture, uint32_t *pRequestsLeft, VkApp *pApp) {
+    int state = atomic_load_explicit(&pTexture->requestState, memory_order_acquire);
+    if (state == STREAM_REQUEST_UPLOADING && vkGetFenceStatus(pApp->device, pTexture->fence) == VK_SUCCESS) {
+        vkFreeCommandBuffers(pApp->device, pApp->commandPool, 1, &pTexture->commandBuffer);
+        vkResetFences(pApp->device, 1, &pTexture->fence);
+        streamFreeStaging(pTexture, pApp);
+        // a fresh slot, the current one stays valid for the frames still in flight
+        pTexture->pending.slot = bindlessAddTexture(pTexture->pending.view, pStreamer->sampler, pApp);
+        if (pTexture->detail.image != VK_NULL_HANDLE) {
+            streamRetire(pStreamer, &pTexture->detail);
+        }
+        pTexture->detail = pTexture->pending;
+        pTexture->pending = (StreamedImage){0};
+        pStreamer->streamedInCount++;
+        atomic_store(&pTexture->requestState, STREAM_REQUEST_IDLE);
+    } else if (state == STREAM_REQUEST_LOADED && pTexture->requestFailed) {
+        pStreamer->residentBytes -= streamedImageSize(pTexture, pTexture->requestLevel);
+        pTexture->failed = true;
+        atomic_store(&pTexture->requestState, STREAM_REQUEST_IDLE);
+    } else if (state == STREAM_REQUEST_LOADED) {
+        pTexture->commandBuffer = beginSingleTimeCommands(pApp);
+        streamRecordUpload(pTexture, pTexture->commandBuffer, &pTexture->pending, pApp);
+        vkEndCommandBuffer(pTexture->commandBuffer);
+        VkSubmitInfo submitInfo = {0};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &pTexture->commandBuffer;
+        if (vkQueueSubmit(pApp->graphicsQueue, 1, &submitInfo, pTexture->fence) != VK_SUCCESS) {
+            fprintf(stderr, "ERROR: failed to submit a streamed texture upload!\n");
+            exit(1);
+        }
+        atomic_store(&pTexture->requestState, STREAM_REQUEST_UPLOADING);
+    } else if (state == STREAM_REQUEST_IDLE && !pTexture->failed && *pRequestsLeft > 0 &&
+               pTexture->wantedLevel < streamedCurrentImage(pTexture)->baseLevel) {
+        // as fine as wanted, or as fine as the budget allows
+        uint32_t currentLevel = streamedCurrentImage(pTexture)->baseLevel;
+        uint32_t level = pTexture->wantedLevel;
+        while (level < currentLevel && !streamMakeRoom(pStreamer, streamedImageSize(pTexture, level), pTexture)) {
+            level++;
+        }
+        if (level == currentLevel) {
+            return;
+        }
+        pStreamer->residentBytes += streamedImageSize(pTexture, level);
+        pTexture->requestLevel = level;
+        atomic_store(&pTexture->requestState, STREAM_REQUEST_LOADING);
+        jobSystemRun(&pApp->jobSystem, streamLoadJob, pTexture, &pStreamer->loads);
+        (*pRequestsLeft)--;
+    }
+}
+
+// Called on the render thread once the current frame slot's fence has been waited on and before
+// it is recorded: reads its feedback, finishes and starts streaming work and frees what no frame
+// in flight can sample anymore.
+void textureStreamerBeginFrame(VkApp *pApp) {
+    TextureStreamer *pStreamer = pApp->pTextureStreamer;
+    if (pStreamer == NULL) {
+        return;
+    }
+    uint32_t frameSlot = pApp->currentFrame;
+    pStreamer->frame++;
+
+    uint32_t *pFeedback = pApp->bindless.feedback + frameSlot * BINDLESS_MAX_TEXTURES;
+    for (uint32_t i = 0; i < pStreamer->textureCount; i++) {
+        StreamedTexture *pTexture = &pStreamer->textures[i];
+        uint32_t requested = pFeedback[pStreamer->recordedSlots[frameSlot][i]];
+        if (requested == FEEDBACK_NONE) {
+            continue;
+        }
+        int64_t level = (int64_t)pStreamer->recordedLevels[frameSlot][i] + requested - FEEDBACK_LEVEL_BIAS;
+        pTexture->wantedLevel = level < 0 ? 0 : (level >= pTexture->mipLevels ? pTexture->mipLevels - 1 : (uint32_t)level);
+        pTexture->lastUsedFrame = pStreamer->frame;
+    }
+    memset(pFeedback, 0xFF, BINDLESS_MAX_TEXTURES * sizeof(uint32_t));
+
+    // the frames recorded before an image was retired have all been waited on by now
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < pStreamer->retiredCount; i++) {
+        RetiredStreamedImage *pRetired = &pStreamer->retired[i];
+        if (pRetired->frame + MAX_FRAMES_IN_FLIGHT <= pStreamer->frame) {
+            bindlessRemoveTexture(pRetired->image.slot, pApp);
+            pStreamer->residentBytes -= pRetired->image.size;
+            pStreamer->retiringBytes -= pRetired->image.size;
+            destroyStreamedImage(&pRetired->image, pApp);
+        } else {
+            pStreamer->retired[kept++] = *pRetired;
+        }
+    }
+    pStreamer->retiredCount = kept;
+
+    uint32_t requestsLeft = STREAMING_MAX_REQUESTS_PER_FRAME;
+    for (uint32_t i = 0; i < pStreamer->textureCount; i++) {
+        streamUpdateTexture(pStreamer, &pStreamer->textures[i], &requestsLeft, pApp);
+    }
+
+    for (uint32_t i = 0; i < pStreamer->textureCount; i++) {
+        const StreamedImage *pImage = streamedCurrentImage(&pStreamer->textures[i]);
+        pStreamer->recordedSlots[frameSlot][i] = pImage->slot;
+        pStreamer->recordedLevels[frameSlot][i] = pImage->baseLevel;
+    }
+}
+
+// The feedback buffer as the render graph sees it: the host reset the frame's
+// entries before the submit, which needs no barrier, and reads them once the
+// frame's fence signals, which needs the shader writes made visible to it.
+uint32_t textureStreamerImportFeedback(VkApp *pApp, RenderGraph *pGraph) {
+    RenderGraphState reset = {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0};
+    RenderGraphState readable = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT};
+    return renderGraphImportBuffer(pGraph, "texture_feedback", pApp->bindless.feedbackBuffer, reset, readable);
+}
+
+void textureStreamerReport(const TextureStreamer *pStreamer, FILE *pOut) {
+    fprintf(pOut, "texture streaming: %llu streamed in, %llu evicted, %.1f of %.1f MiB resident\n",
+            (unsigned long long)pStreamer->streamedInCount, (unsigned long long)pStreamer->evictedCount,
+            pStreamer->residentBytes / (1024.0 * 1024.0), pStreamer->budget / (1024.0 * 1024.0));
+}
+
+// after the device is idle, the command pool may already be gone
+void destroyTextureStreamer(TextureStreamer *pStreamer, VkApp *pApp) {
+    jobSystemWait(&pApp->jobSystem, &pStreamer->loads);
+    for (uint32_t i = 0; i < pStreamer->retiredCount; i++) {
+        destroyStreamedImage(&pStreamer->retired[i].image, pApp);
+    }
+    for (uint32_t i = 0; i < pStreamer->textureCount; i++) {
+        StreamedTexture *pTexture = &pStreamer->textures[i];
+        int state = atomic_load(&pTexture->requestState);
+        // a pending upload's command buffer went with the command pool
+        if (state == STREAM_REQUEST_UPLOADING) {
+            destroyStreamedImage(&pTexture->pending, pApp);
+        }
+        streamFreeStaging(pTexture, pApp);
+        if (pTexture->detail.image != VK_NULL_HANDLE) {
+            destroyStreamedImage(&pTexture->detail, pApp);
+        }
+        destroyStreamedImage(&pTexture->tail, pApp);
+        vkDestroyFence(pApp->device, pTexture->fence, NULL);
+    }
+}
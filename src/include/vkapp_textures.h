@@ -0,0 +1,500 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Texture loading pool. Every texture is decoded by its own job; as soon as
+// a decode finishes the worker converts the pixels to RGBA8 straight into a
+// slice of a persistently mapped staging buffer (building the CPU mip chain
+// there too when the device can't blit), so there is no intermediate RGBA
+// surface. The loading thread records the uploads of whatever has been
+// staged into a batch, up to TEXTURE_UPLOAD_BATCH_SIZE textures per submit,
+// and hands slices back to the workers once a batch's fence has signalled.
+//
+// Decodes can start before the device exists. Anything a worker can't stage
+// (no staging buffer yet, every slice busy) is kept decoded and staged by
+// the loading thread instead; textures bigger than a slice get a staging
+// buffer of their own.
+
+#define TEXTURE_STAGING_SLICES 4
+#define TEXTURE_STAGING_SLICE_SIZE (8u << 20)
+#define TEXTURE_UPLOAD_BATCH_SIZE 8
+#define TEXTURE_UPLOAD_BATCHES 2
+#define NO_STAGING_SLICE -1
+
+typedef enum {
+    TEXTURE_LOAD_PENDING,
+    // in a staging slice, written by the decode job
+    TEXTURE_LOAD_STAGED,
+    // decoded, waiting for the loading thread to stage it
+    TEXTURE_LOAD_DECODED,
+    TEXTURE_LOAD_FAILED
+} TextureLoadState;
+
+typedef struct TextureLoader TextureLoader;
+
+typedef struct {
+    const char *path;
+    TextureLoader *pLoader;
+    atomic_int state;
+    // loading thread only, set once the load is recorded or given up on
+    bool settled;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    // only level 0 is staged and the rest is blitted on the GPU
+    bool generateMipmaps;
+    // source data until it is staged
+    SDL_Surface *surface;
+    KtxTexture ktx;
+    int slice;
+    // when the texture doesn't fit in a slice
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    VkBufferImageCopy regions[KTX2_MAX_LEVELS];
+    uint32_t regionCount;
+    VkDeviceSize stagedBytes;
+    VkImage image;
+    VkDeviceMemory imageMemory;
+} TextureLoad;
+
+typedef struct {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    bool inFlight;
+    // moves every image into TRANSFER_DST_OPTIMAL, flushed once before the copies
+    BarrierBatch acquire;
+    // moves into SHADER_READ_ONLY_OPTIMAL, flushed once right before the submit
+    BarrierBatch release;
+    uint32_t loads[TEXTURE_UPLOAD_BATCH_SIZE];
+    uint32_t loadCount;
+} TextureUploadBatch;
+
+struct TextureLoader {
+    TextureLoad *loads;
+    uint32_t loadCount;
+    StartupTimer *pTimer;
+    JobCounter decoded;
+    // posted by every decode job once it is done
+    SDL_sem *finished;
+    SDL_mutex *sliceLock;
+    bool sliceBusy[TEXTURE_STAGING_SLICES];
+    // workers only stage once this is set, blitSupported and stagingMapped are valid from then on
+    atomic_bool stagingReady;
+    bool blitSupported;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    uint8_t *stagingMapped;
+    TextureUploadBatch batches[TEXTURE_UPLOAD_BATCHES];
+    uint32_t nextBatch;
+    uint32_t failedCount;
+    uint64_t uploadedBytes;
+};
+
+// CPU only; fills in the size and format and keeps the source data
+bool textureDecode(TextureLoad *pLoad) {
+    if (pathHasExtension(pLoad->path, ".ktx2")) {
+        if (!loadKtx2File(pLoad->path, &pLoad->ktx)) {
+            return false;
+        }
+        pLoad->format = pLoad->ktx.format;
+        pLoad->width = pLoad->ktx.width;
+        pLoad->height = pLoad->ktx.height;
+        pLoad->mipLevels = pLoad->ktx.levelCount;
+        return true;
+    }
+    pLoad->surface = IMG_Load(pLoad->path);
+    if (pLoad->surface == NULL) {
+        fprintf(stderr, "ERROR: image can't load: %s: %s\n", pLoad->path, SDL_GetError());
+        return false;
+    }
+    pLoad->format = VK_FORMAT_R8G8B8A8_SRGB;
+    pLoad->width = (uint32_t)pLoad->surface->w;
+    pLoad->height = (uint32_t)pLoad->surface->h;
+    pLoad->mipLevels = mipLevelCount(pLoad->width, pLoad->height);
+    return true;
+}
+
+size_t textureStagingSize(const TextureLoad *pLoad, bool blitSupported) {
+    if (pLoad->surface == NULL) {
+        size_t size = 0;
+        for (uint32_t level = 0; level < pLoad->ktx.levelCount; level++) {
+            size += pLoad->ktx.levelSizes[level];
+        }
+        return size;
+    }
+    return blitSupported ? (size_t)pLoad->width * pLoad->height * 4 : mipChainSize(pLoad->width, pLoad->height, pLoad->mipLevels);
+}
+
+// Converts a decoded surface to tightly packed RGBA8 in pDst without an
+// intermediate surface. SDL_ConvertPixels can't read palettized formats,
+// which IMG_Load returns for 8-bit palette PNGs, so those are blitted into a
+// surface wrapping pDst instead; keyed pixels come out transparent black.
+bool textureConvertRGBA8(SDL_Surface *pSurface, uint8_t *pDst) {
+    if (!SDL_ISPIXELFORMAT_INDEXED(pSurface->format->format)) {
+        return SDL_ConvertPixels(pSurface->w, pSurface->h, pSurface->format->format, pSurface->pixels, pSurface->pitch,
+                                 SDL_PIXELFORMAT_RGBA32, pDst, pSurface->w * 4) == 0;
+    }
+    SDL_Surface *pTarget = SDL_CreateRGBSurfaceWithFormatFrom(pDst, pSurface->w, pSurface->h, 32, pSurface->w * 4, SDL_PIXELFORMAT_RGBA32);
+    if (pTarget == NULL) {
+        return false;
+    }
+    memset(pDst, 0, (size_t)pSurface->w * pSurface->h * 4);
+    SDL_SetSurfaceBlendMode(pSurface, SDL_BLENDMODE_NONE);
+    bool converted = SDL_BlitSurface(pSurface, NULL, pTarget, NULL) == 0;
+    SDL_FreeSurface(pTarget);
+    return converted;
+}
+
+// Writes the levels to pDst, which sits at baseOffset in its buffer, and releases the source data.
+// RGBA8 is converted in the same pass that copies it, whatever format SDL_image decoded to.
+bool textureWriteStaging(TextureLoad *pLoad, uint8_t *pDst, VkDeviceSize baseOffset, bool blitSupported) {
+    size_t offsets[KTX2_MAX_LEVELS];
+    if (pLoad->surface != NULL) {
+        SDL_Surface *pSurface = pLoad->surface;
+        if (!textureConvertRGBA8(pSurface, pDst)) {
+            fprintf(stderr, "ERROR: failed to convert %s to RGBA: %s\n", pLoad->path, SDL_GetError());
+            SDL_FreeSurface(pSurface);
+            pLoad->surface = NULL;
+            return false;
+        }
+        SDL_FreeSurface(pSurface);
+        pLoad->surface = NULL;
+        pLoad->generateMipmaps = blitSupported;
+        pLoad->regionCount = blitSupported ? 1 : pLoad->mipLevels;
+        if (blitSupported) {
+            offsets[0] = 0;
+        } else {
+            buildMipChainRGBA8(pDst, pLoad->width, pLoad->height, pLoad->mipLevels, true, pDst, offsets);
+        }
+    } else {
+        size_t offset = 0;
+        for (uint32_t level = 0; level < pLoad->ktx.levelCount; level++) {
+            memcpy(pDst + offset, pLoad->ktx.fileData + pLoad->ktx.levelOffsets[level], pLoad->ktx.levelSizes[level]);
+            offsets[level] = offset;
+            offset += pLoad->ktx.levelSizes[level];
+        }
+        freeKtxTexture(&pLoad->ktx);
+        pLoad->generateMipmaps = false;
+        pLoad->regionCount = pLoad->mipLevels;
+    }
+    for (uint32_t level = 0; level < pLoad->regionCount; level++) {
+        pLoad->regions[level] = (VkBufferImageCopy){0};
+        pLoad->regions[level].bufferOffset = baseOffset + offsets[level];
+        pLoad->regions[level].imageSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        pLoad->regions[level].imageExtent = (VkExtent3D){mipLevelExtent(pLoad->width, level), mipLevelExtent(pLoad->height, level), 1};
+    }
+    return true;
+}
+
+int textureLoaderAcquireSlice(TextureLoader *pLoader) {
+    int slice = NO_STAGING_SLICE;
+    SDL_LockMutex(pLoader->sliceLock);
+    for (int i = 0; i < TEXTURE_STAGING_SLICES; i++) {
+        if (!pLoader->sliceBusy[i]) {
+            pLoader->sliceBusy[i] = true;
+            slice = i;
+            break;
+        }
+    }
+    SDL_UnlockMutex(pLoader->sliceLock);
+    return slice;
+}
+
+void textureLoaderReleaseSlice(TextureLoader *pLoader, int slice) {
+    SDL_LockMutex(pLoader->sliceLock);
+    pLoader->sliceBusy[slice] = false;
+    SDL_UnlockMutex(pLoader->sliceLock);
+}
+
+void textureDecodeJob(void *data) {
+    TextureLoad *pLoad = (TextureLoad *)data;
+    TextureLoader *pLoader = pLoad->pLoader;
+    uint32_t phase = startupPhaseBegin(pLoader->pTimer, "texture_decode");
+    bool decoded = textureDecode(pLoad);
+    // the size is only known once the decode has filled it in
+    startupPhaseEnd(pLoader->pTimer, phase, decoded ? (uint64_t)pLoad->width * pLoad->height * 4 : 0);
+    int state = decoded ? TEXTURE_LOAD_DECODED : TEXTURE_LOAD_FAILED;
+    if (decoded && atomic_load_explicit(&pLoader->stagingReady, memory_order_acquire)) {
+        size_t size = textureStagingSize(pLoad, pLoader->blitSupported);
+        int slice = size <= TEXTURE_STAGING_SLICE_SIZE ? textureLoaderAcquireSlice(pLoader) : NO_STAGING_SLICE;
+        if (slice != NO_STAGING_SLICE) {
+            VkDeviceSize offset = (VkDeviceSize)slice * TEXTURE_STAGING_SLICE_SIZE;
+            pLoad->slice = slice;
+            pLoad->stagedBytes = size;
+            if (textureWriteStaging(pLoad, pLoader->stagingMapped + offset, offset, pLoader->blitSupported)) {
+                state = TEXTURE_LOAD_STAGED;
+            } else {
+                textureLoaderReleaseSlice(pLoader, slice);
+                pLoad->slice = NO_STAGING_SLICE;
+                state = TEXTURE_LOAD_FAILED;
+            }
+        }
+    }
+    atomic_store_explicit(&pLoad->state, state, memory_order_release);
+    SDL_SemPost(pLoader->finished);
+}
+
+// starts decoding right away, before the device exists if need be; paths must outlive the loader
+void textureLoaderStart(TextureLoader *pLoader, const char **paths, uint32_t count, VkApp *pApp) {
+    memset(pLoader, 0, sizeof(TextureLoader));
+    pLoader->loads = (TextureLoad *)calloc(count, sizeof(TextureLoad));
+    pLoader->loadCount = count;
+    pLoader->pTimer = &pApp->startupTimer;
+    pLoader->finished = SDL_CreateSemaphore(0);
+    pLoader->sliceLock = SDL_CreateMutex();
+    if (pLoader->loads == NULL || pLoader->finished == NULL || pLoader->sliceLock == NULL) {
+        fprintf(stderr, "ERROR: failed to create the texture loader\n");
+        exit(1);
+    }
+    atomic_init(&pLoader->stagingReady, false);
+    initJobCounter(&pLoader->decoded);
+    for (uint32_t i = 0; i < count; i++) {
+        TextureLoad *pLoad = &pLoader->loads[i];
+        pLoad->path = paths[i];
+        pLoad->pLoader = pLoader;
+        pLoad->slice = NO_STAGING_SLICE;
+        atomic_init(&pLoad->state, TEXTURE_LOAD_PENDING);
+        jobSystemRun(&pApp->jobSystem, textureDecodeJob, pLoad, &pLoader->decoded);
+    }
+}
+
+// needs the device and command pool, decodes finishing after this stage on their worker
+void textureLoaderCreateStaging(TextureLoader *pLoader, VkApp *pApp) {
+    pLoader->blitSupported = formatSupportsLinearBlit(VK_FORMAT_R8G8B8A8_SRGB, pApp);
+    if (!pLoader->blitSupported) {
+        printf("INFO: no linear blit for the texture format, building mipmaps on the CPU\n");
+    }
+    VkDeviceSize size = (VkDeviceSize)TEXTURE_STAGING_SLICES * TEXTURE_STAGING_SLICE_SIZE;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pLoader->stagingBuffer, &pLoader->stagingMemory, pApp);
+    void *pMapped;
+    vkMapMemory(pApp->device, pLoader->stagingMemory, 0, size, 0, &pMapped);
+    pLoader->stagingMapped = (uint8_t *)pMapped;
+
+    VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0
+    };
+    for (uint32_t i = 0; i < TEXTURE_UPLOAD_BATCHES; i++) {
+        if (vkCreateFence(pApp->device, &fenceInfo, NULL, &pLoader->batches[i].fence) != VK_SUCCESS) {
+            fprintf(stderr, "ERROR: failed to create texture upload fence!\n");
+            exit(1);
+        }
+    }
+    atomic_store_explicit(&pLoader->stagingReady, true, memory_order_release);
+}
+
+// for loads a worker couldn't stage, false if it has to wait for a slice
+bool textureLoaderStage(TextureLoader *pLoader, TextureLoad *pLoad, VkApp *pApp) {
+    size_t size = textureStagingSize(pLoad, pLoader->blitSupported);
+    uint8_t *pDst;
+    VkDeviceSize offset = 0;
+    if (size > TEXTURE_STAGING_SLICE_SIZE) {
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &pLoad->stagingBuffer, &pLoad->stagingMemory, pApp);
+        void *pMapped;
+        vkMapMemory(pApp->device, pLoad->stagingMemory, 0, size, 0, &pMapped);
+        pDst = (uint8_t *)pMapped;
+    } else {
+        pLoad->slice = textureLoaderAcquireSlice(pLoader);
+        if (pLoad->slice == NO_STAGING_SLICE) {
+            return false;
+        }
+        offset = (VkDeviceSize)pLoad->slice * TEXTURE_STAGING_SLICE_SIZE;
+        pDst = pLoader->stagingMapped + offset;
+    }
+    pLoad->stagedBytes = size;
+    bool written = textureWriteStaging(pLoad, pDst, offset, pLoader->blitSupported);
+    if (pLoad->stagingBuffer != VK_NULL_HANDLE) {
+        vkUnmapMemory(pApp->device, pLoad->stagingMemory);
+    }
+    if (!written) {
+        atomic_store(&pLoad->state, TEXTURE_LOAD_FAILED);
+    }
+    return true;
+}
+
+// gives back a load's staging memory once nothing reads from it anymore
+void textureLoaderReleaseStaging(TextureLoader *pLoader, TextureLoad *pLoad, VkApp *pApp) {
+    if (pLoad->slice != NO_STAGING_SLICE) {
+        textureLoaderReleaseSlice(pLoader, pLoad->slice);
+        pLoad->slice = NO_STAGING_SLICE;
+    }
+    if (pLoad->stagingBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(pApp->device, pLoad->stagingBuffer, NULL);
+        freeDeviceMemory(pLoad->stagingMemory, pApp);
+        pLoad->stagingBuffer = VK_NULL_HANDLE;
+    }
+}
+
+// true if the batch has completed, or was never submitted
+bool textureLoaderRetireBatch(TextureLoader *pLoader, TextureUploadBatch *pBatch, bool wait, VkApp *pApp) {
+    if (!pBatch->inFlight) {
+        return true;
+    }
+    if (wait) {
+        vkWaitForFences(pApp->device, 1, &pBatch->fence, VK_TRUE, UINT64_MAX);
+    } else if (vkGetFenceStatus(pApp->device, pBatch->fence) != VK_SUCCESS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < pBatch->loadCount; i++) {
+        textureLoaderReleaseStaging(pLoader, &pLoader->loads[pBatch->loads[i]], pApp);
+    }
+    vkFreeCommandBuffers(pApp->device, pApp->commandPool, 1, &pBatch->commandBuffer);
+    vkResetFences(pApp->device, 1, &pBatch->fence);
+    pBatch->inFlight = false;
+    pBatch->loadCount = 0;
+    return true;
+}
+
+TextureUploadBatch *textureLoaderBeginBatch(TextureLoader *pLoader, VkApp *pApp) {
+    TextureUploadBatch *pBatch = &pLoader->batches[pLoader->nextBatch];
+    textureLoaderRetireBatch(pLoader, pBatch, true, pApp);
+    pBatch->commandBuffer = beginSingleTimeCommands(pApp);
+    initBarrierBatch(&pBatch->acquire, pBatch->commandBuffer);
+    initBarrierBatch(&pBatch->release, pBatch->commandBuffer);
+    return pBatch;
+}
+
+// the copies go in once every image of the batch is in TRANSFER_DST_OPTIMAL
+void textureLoaderRecordCopies(TextureLoader *pLoader, TextureUploadBatch *pBatch) {
+    barrierBatchFlush(&pBatch->acquire);
+    for (uint32_t i = 0; i < pBatch->loadCount; i++) {
+        TextureLoad *pLoad = &pLoader->loads[pBatch->loads[i]];
+        VkBuffer source = pLoad->stagingBuffer != VK_NULL_HANDLE ? pLoad->stagingBuffer : pLoader->stagingBuffer;
+        vkCmdCopyBufferToImage(pBatch->commandBuffer, source, pLoad->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pLoad->regionCount, pLoad->regions);
+
+        // nothing samples these before the batch is submitted
+        if (pLoad->generateMipmaps) {
+            recordMipmapGeneration(&pBatch->release, pLoad->image, pLoad->width, pLoad->height, pLoad->mipLevels);
+        } else {
+            VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pLoad->mipLevels, 0, 1};
+            barrierBatchImage(&pBatch->release, pLoad->image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+    }
+}
+
+void textureLoaderSubmitBatch(TextureLoader *pLoader, TextureUploadBatch *pBatch, VkApp *pApp) {
+    textureLoaderRecordCopies(pLoader, pBatch);
+    barrierBatchFlush(&pBatch->release);
+    vkEndCommandBuffer(pBatch->commandBuffer);
+    VkSubmitInfo submitInfo = {0};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &pBatch->commandBuffer;
+    if (vkQueueSubmit(pApp->graphicsQueue, 1, &submitInfo, pBatch->fence) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: failed to submit texture uploads!\n");
+        exit(1);
+    }
+    pBatch->inFlight = true;
+    pLoader->nextBatch = (pLoader->nextBatch + 1) % TEXTURE_UPLOAD_BATCHES;
+}
+
+void textureLoaderRecord(TextureLoader *pLoader, TextureUploadBatch *pBatch, uint32_t loadIndex, VkApp *pApp) {
+    TextureLoad *pLoad = &pLoader->loads[loadIndex];
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (pLoad->generateMipmaps) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    createLayeredImage(pLoad->width, pLoad->height, pLoad->mipLevels, 1, pLoad->format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pLoad->image, &pLoad->imageMemory, pApp);
+
+    // the copies themselves are recorded at submit, after one barrier for the whole batch
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pLoad->mipLevels, 0, 1};
+    barrierBatchImage(&pBatch->acquire, pLoad->image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    pBatch->loads[pBatch->loadCount++] = loadIndex;
+    pLoader->uploadedBytes += pLoad->stagedBytes;
+}
+
+bool textureFormatUsable(VkFormat format, VkApp *pApp) {
+    if (ktxIsSupportedFormat(format) && !pApp->textureCompressionBC) {
+        return false;
+    }
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(pApp->physicalDevice, format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+}
+
+// Uploads every texture as its decode finishes and returns once all of them
+// are on the GPU. Failed loads are counted in failedCount and have no image.
+void textureLoaderFinish(TextureLoader *pLoader, VkApp *pApp) {
+    uint32_t settledCount = 0;
+    TextureUploadBatch *pBatch = NULL;
+    while (settledCount < pLoader->loadCount) {
+        bool progress = false;
+        for (uint32_t i = 0; i < pLoader->loadCount; i++) {
+            TextureLoad *pLoad = &pLoader->loads[i];
+            int state = atomic_load_explicit(&pLoad->state, memory_order_acquire);
+            if (pLoad->settled || state == TEXTURE_LOAD_PENDING) {
+                continue;
+            }
+            if (state == TEXTURE_LOAD_DECODED && !textureLoaderStage(pLoader, pLoad, pApp)) {
+                // every slice is waiting on an upload, free the oldest ones up
+                if (pBatch != NULL) {
+                    textureLoaderSubmitBatch(pLoader, pBatch, pApp);
+                    pBatch = NULL;
+                }
+                for (uint32_t n = 0; n < TEXTURE_UPLOAD_BATCHES; n++) {
+                    TextureUploadBatch *pOldest = &pLoader->batches[(pLoader->nextBatch + n) % TEXTURE_UPLOAD_BATCHES];
+                    if (pOldest->inFlight) {
+                        textureLoaderRetireBatch(pLoader, pOldest, true, pApp);
+                        progress = true;
+                        break;
+                    }
+                }
+                continue;
+            }
+            state = atomic_load(&pLoad->state);
+            if (state != TEXTURE_LOAD_FAILED && !textureFormatUsable(pLoad->format, pApp)) {
+                fprintf(stderr, "ERROR: device can't sample the format of %s\n", pLoad->path);
+                state = TEXTURE_LOAD_FAILED;
+            }
+            pLoad->settled = true;
+            settledCount++;
+            progress = true;
+            if (state == TEXTURE_LOAD_FAILED) {
+                // a failed write or an unusable format may still hold its slice or its own buffer
+                textureLoaderReleaseStaging(pLoader, pLoad, pApp);
+                pLoader->failedCount++;
+                continue;
+            }
+            if (pBatch == NULL) {
+                pBatch = textureLoaderBeginBatch(pLoader, pApp);
+            }
+            textureLoaderRecord(pLoader, pBatch, i, pApp);
+            if (pBatch->loadCount == TEXTURE_UPLOAD_BATCH_SIZE) {
+                textureLoaderSubmitBatch(pLoader, pBatch, pApp);
+                pBatch = NULL;
+            }
+        }
+        // nothing else is ready, let the GPU start on what we have
+        if (pBatch != NULL) {
+            textureLoaderSubmitBatch(pLoader, pBatch, pApp);
+            pBatch = NULL;
+        }
+        for (uint32_t i = 0; i < TEXTURE_UPLOAD_BATCHES; i++) {
+            textureLoaderRetireBatch(pLoader, &pLoader->batches[i], false, pApp);
+        }
+        if (!progress && settledCount < pLoader->loadCount) {
+            SDL_SemWait(pLoader->finished);
+        }
+    }
+    for (uint32_t i = 0; i < TEXTURE_UPLOAD_BATCHES; i++) {
+        textureLoaderRetireBatch(pLoader, &pLoader->batches[i], true, pApp);
+        vkDestroyFence(pApp->device, pLoader->batches[i].fence, NULL);
+    }
+    jobSystemWait(&pApp->jobSystem, &pLoader->decoded);
+    vkUnmapMemory(pApp->device, pLoader->stagingMemory);
+    vkDestroyBuffer(pApp->device, pLoader->stagingBuffer, NULL);
+    freeDeviceMemory(pLoader->stagingMemory, pApp);
+    SDL_DestroySemaphore(pLoader->finished);
+    SDL_DestroyMutex(pLoader->sliceLock);
+}
+
+// the images belong to the caller
+void destroyTextureLoader(TextureLoader *pLoader) {
+    free(pLoader->loads);
+    pLoader->loads = NULL;
+    pLoader->loadCount = 0;
+}
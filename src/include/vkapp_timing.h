@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "SDL.h"
+
+// Wall clock timing of startup phases. Phases may be timed from any thread,
+// each one claims its own slot so recording never takes a lock. The report is
+// JSON so cold start numbers can be diffed across builds.
+
+#define MAX_STARTUP_PHASES 64
+
+typedef struct {
+    const char *name;
+    SDL_threadID threadId;
+    uint64_t start;
+    uint64_t end;
+    uint64_t bytes;
+} StartupPhase;
+
+typedef struct {
+    uint64_t origin;
+    atomic_ullong firstFrame;
+    atomic_uint phaseCount;
+    StartupPhase phases[MAX_STARTUP_PHASES];
+} StartupTimer;
+
+void initStartupTimer(StartupTimer *timer) {
+    timer->origin = SDL_GetPerformanceCounter();
+    atomic_init(&timer->firstFrame, 0);
+    atomic_init(&timer->phaseCount, 0);
+}
+
+// returns the phase to hand back to startupPhaseEnd
+uint32_t startupPhaseBegin(StartupTimer *timer, const char *name) {
+    uint32_t phase = atomic_fetch_add(&timer->phaseCount, 1);
+    if (phase >= MAX_STARTUP_PHASES) {
+        return UINT32_MAX;
+    }
+    timer->phases[phase].name = name;
+    timer->phases[phase].threadId = SDL_ThreadID();
+    timer->phases[phase].bytes = 0;
+    timer->phases[phase].end = 0;
+    timer->phases[phase].start = SDL_GetPerformanceCounter();
+    return phase;
+}
+
+void startupPhaseEnd(StartupTimer *timer, uint32_t phase, uint64_t bytes) {
+    if (phase >= MAX_STARTUP_PHASES) {
+        return;
+    }
+    timer->phases[phase].end = SDL_GetPerformanceCounter();
+    timer->phases[phase].bytes = bytes;
+}
+
+// times a single statement, bytes is evaluated after it ran
+#define STARTUP_PHASE(pTimer, name, bytes, statement) do { \
+        uint32_t startupPhase_ = startupPhaseBegin((pTimer), (name)); \
+        statement; \
+        startupPhaseEnd((pTimer), startupPhase_, (bytes)); \
+    } while (0)
+
+// only the first call counts
+void startupTimerMarkFirstFrame(StartupTimer *timer) {
+    unsigned long long expected = 0;
+    atomic_compare_exchange_strong(&timer->firstFrame, &expected, SDL_GetPerformanceCounter());
+}
+
+double startupTimerMs(const StartupTimer *timer, uint64_t counter) {
+    return (double)(counter - timer->origin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void writeStartupReport(StartupTimer *timer, FILE *pFile) {
+    uint32_t phaseCount = atomic_load(&timer->phaseCount);
+    if (phaseCount > MAX_STARTUP_PHASES) {
+        phaseCount = MAX_STARTUP_PHASES;
+    }
+    uint64_t firstFrame = atomic_load(&timer->firstFrame);
+
+    fprintf(pFile, "{\n");
+    if (firstFrame != 0) {
+        fprintf(pFile, "  \"time_to_first_frame_ms\": %.3f,\n", startupTimerMs(timer, firstFrame));
+    } else {
+        fprintf(pFile, "  \"time_to_first_frame_ms\": null,\n");
+    }
+    fprintf(pFile, "  \"phases\": [");
+    for (uint32_t i = 0; i < phaseCount; i++) {
+        const StartupPhase *phase = &timer->phases[i];
+        fprintf(pFile, "%s\n    {\"name\": \"%s\", \"thread_id\": %lu, \"start_ms\": %.3f, ",
+                i == 0 ? "" : ",", phase->name, (unsigned long)phase->threadId, startupTimerMs(timer, phase->start));
+        // a phase still running has no duration yet
+        if (phase->end != 0) {
+            fprintf(pFile, "\"wall_ms\": %.3f, ", startupTimerMs(timer, phase->end) - startupTimerMs(timer, phase->start));
+        } else {
+            fprintf(pFile, "\"wall_ms\": null, ");
+        }
+        fprintf(pFile, "\"bytes\": %llu}", (unsigned long long)phase->bytes);
+    }
+    fprintf(pFile, "\n  ]\n}\n");
+}
+
+bool writeStartupReportFile(StartupTimer *timer, const char *filePath) {
+    FILE *pFile = fopen(filePath, "w");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open startup report: %s\n", filePath);
+        return false;
+    }
+    writeStartupReport(timer, pFile);
+    fclose(pFile);
+    return true;
+}
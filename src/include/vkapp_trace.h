@@ -0,0 +1,168 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "SDL.h"
+
+// CPU tracer for the hot path. Each thread records complete events into its
+// own ring buffer, so recording is a couple of counter reads and a store with
+// no locking; old events are overwritten once a ring is full. The rings can be
+// dumped at any time as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+
+// power of two
+#define TRACE_RING_CAPACITY 16384
+#define MAX_TRACE_THREADS 64
+#define MAX_TRACE_THREAD_NAME 32
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent events[TRACE_RING_CAPACITY];
+    // total events ever written, the writer is the only thread bumping it
+    atomic_ullong head;
+    SDL_threadID threadId;
+    char threadName[MAX_TRACE_THREAD_NAME];
+} TraceRing;
+
+typedef struct {
+    uint64_t origin;
+    TraceRing *_Atomic rings[MAX_TRACE_THREADS];
+    atomic_uint ringCount;
+} Tracer;
+
+Tracer appTracer;
+_Thread_local TraceRing *traceThreadRing = NULL;
+
+void initTracer(void) {
+    appTracer.origin = SDL_GetPerformanceCounter();
+    for (int i = 0; i < MAX_TRACE_THREADS; i++) {
+        atomic_init(&appTracer.rings[i], NULL);
+    }
+    atomic_init(&appTracer.ringCount, 0);
+}
+
+// NULL when every ring is taken, the thread then goes untraced
+TraceRing *traceRing(void) {
+    if (traceThreadRing != NULL) {
+        return traceThreadRing;
+    }
+    uint32_t slot = atomic_fetch_add(&appTracer.ringCount, 1);
+    if (slot >= MAX_TRACE_THREADS) {
+        return NULL;
+    }
+    TraceRing *ring = (TraceRing *)malloc(sizeof(TraceRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    ring->threadId = SDL_ThreadID();
+    snprintf(ring->threadName, MAX_TRACE_THREAD_NAME, "thread %u", slot);
+    atomic_store_explicit(&appTracer.rings[slot], ring, memory_order_release);
+    traceThreadRing = ring;
+    return ring;
+}
+
+void traceSetThreadName(const char *name) {
+    TraceRing *ring = traceRing();
+    if (ring != NULL) {
+        snprintf(ring->threadName, MAX_TRACE_THREAD_NAME, "%s", name);
+    }
+}
+
+uint64_t traceBegin(void) {
+    return SDL_GetPerformanceCounter();
+}
+
+// name must outlive the tracer, string literals are the intended use
+void traceEnd(const char *name, uint64_t start) {
+    uint64_t end = SDL_GetPerformanceCounter();
+    TraceRing *ring = traceRing();
+    if (ring == NULL) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent *event = &ring->events[head & (TRACE_RING_CAPACITY - 1)];
+    event->name = name;
+    event->start = start;
+    event->end = end;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// traces a single statement as one event
+#define TRACE_SCOPE(name, statement) do { \
+        uint64_t traceStart_ = traceBegin(); \
+        statement; \
+        traceEnd((name), traceStart_); \
+    } while (0)
+
+double traceMicroseconds(uint64_t counter) {
+    return (double)(counter - appTracer.origin) * 1e6 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Safe to call while other threads keep tracing. Events the writer may have
+// overwritten during the copy are dropped rather than emitted torn.
+void writeTrace(FILE *pFile) {
+    static TraceEvent snapshot[TRACE_RING_CAPACITY];
+    uint32_t ringCount = atomic_load(&appTracer.ringCount);
+    if (ringCount > MAX_TRACE_THREADS) {
+        ringCount = MAX_TRACE_THREADS;
+    }
+    bool first = true;
+    fprintf(pFile, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (uint32_t i = 0; i < ringCount; i++) {
+        TraceRing *ring = atomic_load_explicit(&appTracer.rings[i], memory_order_acquire);
+        if (ring == NULL) {
+            continue;
+        }
+        fprintf(pFile, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",", (unsigned long)ring->threadId, ring->threadName);
+        first = false;
+
+        uint64_t headBefore = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t begin = headBefore > TRACE_RING_CAPACITY ? headBefore - TRACE_RING_CAPACITY : 0;
+        for (uint64_t e = begin; e < headBefore; e++) {
+            snapshot[e - begin] = ring->events[e & (TRACE_RING_CAPACITY - 1)];
+        }
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t headAfter = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        // slots the writer reached again while we were copying, including the one it may be writing now
+        uint64_t valid = headAfter + 1 > TRACE_RING_CAPACITY ? headAfter + 1 - TRACE_RING_CAPACITY : 0;
+        for (uint64_t e = begin > valid ? begin : valid; e < headBefore; e++) {
+            TraceEvent *event = &snapshot[e - begin];
+            double start = traceMicroseconds(event->start);
+            fprintf(pFile, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lu, \"ts\": %.3f, \"dur\": %.3f}",
+                    event->name, (unsigned long)ring->threadId, start, traceMicroseconds(event->end) - start);
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+}
+
+bool writeTraceFile(const char *filePath) {
+    FILE *pFile = fopen(filePath, "w");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open trace file: %s\n", filePath);
+        return false;
+    }
+    writeTrace(pFile);
+    fclose(pFile);
+    printf("INFO: wrote trace to %s\n", filePath);
+    return true;
+}
+
+void destroyTracer(void) {
+    uint32_t ringCount = atomic_load(&appTracer.ringCount);
+    if (ringCount > MAX_TRACE_THREADS) {
+        ringCount = MAX_TRACE_THREADS;
+    }
+    for (uint32_t i = 0; i < ringCount; i++) {
+        free(atomic_exchange(&appTracer.rings[i], NULL));
+    }
+    atomic_store(&appTracer.ringCount, 0);
+    traceThreadRing = NULL;
+}
@@ -1,7 +1,384 @@
 #include "cglm/cglm.h"
 #define MAX_FRAMES_IN_FLIGHT 2
+// how long the loop sleeps in SDL_WaitEventTimeout when there is nothing to draw
+#define IDLE_WAIT_TIMEOUT_MS 250
+// how long the event thread waits on a stalled render thread before handling input again
+#define INPUT_POLL_INTERVAL_MS 8
+// where F4 dumps the CPU trace when --trace was not given
+#define DEFAULT_TRACE_PATH "shartvk_trace.json"
+// headless without a surface renders round robin into this many color images, at least MAX_FRAMES_IN_FLIGHT
+#define OFFSCREEN_IMAGE_COUNT 3
+#define OFFSCREEN_COLOR_FORMAT VK_FORMAT_B8G8R8A8_SRGB
+// --benchmark defaults, simulated time advances by a fixed step per frame so runs replay exactly
+#define BENCHMARK_DEFAULT_FRAMES 1000
+#define BENCHMARK_DEFAULT_WARMUP_FRAMES 100
+#define BENCHMARK_TIMESTEP (1.0 / 60.0)
+#define BENCHMARK_ORBIT_DEGREES_PER_SECOND 20.0f
+#define DEFAULT_BENCHMARK_OUTPUT "benchmark.json"
 
 typedef struct {
+    size_t size;
+    char *byteCode;
+} ShaderFile;
+
+// GPU timestamp markers, see vkapp_profiler.h
+#define MAX_GPU_MARKERS 16
+// rolling window the per marker statistics are computed over
+#define GPU_MARKER_HISTORY 256
+
+typedef struct {
+    const char *name;
+    double samplesMs[GPU_MARKER_HISTORY];
+    uint32_t sampleCount;
+    uint32_t nextSample;
+} GpuMarkerStats;
+
+typedef struct {
+    bool enabled;
+    // nanoseconds per timestamp tick
+    double timestampPeriod;
+    uint64_t timestampMask;
+    VkQueryPool queryPools[MAX_FRAMES_IN_FLIGHT];
+    // scopes written into each frame's pool, and the marker each one belongs to
+    uint32_t scopeCounts[MAX_FRAMES_IN_FLIGHT];
+    uint32_t scopeMarkers[MAX_FRAMES_IN_FLIGHT][MAX_GPU_MARKERS];
+    // frame recorded into each pool; results of frames before firstSampledFrame are dropped
+    uint64_t poolFrames[MAX_FRAMES_IN_FLIGHT];
+    uint64_t firstSampledFrame;
+    uint32_t markerCount;
+    GpuMarkerStats markers[MAX_GPU_MARKERS];
+    atomic_bool reportRequested;
+} GpuProfiler;
+
+// host visible readback buffers for frame capture, see vkapp_capture.h
+#define CAPTURE_RING_SIZE 4
+#define NO_CAPTURE_SLOT UINT32_MAX
+#define MAX_CAPTURE_PATH 512
+
+typedef enum {
+    CAPTURE_SLOT_FREE,
+    // copy recorded, waiting on the frame's fence
+    CAPTURE_SLOT_IN_FLIGHT,
+    // handed to a job thread for encoding
+    CAPTURE_SLOT_ENCODING
+} CaptureSlotState;
+
+typedef struct {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void *mapped;
+    bool coherent;
+    atomic_int state;
+    // which frame in flight's fence covers the copy
+    uint32_t frameSlot;
+    uint64_t frameIndex;
+    VkExtent2D extent;
+    VkFormat format;
+    bool raw;
+    const char *directory;
+    JobCounter encoded;
+} CaptureSlot;
+
+typedef struct {
+    // the swapchain images can be a transfer source
+    bool supported;
+    bool created;
+    bool everyFrame;
+    bool raw;
+    const char *directory;
+    atomic_bool requested;
+    CaptureSlot slots[CAPTURE_RING_SIZE];
+    // slot the command buffer being recorded copies into
+    uint32_t recordSlot;
+    // swapchain image the recorded copy reads
+    uint32_t recordImageIndex;
+    uint64_t capturedCount;
+    uint64_t droppedCount;
+} CaptureRing;
+
+// update after bind texture array every draw indexes into, see vkapp_bindless.h
+#define BINDLESS_MAX_TEXTURES 1024
+#define BINDLESS_SET 1
+
+// feedback entries nothing sampled since the last reset
+#define FEEDBACK_NONE UINT32_MAX
+// added to the feedback levels by the shader so levels finer than the sampled image's first stay positive
+#define FEEDBACK_LEVEL_BIAS 16
+
+typedef struct {
+    // VK_EXT_descriptor_indexing with partially bound, update after bind sampled images
+    bool supported;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    uint32_t textureCount;
+    // slots given back by bindlessRemoveTexture, reused before textureCount grows
+    uint32_t freeSlots[BINDLESS_MAX_TEXTURES];
+    uint32_t freeSlotCount;
+    // BINDLESS_MAX_TEXTURES entries per frame in flight, the finest level each slot was
+    // sampled at plus FEEDBACK_LEVEL_BIAS, see vkapp_streaming.h
+    VkBuffer feedbackBuffer;
+    VkDeviceMemory feedbackMemory;
+    uint32_t *feedback;
+} BindlessTextures;
+
+// Pushed for every draw, so per object data never needs a descriptor update.
+// The fragment stage sees the first two fields, DrawConstants in
+// shaders/bindless.frag, the vertex stage the model matrix at offset 16,
+// ObjectConstants in shaders/shader.vert and shaders/multiview.vert.
+typedef struct {
+    uint32_t materialIndex;
+    // first feedback entry of the frame in flight being recorded
+    uint32_t feedbackOffset;
+    uint32_t padding[2];
+    // plain floats: cglm may align mat4 to 32 bytes, which would move it
+    float model[4][4];
+} DrawPushConstants;
+#define DRAW_PUSH_FRAGMENT_SIZE offsetof(DrawPushConstants, padding)
+#define DRAW_PUSH_MODEL_OFFSET offsetof(DrawPushConstants, model)
+
+// descriptor pools that grow on demand and sets cached by what they point at, see vkapp_descriptors.h
+#define DESCRIPTOR_MAX_POOLS 32
+#define DESCRIPTOR_MAX_BINDINGS 8
+
+typedef struct {
+    VkDescriptorPool pools[DESCRIPTOR_MAX_POOLS];
+    uint32_t poolCount;
+    // the pool allocations come from, pools before it are full until the next reset
+    uint32_t currentPool;
+    // maxSets of the next pool created, grows with every pool
+    uint32_t setsPerPool;
+    uint64_t allocatedSets;
+} DescriptorAllocator;
+
+typedef struct {
+    uint32_t binding;
+    VkDescriptorType type;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize range;
+    VkImageView imageView;
+    VkSampler sampler;
+    VkImageLayout imageLayout;
+} DescriptorBinding;
+
+// a set's layout and everything written into it, zeroed first so it can be hashed and compared as bytes
+typedef struct {
+    VkDescriptorSetLayout layout;
+    uint32_t bindingCount;
+    DescriptorBinding bindings[DESCRIPTOR_MAX_BINDINGS];
+} DescriptorSetKey;
+
+typedef struct {
+    uint64_t hash;
+    DescriptorSetKey key;
+    VkDescriptorSet set;
+} DescriptorCacheEntry;
+
+// open addressing, capacity is a power of two
+typedef struct {
+    DescriptorAllocator allocator;
+    DescriptorCacheEntry *entries;
+    uint32_t capacity;
+    uint32_t count;
+    uint64_t hits;
+    uint64_t misses;
+} DescriptorCache;
+
+// samplers shared by everything asking for the same state, see vkapp_samplers.h
+typedef struct {
+    VkFilter magFilter;
+    VkFilter minFilter;
+    VkSamplerMipmapMode mipmapMode;
+    VkSamplerAddressMode addressModeU;
+    VkSamplerAddressMode addressModeV;
+    VkSamplerAddressMode addressModeW;
+    // 0 or 1 disables anisotropic filtering
+    float maxAnisotropy;
+    float minLod;
+    float maxLod;
+} SamplerKey;
+
+typedef struct {
+    SamplerKey key;
+    VkSampler sampler;
+} SamplerCacheEntry;
+
+typedef struct {
+    SamplerCacheEntry *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t hits;
+} SamplerCache;
+
+// passes declaring what they read and write, barriers and transient attachments worked out from that, see vkapp_rendergraph.h
+#define RENDER_GRAPH_MAX_RESOURCES 32
+#define RENDER_GRAPH_MAX_PASSES 16
+#define RENDER_GRAPH_MAX_ACCESSES 8
+#define RENDER_GRAPH_MAX_BARRIERS (RENDER_GRAPH_MAX_PASSES * RENDER_GRAPH_MAX_ACCESSES + RENDER_GRAPH_MAX_RESOURCES)
+#define RENDER_GRAPH_MAX_RENDER_PASSES 8
+#define RENDER_GRAPH_MAX_FRAMEBUFFERS 16
+
+typedef enum {
+    RENDER_GRAPH_COLOR_ATTACHMENT,
+    RENDER_GRAPH_DEPTH_ATTACHMENT,
+    RENDER_GRAPH_FRAGMENT_SAMPLED,
+    RENDER_GRAPH_FRAGMENT_STORAGE,
+    RENDER_GRAPH_TRANSFER_SRC,
+    RENDER_GRAPH_TRANSFER_DST,
+    // written by resolving a multisampled color attachment of the same pass into it
+    RENDER_GRAPH_RESOLVE_ATTACHMENT,
+    RENDER_GRAPH_USAGE_COUNT
+} RenderGraphUsage;
+
+// layout is ignored for buffers
+typedef struct {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+} RenderGraphState;
+
+typedef struct {
+    const char *name;
+    bool imported;
+    bool isBuffer;
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageAspectFlags aspect;
+    // imported images are single sampled
+    VkSampleCountFlagBits samples;
+    // set on import, or by the graph for transients once compiled
+    VkImage image;
+    VkImageView view;
+    VkBuffer buffer;
+    // imported resources: the state they are in before the first pass and are left in after the last
+    RenderGraphState initial;
+    RenderGraphState final;
+} RenderGraphResource;
+
+typedef struct {
+    uint32_t resource;
+    RenderGraphUsage usage;
+    // attachments only, the old contents are not needed
+    bool clear;
+    VkClearValue clearValue;
+    // RENDER_GRAPH_RESOLVE_ATTACHMENT only, the multisampled resource resolved from
+    uint32_t resolveSource;
+} RenderGraphAccess;
+
+// passes record through this, VkApp is defined further down
+typedef struct VkApp VkApp;
+typedef void (*RenderGraphRecordFn)(VkApp *pApp, VkCommandBuffer commandBuffer, void *data);
+
+typedef struct {
+    const char *name;
+    RenderGraphRecordFn record;
+    void *data;
+    RenderGraphAccess accesses[RENDER_GRAPH_MAX_ACCESSES];
+    uint32_t accessCount;
+} RenderGraphPass;
+
+// src.layout is the old layout, dst.layout the new one
+typedef struct {
+    uint32_t resource;
+    RenderGraphState src;
+    RenderGraphState dst;
+} RenderGraphBarrier;
+
+typedef struct {
+    uint32_t pass;
+    // barriers recorded before the pass
+    uint32_t firstBarrier;
+    uint32_t barrierCount;
+    // VK_NULL_HANDLE when the pass records outside a render pass
+    VkRenderPass renderPass;
+    // indices into the pass' accesses, in attachment order
+    uint32_t attachments[RENDER_GRAPH_MAX_ACCESSES];
+    uint32_t attachmentCount;
+} RenderGraphStep;
+
+// what compiling a frame's declarations produced, reused while they stay the same
+typedef struct {
+    bool compiled;
+    uint64_t hash;
+    RenderGraphStep steps[RENDER_GRAPH_MAX_PASSES];
+    uint32_t stepCount;
+    RenderGraphBarrier barriers[RENDER_GRAPH_MAX_BARRIERS];
+    uint32_t barrierCount;
+    // imported resources moved into their final state after the last step
+    uint32_t firstFinalBarrier;
+    uint32_t finalBarrierCount;
+} RenderGraphPlan;
+
+// transient images by resource index; memory is shared by images whose lifetimes don't overlap
+typedef struct {
+    uint64_t hash;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    VkImage images[RENDER_GRAPH_MAX_RESOURCES];
+    VkImageView views[RENDER_GRAPH_MAX_RESOURCES];
+    // transients whose memory overlaps, each image's own bit included
+    uint32_t aliases[RENDER_GRAPH_MAX_RESOURCES];
+    // attachments that never leave their pass get their own lazily allocated memory instead, where the device has it
+    VkDeviceMemory lazyMemories[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t lazyCount;
+} RenderGraphTransients;
+
+typedef struct {
+    // zeroed first so it can be compared as bytes
+    VkAttachmentDescription attachments[RENDER_GRAPH_MAX_ACCESSES];
+    // the attachment each one is resolved into, VK_ATTACHMENT_UNUSED for none
+    uint32_t resolves[RENDER_GRAPH_MAX_ACCESSES];
+    uint32_t attachmentCount;
+    VkRenderPass renderPass;
+} RenderGraphRenderPass;
+
+typedef struct {
+    VkRenderPass renderPass;
+    VkImageView views[RENDER_GRAPH_MAX_ACCESSES];
+    uint32_t viewCount;
+    VkExtent2D extent;
+    VkFramebuffer framebuffer;
+} RenderGraphFramebuffer;
+
+typedef struct {
+    // declared by the frame being recorded
+    RenderGraphResource resources[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t resourceCount;
+    RenderGraphPass passes[RENDER_GRAPH_MAX_PASSES];
+    uint32_t passCount;
+    RenderGraphPlan plan;
+    RenderGraphTransients transients;
+    RenderGraphRenderPass renderPasses[RENDER_GRAPH_MAX_RENDER_PASSES];
+    uint32_t renderPassCount;
+    RenderGraphFramebuffer framebuffers[RENDER_GRAPH_MAX_FRAMEBUFFERS];
+    uint32_t framebufferCount;
+    uint64_t compileCount;
+} RenderGraph;
+
+// streams finer mips in as the GPU asks for them, see vkapp_streaming.h
+typedef struct TextureStreamer TextureStreamer;
+#define STREAMING_DEFAULT_BUDGET_MB 256
+
+// small textures packed into shared pages, see vkapp_atlas.h
+typedef struct TextureAtlas TextureAtlas;
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+} DeviceAllocation;
+
+// every live vkAllocateMemory made through allocateDeviceMemory, so a free knows what it gives back
+typedef struct {
+    SDL_mutex *lock;
+    DeviceAllocation *allocations;
+    uint32_t count;
+    uint32_t capacity;
+    VkDeviceSize liveBytes;
+    VkDeviceSize peakBytes;
+} DeviceMemoryStats;
+
+typedef struct VkApp {
     uint32_t width;
     uint32_t height;
     char *title;
@@ -10,6 +387,8 @@ typedef struct {
     VkDebugUtilsMessengerEXT debugMessenger;
     VkSurfaceKHR surface;
     VkPhysicalDevice physicalDevice;
+    // properties and limits of physicalDevice, queried once when the device is created
+    VkPhysicalDeviceProperties deviceProperties;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
@@ -18,7 +397,6 @@ typedef struct {
     VkImage *swapChainImages;
     VkFormat swapChainImageFormat;
     VkImageView *swapChainImageViews;
-    VkFramebuffer *swapChainFramebuffers;
     VkExtent2D swapChainExtent;
     VkRenderPass renderPass;
     VkDescriptorSetLayout descriptorSetLayout;
@@ -33,7 +411,8 @@ typedef struct {
     VkBuffer uniformBuffers[MAX_FRAMES_IN_FLIGHT];
     VkDeviceMemory uniformBuffersMemory[MAX_FRAMES_IN_FLIGHT];
     void* uniformBuffersMapped[MAX_FRAMES_IN_FLIGHT];
-    VkDescriptorPool descriptorPool;
+    // sets that live until shutdown, shared by everything that writes the same descriptors
+    DescriptorCache descriptorCache;
     VkDescriptorSet descriptorSets[MAX_FRAMES_IN_FLIGHT];
     VkSemaphore imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
     VkSemaphore renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
@@ -41,11 +420,73 @@ typedef struct {
     VkImage textureImage;
     VkDeviceMemory textureImageMemory;
     VkImageView textureImageView;
+    // owned by samplerCache
     VkSampler textureSampler;
+    SamplerCache samplerCache;
+    VkFormat textureFormat;
+    uint32_t textureMipLevels;
+    // whether textureCompressionBC was enabled on the device
+    bool textureCompressionBC;
     uint32_t currentFrame;
-    VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
-    VkImageView depthImageView;
+    // the depth buffer itself is a transient of the render graph
+    VkFormat depthFormat;
+    // --msaa, samples of the color and depth attachments, resolved into the backbuffer when above 1
+    VkSampleCountFlagBits msaaSamples;
+    RenderGraph renderGraph;
+    VkExtent2D drawableExtent;
+    atomic_bool framebufferResized;
+    bool minimized;
+    bool renderOnDemand;
+    bool animating;
+    bool redrawRequested;
+    double animationTime;
+    uint64_t lastFrameCounter;
+    uint64_t simulatedFrameCount;
+    FrameStateBuffer frameStates;
+    SDL_Thread *renderThread;
+    SDL_sem *frameReady;
+    SDL_sem *frameConsumed;
+    atomic_bool renderThreadQuit;
+    JobSystem jobSystem;
+    // CPU side assets produced by startup jobs, released once uploaded
+    ShaderFile vertexShaderFile;
+    ShaderFile fragmentShaderFile;
+    ShaderFile bindlessFragmentShaderFile;
+    StartupTimer startupTimer;
+    const char *startupReportPath;
+    const char *tracePath;
+    GpuProfiler gpuProfiler;
+    FrameStats frameStats;
+    bool printFrameStats;
+    // no window; without a headless surface there is no swapchain either (surface stays VK_NULL_HANDLE)
+    bool headless;
+    bool useHeadlessSurface;
+    VkDeviceMemory *offscreenImageMemory;
+    uint32_t offscreenImageIndex;
+    bool benchmark;
+    uint32_t benchmarkFrames;
+    uint32_t benchmarkWarmupFrames;
+    const char *benchmarkOutputPath;
+    bool uncappedPresent;
+    DeviceMemoryStats deviceMemory;
+    CaptureRing capture;
+    // --serve, see vkapp_service.h
+    const char *servicePath;
+    // Vulkan version the instance was created for
+    uint32_t apiVersion;
+    // views a multiview render pass may draw, 1 without multiview
+    bool multiviewSupported;
+    uint32_t maxMultiviewViews;
+    BindlessTextures bindless;
+    // slot of the loaded texture in the bindless array, what the model draw pushes
+    uint32_t materialIndex;
+    // --stream-textures, the model's texture is then the streamer's texture 0 and its slot changes as it streams
+    bool streamTextures;
+    VkDeviceSize textureBudget;
+    TextureStreamer *pTextureStreamer;
+    // --atlas, a .atlas manifest or a list of images to pack
+    const char *atlasPath;
+    TextureAtlas *pTextureAtlas;
 } VkApp;
 
 void populateVkApp(uint32_t width,uint32_t height, char *title, VkApp *pApp) {
@@ -65,6 +506,58 @@ void populateVkApp(uint32_t width,uint32_t height, char *title, VkApp *pApp) {
     pApp->swapChainImageViews = NULL;
     pApp->pipelineLayout = VK_NULL_HANDLE;
     pApp->currentFrame = 0;
+    pApp->drawableExtent = (VkExtent2D){width, height};
+    atomic_init(&pApp->framebufferResized, false);
+    pApp->minimized = false;
+    pApp->renderOnDemand = false;
+    pApp->animating = true;
+    pApp->redrawRequested = true;
+    pApp->animationTime = 0.0;
+    pApp->lastFrameCounter = 0;
+    pApp->simulatedFrameCount = 0;
+    initFrameStateBuffer(&pApp->frameStates);
+    pApp->renderThread = NULL;
+    pApp->frameReady = NULL;
+    pApp->frameConsumed = NULL;
+    atomic_init(&pApp->renderThreadQuit, false);
+    pApp->msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    pApp->textureMipLevels = 1;
+    pApp->textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    pApp->textureCompressionBC = false;
+    pApp->vertexShaderFile = (ShaderFile){0};
+    pApp->fragmentShaderFile = (ShaderFile){0};
+    pApp->bindlessFragmentShaderFile = (ShaderFile){0};
+    initStartupTimer(&pApp->startupTimer);
+    pApp->startupReportPath = NULL;
+    pApp->tracePath = NULL;
+    memset(&pApp->gpuProfiler, 0, sizeof(pApp->gpuProfiler));
+    atomic_init(&pApp->gpuProfiler.reportRequested, false);
+    pApp->printFrameStats = false;
+    pApp->headless = false;
+    pApp->useHeadlessSurface = false;
+    pApp->offscreenImageMemory = NULL;
+    pApp->offscreenImageIndex = 0;
+    pApp->benchmark = false;
+    pApp->benchmarkFrames = BENCHMARK_DEFAULT_FRAMES;
+    pApp->benchmarkWarmupFrames = BENCHMARK_DEFAULT_WARMUP_FRAMES;
+    pApp->benchmarkOutputPath = DEFAULT_BENCHMARK_OUTPUT;
+    pApp->uncappedPresent = false;
+    memset(&pApp->deviceMemory, 0, sizeof(pApp->deviceMemory));
+    memset(&pApp->capture, 0, sizeof(pApp->capture));
+    pApp->capture.directory = ".";
+    pApp->capture.recordSlot = NO_CAPTURE_SLOT;
+    atomic_init(&pApp->capture.requested, false);
+    pApp->servicePath = NULL;
+    pApp->apiVersion = VK_API_VERSION_1_0;
+    pApp->multiviewSupported = false;
+    pApp->maxMultiviewViews = 1;
+    pApp->bindless = (BindlessTextures){0};
+    pApp->materialIndex = 0;
+    pApp->streamTextures = false;
+    pApp->textureBudget = (VkDeviceSize)STREAMING_DEFAULT_BUDGET_MB << 20;
+    pApp->pTextureStreamer = NULL;
+    pApp->atlasPath = NULL;
+    pApp->pTextureAtlas = NULL;
 }
 
 typedef struct {
@@ -113,11 +606,6 @@ uint32_t u32Clamp(uint32_t n, uint32_t min, uint32_t max) {
     return n;
 }
 
-typedef struct {
-    size_t size;
-    char *byteCode;
-} ShaderFile;
-
 void loadShaderFile(const char *filePath, ShaderFile *shaderFile) {
     FILE *pFile = fopen(filePath, "rb");
 
@@ -148,11 +636,20 @@ typedef struct {
     vec2 texCoord;
 } Vertex;
 
+// camera data, written once per frame; the model matrix is pushed per draw
 typedef struct {
-    mat4 model;
     mat4 view;
     mat4 proj;
-} UniformBufferObject;
+} CameraUniformBufferObject;
+
+// must match MAX_VIEWS in shaders/multiview.vert
+#define MULTIVIEW_MAX_VIEWS 4
+
+// CameraUniformBufferObject for shaders/multiview.vert, view and proj are indexed by gl_ViewIndex
+typedef struct {
+    mat4 view[MULTIVIEW_MAX_VIEWS];
+    mat4 proj[MULTIVIEW_MAX_VIEWS];
+} MultiviewCameraUniformBufferObject;
 
 VkVertexInputBindingDescription getVertexBindingDescription() {
     VkVertexInputBindingDescription bindingDescription = {0};
@@ -25,15 +25,40 @@ uint32_t modelIndexCount = 0;
 uint32_t *modelIndices;
 
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
-void updateUniformBuffer(uint32_t currentImage, VkApp *pApp);
+void updateUniformBuffer(uint32_t currentImage, const FrameState *pState, VkApp *pApp);
 
+VkResult allocateDeviceMemory(const VkMemoryAllocateInfo *pAllocateInfo, VkDeviceMemory *pMemory, VkApp *pApp);
+void freeDeviceMemory(VkDeviceMemory memory, VkApp *pApp);
 VkCommandBuffer beginSingleTimeCommands(VkApp *pApp);
 void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkApp *pApp);
+void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *pImage, VkDeviceMemory *pImageMemory, VkApp *pApp);
+void createLayeredImage(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *pImage, VkDeviceMemory *pImageMemory, VkApp *pApp);
 VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkApp *pApp);
+VkImageView createLayeredImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t layers, VkApp *pApp);
 VkFormat findSupportedFormat(VkFormat *availableFormats, uint32_t availableFormatCount, VkImageTiling tiling, VkFormatFeatureFlags features, VkApp *pApp);
 VkFormat findDepthFormat(VkApp *pApp);
 bool hasStencilComponent(VkFormat format);
-void createDepthResources(VkApp *pApp);
+void createRenderPassWithViews(VkApp *pApp, uint32_t viewCount, VkSampleCountFlagBits samples, VkRenderPass *pRenderPass);
+void gpuProfilerBeginFrame(VkApp *pApp, VkCommandBuffer commandBuffer, uint64_t frameIndex);
+uint32_t gpuProfilerBegin(VkApp *pApp, VkCommandBuffer commandBuffer, const char *name);
+void gpuProfilerEnd(VkApp *pApp, VkCommandBuffer commandBuffer, uint32_t scope);
+void destroyCaptureRing(VkApp *pApp);
+void captureBeginFrame(VkApp *pApp, uint64_t frameIndex);
+void captureAddPass(VkApp *pApp, RenderGraph *pGraph, uint32_t backbuffer, uint32_t imageIndex);
+void captureSubmitted(VkApp *pApp);
+uint32_t textureStreamerSlot(TextureStreamer *pStreamer, uint32_t texture);
+void textureStreamerBeginFrame(VkApp *pApp);
+uint32_t textureStreamerImportFeedback(VkApp *pApp, RenderGraph *pGraph);
+void renderGraphBegin(RenderGraph *pGraph);
+uint32_t renderGraphImportImage(RenderGraph *pGraph, const char *name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+                                VkImageAspectFlags aspect, RenderGraphState initial, RenderGraphState final);
+uint32_t renderGraphCreateImage(RenderGraph *pGraph, const char *name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect, VkSampleCountFlagBits samples);
+uint32_t renderGraphAddPass(RenderGraph *pGraph, const char *name, RenderGraphRecordFn record, void *data);
+RenderGraphAccess *renderGraphUse(RenderGraph *pGraph, uint32_t pass, uint32_t resource, RenderGraphUsage usage);
+void renderGraphClear(RenderGraph *pGraph, uint32_t pass, uint32_t resource, RenderGraphUsage usage, VkClearValue clearValue);
+void renderGraphResolve(RenderGraph *pGraph, uint32_t pass, uint32_t source, uint32_t target);
+void renderGraphExecute(RenderGraph *pGraph, VkCommandBuffer commandBuffer, VkApp *pApp);
+void renderGraphReleaseTargets(RenderGraph *pGraph, VkApp *pApp);
 
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(uint32_t formatCount, VkSurfaceFormatKHR *availableFormats) {
     for (uint32_t i = 0; i < formatCount; i++) {
@@ -44,7 +69,13 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(uint32_t formatCount, VkSurfaceFormat
     return availableFormats[0];
 }
 
-VkPresentModeKHR chooseSwapPresentMode(uint32_t presentModeCount, VkPresentModeKHR *availablePresentModes) {
+VkPresentModeKHR chooseSwapPresentMode(uint32_t presentModeCount, VkPresentModeKHR *availablePresentModes, bool uncapped) {
+    // uncapped wants every frame presented as soon as it is done, tearing or not
+    for (uint32_t i = 0; uncapped && i < presentModeCount; i++) {
+        if (availablePresentModes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+            return availablePresentModes[i];
+        }
+    }
     for (uint32_t i = 0; i < presentModeCount; i++) {
         if (availablePresentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
             return availablePresentModes[i];
@@ -53,20 +84,14 @@ VkPresentModeKHR chooseSwapPresentMode(uint32_t presentModeCount, VkPresentModeK
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D chooseSwapExtent(SDL_Window *window, VkSurfaceCapabilitiesKHR capabilities) {
+VkExtent2D chooseSwapExtent(VkExtent2D drawableExtent, VkSurfaceCapabilitiesKHR capabilities) {
     // when the WM sets the current extent width to the max value of uint32_t
     // we can set the current extent to the window size in pixels
     if (capabilities.currentExtent.width != UINT32_MAX) {
         return capabilities.currentExtent;
     }
-    int width;
-    int height;
-    SDL_GL_GetDrawableSize(window, &width, &height);
-
-    VkExtent2D actualExtent = {
-        (uint32_t)width,
-        (uint32_t)height
-    };
+    // the drawable size is queried on the event thread, SDL video calls aren't safe from the render thread
+    VkExtent2D actualExtent = drawableExtent;
 
     actualExtent.width = u32Clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
     actualExtent.height = u32Clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
@@ -102,11 +127,34 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurface
     return details;
 }
 
+// Stand-in for the swapchain when there is no surface: a small ring of
+// color images rendered into round robin and left in TRANSFER_SRC layout.
+void createOffscreenImages(VkApp *pApp) {
+    pApp->swapChainImageCount = OFFSCREEN_IMAGE_COUNT;
+    pApp->swapChainImageFormat = OFFSCREEN_COLOR_FORMAT;
+    pApp->swapChainExtent = pApp->drawableExtent;
+    pApp->swapChainImages = (VkImage*)malloc(sizeof(VkImage) * OFFSCREEN_IMAGE_COUNT);
+    pApp->offscreenImageMemory = (VkDeviceMemory*)malloc(sizeof(VkDeviceMemory) * OFFSCREEN_IMAGE_COUNT);
+    if (pApp->swapChainImages == NULL || pApp->offscreenImageMemory == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate for offscreen images!\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++) {
+        createImage(pApp->swapChainExtent.width, pApp->swapChainExtent.height, OFFSCREEN_COLOR_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pApp->swapChainImages[i], &pApp->offscreenImageMemory[i], pApp);
+    }
+    pApp->offscreenImageIndex = 0;
+}
+
 void createSwapChain(VkApp *pApp) {
+    if (pApp->surface == VK_NULL_HANDLE) {
+        createOffscreenImages(pApp);
+        pApp->capture.supported = true;
+        return;
+    }
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(pApp->physicalDevice, pApp->surface);
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formatCount, swapChainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModeCount, swapChainSupport.presentModes);
-    VkExtent2D extent = chooseSwapExtent(pApp->window, swapChainSupport.capabilities);
+    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModeCount, swapChainSupport.presentModes, pApp->uncappedPresent);
+    VkExtent2D extent = chooseSwapExtent(pApp->drawableExtent, swapChainSupport.capabilities);
 
     // reccommended to request at least one more image than minimum so we don't have to wait for the driver
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -114,6 +162,12 @@ void createSwapChain(VkApp *pApp) {
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
+    // frame capture copies out of the swapchain images
+    VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    pApp->capture.supported = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (pApp->capture.supported) {
+        imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
 
     VkSwapchainCreateInfoKHR swapChainCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -125,7 +179,7 @@ void createSwapChain(VkApp *pApp) {
         .imageColorSpace = surfaceFormat.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = imageUsage,
         
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
@@ -207,6 +261,21 @@ bool checkExtensionSupport(uint32_t requiredExtensionCount, const char **require
     return true;
 }
 
+// quiet check for optional instance extensions
+bool instanceExtensionAvailable(const char *extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+
+    VkExtensionProperties availableExtensions[extensionCount];
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, availableExtensions);
+    for (uint32_t i = 0; i < extensionCount; i++) {
+        if (strcmp(extensionName, availableExtensions[i].extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
     // get the available layers
     uint32_t extensionCount;
@@ -241,6 +310,14 @@ void app_createVulkanInstance(VkApp *pApp) {
         exit(1);
     }
 
+    // 1.1 whenever the loader has it, multiview is core there
+    pApp->apiVersion = VK_API_VERSION_1_0;
+    PFN_vkEnumerateInstanceVersion enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion");
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    if (enumerateInstanceVersion != NULL && enumerateInstanceVersion(&loaderVersion) == VK_SUCCESS && loaderVersion >= VK_API_VERSION_1_1) {
+        pApp->apiVersion = VK_API_VERSION_1_1;
+    }
+
     printf("Hi from fucknuts!\n");
     VkApplicationInfo appInfo = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -249,7 +326,7 @@ void app_createVulkanInstance(VkApp *pApp) {
         .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
         .pEngineName = "No Engine",
         .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_0
+        .apiVersion = pApp->apiVersion
     };
     VkInstanceCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -271,14 +348,26 @@ void app_createVulkanInstance(VkApp *pApp) {
 
     // get extension count first
     uint32_t sdlExtensionCount = 0;
-    if (!SDL_Vulkan_GetInstanceExtensions(pApp->window, &sdlExtensionCount, NULL)) {
+    if (pApp->headless) {
+        // no window to ask SDL about, a headless surface is the only surface we might need
+        if (pApp->useHeadlessSurface && !(instanceExtensionAvailable(VK_KHR_SURFACE_EXTENSION_NAME) && instanceExtensionAvailable(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME))) {
+            printf("INFO: %s not available, rendering offscreen instead\n", VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+            pApp->useHeadlessSurface = false;
+        }
+        sdlExtensionCount = pApp->useHeadlessSurface ? 2 : 0;
+    } else if (!SDL_Vulkan_GetInstanceExtensions(pApp->window, &sdlExtensionCount, NULL)) {
         fprintf(stderr, "ERROR: Failed to get instance extensions count. %s\n", SDL_GetError());
         exit(1);
     }
     printf("SDL extension amount: %d\n", sdlExtensionCount);
     // then allocate and get the extension array
-    const char* sdlExtensions[sdlExtensionCount];
-    if (!SDL_Vulkan_GetInstanceExtensions(pApp->window, &sdlExtensionCount, sdlExtensions)) {
+    const char* sdlExtensions[sdlExtensionCount + 1];
+    if (pApp->headless) {
+        if (pApp->useHeadlessSurface) {
+            sdlExtensions[0] = VK_KHR_SURFACE_EXTENSION_NAME;
+            sdlExtensions[1] = VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME;
+        }
+    } else if (!SDL_Vulkan_GetInstanceExtensions(pApp->window, &sdlExtensionCount, sdlExtensions)) {
         fprintf(stderr, "ERROR: Failed to get instance extensions count. %s\n", SDL_GetError());
         exit(1);
     }
@@ -326,7 +415,12 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
         }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface == VK_NULL_HANDLE) {
+            // offscreen, "presenting" is a copy on the graphics queue
+            presentSupport = (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        } else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        }
         if (presentSupport) {
             printf("Found supported queueFamily for presentation! Index: %d\n", i);
             indices.presentFamily = i;
@@ -346,17 +440,20 @@ bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
         return false;
     }
 
-    if (!checkDeviceExtensionSupport(device)) {
-        fprintf(stderr, "ERROR: Required device extensions not supported!");
-        return false;
-    }
+    // offscreen rendering needs neither the swapchain extension nor a surface to present to
+    if (surface != VK_NULL_HANDLE) {
+        if (!checkDeviceExtensionSupport(device)) {
+            fprintf(stderr, "ERROR: Required device extensions not supported!");
+            return false;
+        }
 
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
-    printf("Supported image formats: %d\n", swapChainSupport.formatCount);
-    printf("Supported present modes: %d\n", swapChainSupport.presentModeCount);
-    if ((swapChainSupport.formatCount == 0) || (swapChainSupport.presentModeCount == 0)){
-        fprintf(stderr, "ERROR: SwapChain is not adequately supported ");
-        return false;
+        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
+        printf("Supported image formats: %d\n", swapChainSupport.formatCount);
+        printf("Supported present modes: %d\n", swapChainSupport.presentModeCount);
+        if ((swapChainSupport.formatCount == 0) || (swapChainSupport.presentModeCount == 0)){
+            fprintf(stderr, "ERROR: SwapChain is not adequately supported ");
+            return false;
+        }
     }
 
     VkPhysicalDeviceFeatures supportedFeatures;
@@ -389,11 +486,106 @@ void pickPhysicalDevice(VkApp *pApp) {
     if (pApp->physicalDevice == VK_NULL_HANDLE) {
         fprintf(stderr, "failed to a suitable GPU!\n");
         exit(1);
-    } else {
-        VkPhysicalDeviceProperties deviceProperties;
-        vkGetPhysicalDeviceProperties(pApp->physicalDevice, &deviceProperties);
-        printf("Found a suitable GPU: %s!\n", deviceProperties.deviceName);
     }
+    // the limits are read from here on instead of asking the device again
+    vkGetPhysicalDeviceProperties(pApp->physicalDevice, &pApp->deviceProperties);
+    printf("Found a suitable GPU: %s!\n", pApp->deviceProperties.deviceName);
+}
+
+// multiview needs a 1.1 instance and device; fills in multiviewSupported and maxMultiviewViews
+void queryMultiviewSupport(VkApp *pApp) {
+    pApp->multiviewSupported = false;
+    pApp->maxMultiviewViews = 1;
+    if (pApp->apiVersion < VK_API_VERSION_1_1 || pApp->deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+        return;
+    }
+    // looked up rather than linked so a 1.0 loader still runs the rest of the app
+    PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(pApp->instance, "vkGetPhysicalDeviceFeatures2");
+    PFN_vkGetPhysicalDeviceProperties2 getProperties2 = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(pApp->instance, "vkGetPhysicalDeviceProperties2");
+    if (getFeatures2 == NULL || getProperties2 == NULL) {
+        return;
+    }
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,
+        .pNext = NULL
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &multiviewFeatures
+    };
+    getFeatures2(pApp->physicalDevice, &features);
+    VkPhysicalDeviceMultiviewProperties multiviewProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES,
+        .pNext = NULL
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &multiviewProperties
+    };
+    getProperties2(pApp->physicalDevice, &properties);
+    if (!multiviewFeatures.multiview || multiviewProperties.maxMultiviewViewCount < 2) {
+        return;
+    }
+    pApp->multiviewSupported = true;
+    pApp->maxMultiviewViews = multiviewProperties.maxMultiviewViewCount < MULTIVIEW_MAX_VIEWS ? multiviewProperties.maxMultiviewViewCount : MULTIVIEW_MAX_VIEWS;
+}
+
+bool deviceHasExtension(VkPhysicalDevice device, const char *extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+    VkExtensionProperties availableExtensions[extensionCount];
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, availableExtensions);
+    for (uint32_t i = 0; i < extensionCount; i++) {
+        if (strcmp(extensionName, availableExtensions[i].extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bindless needs dynamic indexing into the sampler array, since the shader
+// picks the texture with a pushed index, plus partially bound, update after
+// bind sampled images, and room for the whole array. The streaming feedback
+// written by the same shader adds fragment atomics and update unused while pending.
+void queryDescriptorIndexingSupport(VkApp *pApp) {
+    pApp->bindless.supported = false;
+    if (pApp->apiVersion < VK_API_VERSION_1_1 || pApp->deviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+        !deviceHasExtension(pApp->physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        return;
+    }
+    PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(pApp->instance, "vkGetPhysicalDeviceFeatures2");
+    PFN_vkGetPhysicalDeviceProperties2 getProperties2 = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(pApp->instance, "vkGetPhysicalDeviceProperties2");
+    if (getFeatures2 == NULL || getProperties2 == NULL) {
+        return;
+    }
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+        .pNext = NULL
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &indexingFeatures
+    };
+    getFeatures2(pApp->physicalDevice, &features);
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+        .pNext = NULL
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &indexingProperties
+    };
+    getProperties2(pApp->physicalDevice, &properties);
+    if (!features.features.shaderSampledImageArrayDynamicIndexing ||
+        !indexingFeatures.descriptorBindingPartiallyBound || !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+        !features.features.fragmentStoresAndAtomics || !indexingFeatures.descriptorBindingUpdateUnusedWhilePending ||
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers < BINDLESS_MAX_TEXTURES ||
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages < BINDLESS_MAX_TEXTURES ||
+        indexingProperties.maxDescriptorSetUpdateAfterBindSamplers < BINDLESS_MAX_TEXTURES ||
+        indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages < BINDLESS_MAX_TEXTURES) {
+        return;
+    }
+    pApp->bindless.supported = true;
 }
 
 void createLogicalDevice(VkApp *pApp) {
@@ -421,16 +613,64 @@ void createLogicalDevice(VkApp *pApp) {
     // initialize all features to false by default
     VkPhysicalDeviceFeatures deviceFeatures = {VK_FALSE};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // for KTX2 textures, optional so PNG textures still work without it
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(pApp->physicalDevice, &supportedFeatures);
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    pApp->textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+    queryMultiviewSupport(pApp);
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES,
+        .pNext = NULL,
+        .multiview = VK_TRUE,
+        .multiviewGeometryShader = VK_FALSE,
+        .multiviewTessellationShader = VK_FALSE
+    };
+
+
+    queryDescriptorIndexingSupport(pApp);
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+        .pNext = NULL,
+        .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE
+    };
+    if (pApp->bindless.supported) {
+        // textures[] is indexed with the pushed material index
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+        // streaming feedback
+        deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    }
+    void *pFeatureChain = NULL;
+    if (pApp->multiviewSupported) {
+        multiviewFeatures.pNext = pFeatureChain;
+        pFeatureChain = &multiviewFeatures;
+    }
+    if (pApp->bindless.supported) {
+        indexingFeatures.pNext = pFeatureChain;
+        pFeatureChain = &indexingFeatures;
+    }
+
+    const char *enabledExtensions[DEVICE_EXTENSION_COUNT + 1];
+    uint32_t enabledExtensionCount = 0;
+    for (uint32_t i = 0; pApp->surface != VK_NULL_HANDLE && i < DEVICE_EXTENSION_COUNT; i++) {
+        enabledExtensions[enabledExtensionCount++] = deviceExtensions[i];
+    }
+    if (pApp->bindless.supported) {
+        enabledExtensions[enabledExtensionCount++] = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
+    }
 
     VkDeviceCreateInfo logicalDeviceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext = NULL,
+        .pNext = pFeatureChain,
         .flags = 0,
         .pQueueCreateInfos = queueCreateInfos,
         .queueCreateInfoCount = 1,
         .pEnabledFeatures = &deviceFeatures,
-        .enabledExtensionCount = DEVICE_EXTENSION_COUNT,
-        .ppEnabledExtensionNames = deviceExtensions,
+        .enabledExtensionCount = enabledExtensionCount,
+        .ppEnabledExtensionNames = enabledExtensions,
     };
 #ifdef ENABLE_VALIDATION_LAYERS
         logicalDeviceCreateInfo.enabledLayerCount = VALIDATION_LAYER_COUNT;
@@ -448,6 +688,23 @@ void createLogicalDevice(VkApp *pApp) {
 }
 
 void createSurface(VkApp *pApp) {
+    if (pApp->headless) {
+        if (!pApp->useHeadlessSurface) {
+            pApp->surface = VK_NULL_HANDLE;
+            return;
+        }
+        VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {
+            .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+            .pNext = NULL,
+            .flags = 0
+        };
+        PFN_vkCreateHeadlessSurfaceEXT func = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(pApp->instance, "vkCreateHeadlessSurfaceEXT");
+        if (func == NULL || func(pApp->instance, &surfaceInfo, NULL, &pApp->surface) != VK_SUCCESS) {
+            fprintf(stderr, "failed to create headless surface!\n");
+            exit(1);
+        }
+        return;
+    }
     if (SDL_Vulkan_CreateSurface(pApp->window, pApp->instance, &pApp->surface) != SDL_TRUE) {
         fprintf(stderr, "failed to create window surface!\n");
         exit(1);
@@ -471,15 +728,16 @@ VkShaderModule createShaderModule(VkApp *pApp, ShaderFile *file) {
     return shaderModule;
 }
 
-void createGraphicsPipeline(VkApp *pApp) {
-    ShaderFile vertexShader = {0};
-    ShaderFile fragmentShader = {0};
-    loadShaderFile("shaders/vert.spv", &vertexShader);
-    loadShaderFile("shaders/frag.spv", &fragmentShader);
-
-    VkShaderModule vertexShaderModule = createShaderModule(pApp, &vertexShader);
-    VkShaderModule fragmentShaderModule = createShaderModule(pApp, &fragmentShader);
+void loadShaders(VkApp *pApp) {
+    loadShaderFile("shaders/vert.spv", &pApp->vertexShaderFile);
+    loadShaderFile("shaders/frag.spv", &pApp->fragmentShaderFile);
+    // whether the device can use it is only known later, it is small enough to load either way
+    loadShaderFile("shaders/bindless_frag.spv", &pApp->bindlessFragmentShaderFile);
+}
 
+// expects loadShaders() to have finished
+// the fixed function state every pipeline drawing the model shares, using pApp->pipelineLayout
+void createPipelineForPass(VkApp *pApp, VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule, VkRenderPass renderPass, VkSampleCountFlagBits samples, VkPipeline *pPipeline) {
     VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = NULL,
@@ -596,7 +854,7 @@ void createGraphicsPipeline(VkApp *pApp) {
         .pNext = NULL,
         .flags = 0,
         .sampleShadingEnable = VK_FALSE,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .rasterizationSamples = samples,
         .minSampleShading = 1.0f,
         .pSampleMask = NULL,
         .alphaToCoverageEnable = VK_FALSE,
@@ -628,21 +886,6 @@ void createGraphicsPipeline(VkApp *pApp) {
         .blendConstants[3] = 0.0f 
     };
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .setLayoutCount = 1,
-        .pSetLayouts = &pApp->descriptorSetLayout,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = NULL
-    };
-
-    if (vkCreatePipelineLayout(pApp->device, &pipelineLayoutInfo, NULL, &pApp->pipelineLayout) != VK_SUCCESS) {
-        fprintf(stderr, "ERROR: pipeline layout creation failed!");
-        exit(1);
-    }
-
     VkGraphicsPipelineCreateInfo pipelineInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         .pNext = NULL,
@@ -659,27 +902,99 @@ void createGraphicsPipeline(VkApp *pApp) {
         .pColorBlendState = &colorBlending,
         .pDynamicState = &dynamicState,
         .layout = pApp->pipelineLayout,
-        .renderPass = pApp->renderPass,
+        .renderPass = renderPass,
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE,
         .basePipelineIndex = -1
     };
-    if (vkCreateGraphicsPipelines(pApp->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pApp->graphicsPipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(pApp->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, pPipeline) != VK_SUCCESS) {
         fprintf(stderr, "ERROR: Failed to create graphics pipeline!\n");
         exit(1);
     }
+}
+
+void createGraphicsPipeline(VkApp *pApp) {
+    VkShaderModule vertexShaderModule = createShaderModule(pApp, &pApp->vertexShaderFile);
+    VkShaderModule fragmentShaderModule = createShaderModule(pApp, pApp->bindless.supported ? &pApp->bindlessFragmentShaderFile : &pApp->fragmentShaderFile);
+
+    // the bindless array is set 1 and the material index a push constant, pipelines using
+    // only set 0 (frag.spv, the service's multiview pipelines) stay compatible with the layout
+    VkDescriptorSetLayout setLayouts[] = {pApp->descriptorSetLayout, pApp->bindless.setLayout};
+    // the model matrix is always pushed, the material only with bindless
+    VkPushConstantRange pushConstantRanges[] = {
+        {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = DRAW_PUSH_MODEL_OFFSET,
+            .size = sizeof(DrawPushConstants) - DRAW_PUSH_MODEL_OFFSET
+        },
+        {
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = DRAW_PUSH_FRAGMENT_SIZE
+        }
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = pApp->bindless.supported ? 2 : 1,
+        .pSetLayouts = setLayouts,
+        .pushConstantRangeCount = pApp->bindless.supported ? 2 : 1,
+        .pPushConstantRanges = pushConstantRanges
+    };
+
+    if (vkCreatePipelineLayout(pApp->device, &pipelineLayoutInfo, NULL, &pApp->pipelineLayout) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: pipeline layout creation failed!");
+        exit(1);
+    }
+
+    createPipelineForPass(pApp, vertexShaderModule, fragmentShaderModule, pApp->renderPass, pApp->msaaSamples, &pApp->graphicsPipeline);
 
     vkDestroyShaderModule(pApp->device, fragmentShaderModule, NULL);
     vkDestroyShaderModule(pApp->device, vertexShaderModule, NULL);
     // free memory from loadShaderFile (no longer needed, we have the shader modules)
-    free(vertexShader.byteCode);
-    free(fragmentShader.byteCode);
+    free(pApp->vertexShaderFile.byteCode);
+    free(pApp->fragmentShaderFile.byteCode);
+    free(pApp->bindlessFragmentShaderFile.byteCode);
+    pApp->vertexShaderFile = (ShaderFile){0};
+    pApp->fragmentShaderFile = (ShaderFile){0};
+    pApp->bindlessFragmentShaderFile = (ShaderFile){0};
+}
+
+// the most samples, up to the requested count, that both color and depth attachments can have
+VkSampleCountFlagBits chooseMsaaSamples(VkSampleCountFlagBits requested, VkApp *pApp) {
+    const VkPhysicalDeviceLimits *pLimits = &pApp->deviceProperties.limits;
+    VkSampleCountFlags supported = pLimits->framebufferColorSampleCounts & pLimits->framebufferDepthSampleCounts;
+    for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1) {
+        if (count <= (uint32_t)requested && (supported & count)) {
+            return (VkSampleCountFlagBits)count;
+        }
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
 }
 
+// Frames are recorded through the render graph, which makes its own render
+// passes; this one is what pipelines are created against (any render pass
+// with the same attachment formats, sample counts and resolves is
+// compatible) and what the render service draws single views with.
 void createRenderPass(VkApp *pApp) {
+    pApp->depthFormat = findDepthFormat(pApp);
+    if (pApp->msaaSamples > VK_SAMPLE_COUNT_1_BIT) {
+        VkSampleCountFlagBits requested = pApp->msaaSamples;
+        // the service draws into its own single sampled targets with this pass and its pipeline
+        pApp->msaaSamples = pApp->servicePath != NULL ? VK_SAMPLE_COUNT_1_BIT : chooseMsaaSamples(requested, pApp);
+        printf("INFO: %ux MSAA, %u samples requested\n", (uint32_t)pApp->msaaSamples, (uint32_t)requested);
+    }
+    createRenderPassWithViews(pApp, 1, pApp->msaaSamples, &pApp->renderPass);
+}
+
+// viewCount > 1 makes a multiview pass drawing every view into its own layer; with samples above 1
+// color and depth are multisampled and the color is resolved into a third, single sampled attachment
+void createRenderPassWithViews(VkApp *pApp, uint32_t viewCount, VkSampleCountFlagBits samples, VkRenderPass *pRenderPass) {
+    bool multisampled = samples > VK_SAMPLE_COUNT_1_BIT;
     VkAttachmentDescription depthAttachment = {0};
-    depthAttachment.format = findDepthFormat(pApp);
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.format = pApp->depthFormat;
+    depthAttachment.samples = samples;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -691,7 +1006,7 @@ void createRenderPass(VkApp *pApp) {
     depthAttachmentRef.attachment = 1;
     depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkAttachmentDescription colorAttachment = {
+    VkAttachmentDescription resolveAttachment = {
         .format = pApp->swapChainImageFormat,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
@@ -699,14 +1014,28 @@ void createRenderPass(VkApp *pApp) {
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        // offscreen images get copied out rather than presented
+        .finalLayout = pApp->surface != VK_NULL_HANDLE ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
     };
+    // single sampled, the color attachment is the presented image itself
+    VkAttachmentDescription colorAttachment = resolveAttachment;
+    if (multisampled) {
+        resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.samples = samples;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
 
     VkAttachmentReference colorAttachmentRef = {
         .attachment = 0,
         .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
     };
 
+    VkAttachmentReference resolveAttachmentRef = {
+        .attachment = 2,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+
     VkSubpassDescription subpass = {
         .flags = 0,
         .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -714,7 +1043,7 @@ void createRenderPass(VkApp *pApp) {
         .pInputAttachments = NULL,
         .colorAttachmentCount = 1,
         .pColorAttachments = &colorAttachmentRef,
-        .pResolveAttachments = NULL,
+        .pResolveAttachments = multisampled ? &resolveAttachmentRef : NULL,
         .pDepthStencilAttachment = &depthAttachmentRef,
         .preserveAttachmentCount = 0,
         .pPreserveAttachments = NULL
@@ -730,12 +1059,25 @@ void createRenderPass(VkApp *pApp) {
         .dependencyFlags = 0
     };
 
-    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
+    // views are also rendered concurrently, they share the geometry
+    uint32_t viewMask = (1u << viewCount) - 1;
+    VkRenderPassMultiviewCreateInfo multiviewInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+        .pNext = NULL,
+        .subpassCount = 1,
+        .pViewMasks = &viewMask,
+        .dependencyCount = 0,
+        .pViewOffsets = NULL,
+        .correlationMaskCount = 1,
+        .pCorrelationMasks = &viewMask
+    };
+
+    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment, resolveAttachment};
     VkRenderPassCreateInfo renderPassInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .pNext = NULL,
+        .pNext = viewCount > 1 ? &multiviewInfo : NULL,
         .flags = 0,
-        .attachmentCount = 2,
+        .attachmentCount = multisampled ? 3 : 2,
         .pAttachments = attachments,
         .subpassCount = 1,
         .pSubpasses = &subpass,
@@ -743,41 +1085,12 @@ void createRenderPass(VkApp *pApp) {
         .pDependencies = &dependency
     };
 
-    if (vkCreateRenderPass(pApp->device, &renderPassInfo, NULL, &pApp->renderPass) != VK_SUCCESS) {
+    if (vkCreateRenderPass(pApp->device, &renderPassInfo, NULL, pRenderPass) != VK_SUCCESS) {
         fprintf(stderr, "ERROR: failed to create render pass!\n");
         exit(1);
     }
 }
 
-void createFramebuffers(VkApp *pApp) {
-    pApp->swapChainFramebuffers = (VkFramebuffer*)malloc(pApp->swapChainImageCount * sizeof(VkFramebuffer));
-    if (pApp->swapChainFramebuffers == NULL) {
-        fprintf(stderr, "ERROR: unable to allocate for framebuffers\n");
-        exit(1);
-    }
-
-    for (uint32_t i = 0; i < pApp->swapChainImageCount; i++) {
-        VkImageView attachments[] = {pApp->swapChainImageViews[i], pApp->depthImageView};
-        VkFramebufferCreateInfo framebufferInfo = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .pNext = NULL,
-            .flags = 0,
-            .renderPass = pApp->renderPass,
-            .attachmentCount = 2,
-            .pAttachments = attachments,
-            .width = pApp->swapChainExtent.width,
-            .height = pApp->swapChainExtent.height,
-            .layers = 1
-        };
-
-        if (vkCreateFramebuffer(pApp->device, &framebufferInfo, NULL, &pApp->swapChainFramebuffers[i]) != VK_SUCCESS) {
-            fprintf(stderr, "ERROR: vulkan unable to create framebuffer!\n");
-            exit(1);
-        }
-
-    }
-}
-
 void createCommandPool(VkApp *pApp) {
     QueueFamilyIndices queueFamilyIndices = findQueueFamilies(pApp->physicalDevice, pApp->surface);
 
@@ -811,37 +1124,9 @@ void createCommandBuffers(VkApp *pApp) {
     }
 }
 
-void recordCommandBuffer(VkApp *pApp, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-    VkCommandBufferBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .pInheritanceInfo = NULL
-    };
-    
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        fprintf(stderr, "ERROR: unable to begin recording frambuffers!\n");
-        exit(1);
-    }
-
-    
-    VkClearValue clearColors[2];
-    clearColors[0].color = (VkClearColorValue){{0.0f, 0.0f, 0.0f, 1.0f}};
-    clearColors[1].depthStencil = (VkClearDepthStencilValue){1.0f, 0};
-
-    VkRenderPassBeginInfo renderPassInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext = NULL,
-        .renderPass = pApp->renderPass,
-        .framebuffer = pApp->swapChainFramebuffers[imageIndex],
-        .renderArea.offset.x = 0,
-        .renderArea.offset.y = 0,
-        .renderArea.extent = pApp->swapChainExtent,
-        .clearValueCount = 2,
-        .pClearValues = clearColors
-    };
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+// the model pass, inside the render pass the graph begins for it
+void recordModelPass(VkApp *pApp, VkCommandBuffer commandBuffer, void *data) {
+    const FrameState *pState = (const FrameState *)data;
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pApp->graphicsPipeline);
 
     VkViewport viewport = {
@@ -868,8 +1153,78 @@ void recordCommandBuffer(VkApp *pApp, VkCommandBuffer commandBuffer, uint32_t im
     vkCmdBindIndexBuffer(commandBuffer, pApp->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pApp->pipelineLayout, 0, 1, &pApp->descriptorSets[pApp->currentFrame], 0, NULL);
+    DrawPushConstants drawConstants = {0};
+    memcpy(drawConstants.model, pState->model, sizeof(drawConstants.model));
+    vkCmdPushConstants(commandBuffer, pApp->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, DRAW_PUSH_MODEL_OFFSET, sizeof(drawConstants.model), drawConstants.model);
+    if (pApp->bindless.supported) {
+        // bound once per command buffer, draws only change the pushed material index
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pApp->pipelineLayout, BINDLESS_SET, 1, &pApp->bindless.set, 0, NULL);
+        drawConstants.materialIndex = pApp->pTextureStreamer != NULL ? textureStreamerSlot(pApp->pTextureStreamer, pApp->materialIndex) : pApp->materialIndex;
+        drawConstants.feedbackOffset = pApp->currentFrame * BINDLESS_MAX_TEXTURES;
+        vkCmdPushConstants(commandBuffer, pApp->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, DRAW_PUSH_FRAGMENT_SIZE, &drawConstants);
+    }
+    uint32_t drawScope = gpuProfilerBegin(pApp, commandBuffer, "model_draw");
     vkCmdDrawIndexed(commandBuffer, modelIndexCount, 1, 0, 0, 0);
-    vkCmdEndRenderPass(commandBuffer);
+    gpuProfilerEnd(pApp, commandBuffer, drawScope);
+}
+
+// The frame as the render graph sees it: the model pass clears and draws
+// the backbuffer over a transient depth buffer, writing the streaming
+// feedback as it samples, and a capture copies the backbuffer out after it.
+void declareFrame(VkApp *pApp, uint32_t imageIndex, const FrameState *pState) {
+    RenderGraph *pGraph = &pApp->renderGraph;
+    renderGraphBegin(pGraph);
+
+    // acquired for COLOR_ATTACHMENT_OUTPUT, the submit waits there; offscreen images get copied out rather than presented
+    RenderGraphState acquired = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0};
+    RenderGraphState presented = {
+        pApp->surface != VK_NULL_HANDLE ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0
+    };
+    uint32_t backbuffer = renderGraphImportImage(pGraph, "backbuffer", pApp->swapChainImages[imageIndex], pApp->swapChainImageViews[imageIndex],
+                                                 pApp->swapChainImageFormat, pApp->swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT, acquired, presented);
+    uint32_t depth = renderGraphCreateImage(pGraph, "depth", pApp->depthFormat, pApp->swapChainExtent, VK_IMAGE_ASPECT_DEPTH_BIT, pApp->msaaSamples);
+    // multisampled, the model is drawn into a transient and resolved into the backbuffer at the end of the pass
+    bool multisampled = pApp->msaaSamples > VK_SAMPLE_COUNT_1_BIT;
+    uint32_t color = backbuffer;
+    if (multisampled) {
+        color = renderGraphCreateImage(pGraph, "color_msaa", pApp->swapChainImageFormat, pApp->swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT, pApp->msaaSamples);
+    }
+
+    // declared in the attachment order of pApp->renderPass, which the pipeline was created against
+    VkClearValue clearColor = {.color = {{0.0f, 0.0f, 0.0f, 1.0f}}};
+    VkClearValue clearDepth = {.depthStencil = {1.0f, 0}};
+    uint32_t modelPass = renderGraphAddPass(pGraph, "main_pass", recordModelPass, (void *)pState);
+    renderGraphClear(pGraph, modelPass, color, RENDER_GRAPH_COLOR_ATTACHMENT, clearColor);
+    renderGraphClear(pGraph, modelPass, depth, RENDER_GRAPH_DEPTH_ATTACHMENT, clearDepth);
+    if (multisampled) {
+        renderGraphResolve(pGraph, modelPass, color, backbuffer);
+    }
+    if (pApp->pTextureStreamer != NULL) {
+        renderGraphUse(pGraph, modelPass, textureStreamerImportFeedback(pApp, pGraph), RENDER_GRAPH_FRAGMENT_STORAGE);
+    }
+    captureAddPass(pApp, pGraph, backbuffer, imageIndex);
+}
+
+void recordCommandBuffer(VkApp *pApp, VkCommandBuffer commandBuffer, uint32_t imageIndex, const FrameState *pState) {
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .pInheritanceInfo = NULL
+    };
+    
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        fprintf(stderr, "ERROR: unable to begin recording frambuffers!\n");
+        exit(1);
+    }
+    gpuProfilerBeginFrame(pApp, commandBuffer, pState->frameIndex);
+    uint32_t frameScope = gpuProfilerBegin(pApp, commandBuffer, "frame");
+
+    declareFrame(pApp, imageIndex, pState);
+    renderGraphExecute(&pApp->renderGraph, commandBuffer, pApp);
+    gpuProfilerEnd(pApp, commandBuffer, frameScope);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         fprintf(stderr,"ERROR: failed to record command buffer!");
@@ -911,15 +1266,21 @@ void createSyncObjects(VkApp *pApp) {
 }
 
 void cleanupSwapChain(VkApp *pApp) {
+    // framebuffers point at the swapchain views, transients are sized by the swapchain
+    renderGraphReleaseTargets(&pApp->renderGraph, pApp);
     for (uint32_t i = 0; i < pApp->swapChainImageCount; i++) {
         vkDestroyImageView(pApp->device, pApp->swapChainImageViews[i], NULL);
-        vkDestroyFramebuffer(pApp->device, pApp->swapChainFramebuffers[i], NULL);
     }
-    vkDestroySwapchainKHR(pApp->device, pApp->swapChain, NULL);
-    vkDestroyImageView(pApp->device, pApp->depthImageView, NULL);
-    vkDestroyImage(pApp->device, pApp->depthImage, NULL);
-    vkFreeMemory(pApp->device, pApp->depthImageMemory, NULL);
-    free(pApp->swapChainFramebuffers);
+    if (pApp->surface != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(pApp->device, pApp->swapChain, NULL);
+    } else {
+        for (uint32_t i = 0; i < pApp->swapChainImageCount; i++) {
+            vkDestroyImage(pApp->device, pApp->swapChainImages[i], NULL);
+            freeDeviceMemory(pApp->offscreenImageMemory[i], pApp);
+        }
+        free(pApp->offscreenImageMemory);
+        pApp->offscreenImageMemory = NULL;
+    }
     free(pApp->swapChainImages);
     free(pApp->swapChainImageViews);
 }
@@ -927,35 +1288,50 @@ void cleanupSwapChain(VkApp *pApp) {
 void recreateSwapChain(VkApp *pApp) {
     vkDeviceWaitIdle(pApp->device);
 
+    // sized for the old extent, recreated on the next capture
+    destroyCaptureRing(pApp);
     cleanupSwapChain(pApp);
 
     createSwapChain(pApp);
     createImageViews(pApp);
-    createDepthResources(pApp);
-    createFramebuffers(pApp);
 }
 
-void app_renderFrame(VkApp *pApp) {
-    vkWaitForFences(pApp->device, 1, &pApp->inFlightFences[pApp->currentFrame], VK_TRUE, UINT64_MAX);
+void app_renderFrame(VkApp *pApp, const FrameState *pState) {
+    uint64_t frameStart = traceBegin();
+    TRACE_SCOPE("vkWaitForFences", vkWaitForFences(pApp->device, 1, &pApp->inFlightFences[pApp->currentFrame], VK_TRUE, UINT64_MAX));
+    uint64_t acquireStart = SDL_GetPerformanceCounter();
 
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(pApp->device, pApp->swapChain, UINT64_MAX, pApp->imageAvailableSemaphores[pApp->currentFrame], VK_NULL_HANDLE, &imageIndex);
+    VkResult result;
+    bool offscreen = pApp->surface == VK_NULL_HANDLE;
+    if (offscreen) {
+        // the image was last used OFFSCREEN_IMAGE_COUNT frames ago, the fence above already covers it
+        imageIndex = pApp->offscreenImageIndex;
+        pApp->offscreenImageIndex = (pApp->offscreenImageIndex + 1) % pApp->swapChainImageCount;
+        result = VK_SUCCESS;
+    } else {
+        TRACE_SCOPE("vkAcquireNextImageKHR", result = vkAcquireNextImageKHR(pApp->device, pApp->swapChain, UINT64_MAX, pApp->imageAvailableSemaphores[pApp->currentFrame], VK_NULL_HANDLE, &imageIndex));
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain(pApp);
+        TRACE_SCOPE("recreateSwapChain", recreateSwapChain(pApp));
+        traceEnd("app_renderFrame", frameStart);
         return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         fprintf(stderr,"ERROR: failed to acquire swap chain image!");
         exit(1);
     }
-    updateUniformBuffer(pApp->currentFrame, pApp);
+    uint64_t acquireEnd = SDL_GetPerformanceCounter();
+    captureBeginFrame(pApp, pState->frameIndex);
+    TRACE_SCOPE("textureStreamerBeginFrame", textureStreamerBeginFrame(pApp));
+    TRACE_SCOPE("updateUniformBuffer", updateUniformBuffer(pApp->currentFrame, pState, pApp));
     // Only reset the fence if we are submitting work
     vkResetFences(pApp->device, 1, &pApp->inFlightFences[pApp->currentFrame]);
 
 
     vkResetCommandBuffer(pApp->commandBuffers[pApp->currentFrame], 0);
 
-    recordCommandBuffer(pApp, pApp->commandBuffers[pApp->currentFrame], imageIndex);
+    TRACE_SCOPE("recordCommandBuffer", recordCommandBuffer(pApp, pApp->commandBuffers[pApp->currentFrame], imageIndex, pState));
 
 
     VkSemaphore waitSemaphores[] = {pApp->imageAvailableSemaphores[pApp->currentFrame]};
@@ -965,35 +1341,47 @@ void app_renderFrame(VkApp *pApp) {
     VkSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .pNext = NULL,
-        .waitSemaphoreCount = 1,
+        .waitSemaphoreCount = offscreen ? 0 : 1,
         .pWaitSemaphores = waitSemaphores,
         .pWaitDstStageMask = waitStages,
         .commandBufferCount = 1,
         .pCommandBuffers = &pApp->commandBuffers[pApp->currentFrame],
-        .signalSemaphoreCount = 1,
+        .signalSemaphoreCount = offscreen ? 0 : 1,
         .pSignalSemaphores = signalSemaphores
     };
 
-    if (vkQueueSubmit(pApp->graphicsQueue, 1, &submitInfo, pApp->inFlightFences[pApp->currentFrame]) != VK_SUCCESS) {
+    TRACE_SCOPE("vkQueueSubmit", result = vkQueueSubmit(pApp->graphicsQueue, 1, &submitInfo, pApp->inFlightFences[pApp->currentFrame]));
+    if (result != VK_SUCCESS) {
         fprintf(stderr, "ERROR: failed to submit draw command buffer!");
         exit(1);
     }
+    captureSubmitted(pApp);
 
-    VkSwapchainKHR swapChains[] = {pApp->swapChain};
-    VkPresentInfoKHR presentInfo = {
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext = NULL,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = signalSemaphores,
-        .swapchainCount = 1,
-        .pSwapchains = swapChains,
-        .pImageIndices = &imageIndex,
-        .pResults = NULL
-    };
+    if (!offscreen) {
+        VkSwapchainKHR swapChains[] = {pApp->swapChain};
+        VkPresentInfoKHR presentInfo = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .pNext = NULL,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = signalSemaphores,
+            .swapchainCount = 1,
+            .pSwapchains = swapChains,
+            .pImageIndices = &imageIndex,
+            .pResults = NULL
+        };
+
+        TRACE_SCOPE("vkQueuePresentKHR", vkQueuePresentKHR(pApp->presentQueue, &presentInfo));
+    }
 
-    vkQueuePresentKHR(pApp->presentQueue, &presentInfo);
+    // CPU time is the work after acquire, the fence and acquire waits are tracked separately
+    uint64_t presentEnd = SDL_GetPerformanceCounter();
+    double counterToMs = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    frameStatsRecord(&pApp->frameStats, FRAME_METRIC_ACQUIRE, (double)(acquireEnd - acquireStart) * counterToMs);
+    frameStatsRecord(&pApp->frameStats, FRAME_METRIC_CPU, (double)(presentEnd - acquireEnd) * counterToMs);
+    frameStatsRecordPresent(&pApp->frameStats, presentEnd);
 
     pApp->currentFrame = (pApp->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    traceEnd("app_renderFrame", frameStart);
 }
 
 uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkPhysicalDevice physicalDevice) {
@@ -1008,6 +1396,67 @@ uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, V
     exit(1);
 }
 
+void initDeviceMemoryStats(DeviceMemoryStats *pStats) {
+    memset(pStats, 0, sizeof(*pStats));
+    pStats->lock = SDL_CreateMutex();
+    if (pStats->lock == NULL) {
+        fprintf(stderr, "ERROR: failed to create the device memory lock\n");
+        exit(1);
+    }
+}
+
+void destroyDeviceMemoryStats(DeviceMemoryStats *pStats) {
+    SDL_DestroyMutex(pStats->lock);
+    free(pStats->allocations);
+    memset(pStats, 0, sizeof(*pStats));
+}
+
+// vkAllocateMemory, counting the size towards the live and peak device bytes;
+// lazily allocated memory counts in full although it may never be committed
+VkResult allocateDeviceMemory(const VkMemoryAllocateInfo *pAllocateInfo, VkDeviceMemory *pMemory, VkApp *pApp) {
+    VkResult result = vkAllocateMemory(pApp->device, pAllocateInfo, NULL, pMemory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    DeviceMemoryStats *pStats = &pApp->deviceMemory;
+    SDL_LockMutex(pStats->lock);
+    if (pStats->count == pStats->capacity) {
+        uint32_t capacity = pStats->capacity > 0 ? pStats->capacity * 2 : 64;
+        DeviceAllocation *allocations = (DeviceAllocation *)realloc(pStats->allocations, capacity * sizeof(DeviceAllocation));
+        if (allocations == NULL) {
+            fprintf(stderr, "ERROR: out of memory tracking device allocations\n");
+            exit(1);
+        }
+        pStats->allocations = allocations;
+        pStats->capacity = capacity;
+    }
+    pStats->allocations[pStats->count++] = (DeviceAllocation){*pMemory, pAllocateInfo->allocationSize};
+    pStats->liveBytes += pAllocateInfo->allocationSize;
+    if (pStats->liveBytes > pStats->peakBytes) {
+        pStats->peakBytes = pStats->liveBytes;
+    }
+    SDL_UnlockMutex(pStats->lock);
+    return VK_SUCCESS;
+}
+
+// vkFreeMemory for memory from allocateDeviceMemory, VK_NULL_HANDLE is ignored
+void freeDeviceMemory(VkDeviceMemory memory, VkApp *pApp) {
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    DeviceMemoryStats *pStats = &pApp->deviceMemory;
+    SDL_LockMutex(pStats->lock);
+    for (uint32_t i = 0; i < pStats->count; i++) {
+        if (pStats->allocations[i].memory == memory) {
+            pStats->liveBytes -= pStats->allocations[i].size;
+            pStats->allocations[i] = pStats->allocations[--pStats->count];
+            break;
+        }
+    }
+    SDL_UnlockMutex(pStats->lock);
+    vkFreeMemory(pApp->device, memory, NULL);
+}
+
 void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory, VkApp *pApp) {
     VkBufferCreateInfo bufferInfo = {0};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1026,7 +1475,7 @@ void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyF
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, pApp->physicalDevice);
     
-    if (vkAllocateMemory(pApp->device, &allocInfo, NULL, pBufferMemory) != VK_SUCCESS) {
+    if (allocateDeviceMemory(&allocInfo, pBufferMemory, pApp) != VK_SUCCESS) {
         fprintf(stderr, "ERROR: failed to allocate vertex buffer memory!");
         exit(1);
     }
@@ -1074,45 +1523,31 @@ void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t
     endSingleTimeCommands(commandBuffer, pApp);
 }
 
-void createVertexBuffer(VkApp *pApp) {
-    VkDeviceSize bufferSize = sizeof(Vertex) * modelVertexCount;
-
+// copies size bytes through a staging buffer into a new device local buffer
+void createDeviceLocalBuffer(const void *pData, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer *pBuffer, VkDeviceMemory *pBufferMemory, VkApp *pApp) {
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, pApp);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, pApp);
 
     void* data;
-    vkMapMemory(pApp->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, modelVertices, (size_t)bufferSize);
+    vkMapMemory(pApp->device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(data, pData, (size_t)size);
     vkUnmapMemory(pApp->device, stagingBufferMemory);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pApp->vertexBuffer, &pApp->vertexBufferMemory, pApp);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pBuffer, pBufferMemory, pApp);
 
-    copyBuffer(stagingBuffer, pApp->vertexBuffer, bufferSize, pApp);
+    copyBuffer(stagingBuffer, *pBuffer, size, pApp);
 
     vkDestroyBuffer(pApp->device, stagingBuffer, NULL);
-    vkFreeMemory(pApp->device, stagingBufferMemory, NULL);
-
+    freeDeviceMemory(stagingBufferMemory, pApp);
 }
-void createIndexBuffer(VkApp *pApp) {
-    VkDeviceSize bufferSize = sizeof(uint32_t) * modelIndexCount;
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, pApp);
-
-    void* data;
-    vkMapMemory(pApp->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, modelIndices, (size_t)bufferSize);
-    vkUnmapMemory(pApp->device, stagingBufferMemory);
-
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pApp->indexBuffer, &pApp->indexBufferMemory, pApp);
-
-    copyBuffer(stagingBuffer, pApp->indexBuffer, bufferSize, pApp);
-
-    vkDestroyBuffer(pApp->device, stagingBuffer, NULL);
-    vkFreeMemory(pApp->device, stagingBufferMemory, NULL);
+void createVertexBuffer(VkApp *pApp) {
+    createDeviceLocalBuffer(modelVertices, sizeof(Vertex) * modelVertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &pApp->vertexBuffer, &pApp->vertexBufferMemory, pApp);
+}
 
+void createIndexBuffer(VkApp *pApp) {
+    createDeviceLocalBuffer(modelIndices, sizeof(uint32_t) * modelIndexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &pApp->indexBuffer, &pApp->indexBufferMemory, pApp);
 }
 
 
@@ -1144,18 +1579,12 @@ void createDescriptorSetLayout(VkApp *pApp) {
     }
 }
 
-void updateUniformBuffer(uint32_t currentImage, VkApp *pApp) {
-    double time = (double)SDL_GetTicks() / 1000.0;
-
-    UniformBufferObject ubo;
-    glm_mat4_identity(ubo.model);
-    glm_rotate(ubo.model, time * glm_rad(90.0f), (vec3){0.0f, 0.0f, 1.0f});
-    
-    glm_mat4_identity(ubo.view);
-    glm_lookat((vec3){2.0f, 2.0f, 2.0f}, (vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, 1.0f}, ubo.view);
+void updateUniformBuffer(uint32_t currentImage, const FrameState *pState, VkApp *pApp) {
+    CameraUniformBufferObject ubo;
+    glm_mat4_copy((vec4 *)pState->view, ubo.view);
 
     glm_mat4_identity(ubo.proj);
-    glm_perspective(glm_rad(45.0f), pApp->swapChainExtent.width / (float)pApp->swapChainExtent.height, 0.1f, 10.0f, ubo.proj);
+    glm_perspective(pState->fovY, pApp->swapChainExtent.width / (float)pApp->swapChainExtent.height, pState->nearPlane, pState->farPlane, ubo.proj);
 
     // Flip Y Axis because openGL is cring
     ubo.proj[1][1] *= -1;
@@ -1163,7 +1592,7 @@ void updateUniformBuffer(uint32_t currentImage, VkApp *pApp) {
 }
 
 void createUniformBuffers(VkApp *pApp) {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+    VkDeviceSize bufferSize = sizeof(CameraUniformBufferObject);
 
     // pApp->uniformBuffers = (VkBuffer*)malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
     // pApp->uniformBuffersMemory = (VkDeviceMemory*)malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
@@ -1179,101 +1608,50 @@ void createUniformBuffers(VkApp *pApp) {
 void destroyUniformBuffers(VkApp *pApp) {
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroyBuffer(pApp->device, pApp->uniformBuffers[i], NULL);
-        vkFreeMemory(pApp->device, pApp->uniformBuffersMemory[i], NULL);
+        freeDeviceMemory(pApp->uniformBuffersMemory[i], pApp);
     }
     // free(pApp->uniformBuffers);
     // free(pApp->uniformBuffersMemory);
     // free(pApp->uniformBuffersMapped);
 }
 
-void createDescriptorPool(VkApp *pApp) {
-    // VkDescriptorPoolSize poolSize = {0};
-    // poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    // poolSize.descriptorCount = MAX_FRAMES_IN_FLIGHT;
-
-    VkDescriptorPoolSize poolSizes[2];
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-
-    VkDescriptorPoolCreateInfo poolInfo = {0};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 2;
-    poolInfo.pPoolSizes = poolSizes;
-    poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
-    printf("create descriptor pool!\n");
-    if (vkCreateDescriptorPool(pApp->device, &poolInfo, NULL, &pApp->descriptorPool) != VK_SUCCESS) {
-        fprintf(stderr, "ERROR: failed to create descriptor pool!");
-        exit(1);
-    }
-    printf("create descriptor pool!\n");
+void createDescriptorAllocators(VkApp *pApp) {
+    initDescriptorCache(&pApp->descriptorCache);
+}
+
+void destroyDescriptorAllocators(VkApp *pApp) {
+    destroyDescriptorCache(&pApp->descriptorCache, pApp);
+}
+
+// the set laid out by createDescriptorSetLayout that points at a uniform buffer and the texture
+VkDescriptorSet getDescriptorSet(VkBuffer uniformBuffer, VkDeviceSize uniformRange, VkApp *pApp) {
+    DescriptorSetKey key;
+    descriptorSetKeyInit(&key, pApp->descriptorSetLayout);
+    descriptorSetKeyBuffer(&key, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, 0, uniformRange);
+    descriptorSetKeyImage(&key, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pApp->textureImageView, pApp->textureSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    return descriptorCacheGet(&pApp->descriptorCache, &key, pApp);
 }
 
 void createDescriptorSets(VkApp *pApp) {
-    VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
-    // Initialize the array with the same descriptorSetLayout value
-    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        layouts[i] = pApp->descriptorSetLayout;
-    }
-    VkDescriptorSetAllocateInfo allocInfo = {0};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = pApp->descriptorPool;
-    allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
-    allocInfo.pSetLayouts = layouts;
-
-    if (vkAllocateDescriptorSets(pApp->device, &allocInfo, pApp->descriptorSets) != VK_SUCCESS) {
-        fprintf(stderr, "ERROR: failed to allocate descriptor sets!");
-        exit(1);
-    }
-    printf("after create descriptor sets!\n");
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorBufferInfo bufferInfo = {0};
-        bufferInfo.buffer = pApp->uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkDescriptorImageInfo imageInfo = {0};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = pApp->textureImageView;
-        imageInfo.sampler = pApp->textureSampler;
-
-        VkWriteDescriptorSet descriptorWrites[2];
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].pNext = NULL;
-        descriptorWrites[0].dstSet = pApp->descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-        descriptorWrites[0].pImageInfo = NULL;
-        descriptorWrites[0].pTexelBufferView = NULL;
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].pNext = NULL;
-        descriptorWrites[1].dstSet = pApp->descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(pApp->device, 2, descriptorWrites, 0, NULL);
-    }
-    printf("after create descriptor sets!\n");
+        pApp->descriptorSets[i] = getDescriptorSet(pApp->uniformBuffers[i], sizeof(CameraUniformBufferObject), pApp);
+    }
 }
 
 void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *pImage, VkDeviceMemory *pImageMemory, VkApp *pApp) {
+    createLayeredImage(width, height, 1, 1, format, tiling, usage, properties, pImage, pImageMemory, pApp);
+}
+
+// 2D image with mipLevels levels and layers array layers, e.g. one layer per view of a multiview pass
+void createLayeredImage(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage *pImage, VkDeviceMemory *pImageMemory, VkApp *pApp) {
     VkImageCreateInfo imageInfo = {0};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = layers;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1294,7 +1672,7 @@ void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, pApp->physicalDevice);
 
-    if (vkAllocateMemory(pApp->device, &allocInfo, NULL, pImageMemory) != VK_SUCCESS) {
+    if (allocateDeviceMemory(&allocInfo, pImageMemory, pApp) != VK_SUCCESS) {
         fprintf(stderr, "ERROR: failed to allocate image memory!");
         exit(1);
     }
@@ -1302,143 +1680,65 @@ void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling
     vkBindImageMemory(pApp->device, *pImage, *pImageMemory, 0);
 }
 
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkApp *pApp) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(pApp);
-
-    VkImageMemoryBarrier barrier = {0};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    
-        if (hasStencilComponent(format)) {
-            barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-        }
-    } else {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    }
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    } else {
-        fprintf(stderr, "ERROR: unsupportted layout transition!");
-        exit(1);
-    }
-
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, NULL,
-        0, NULL,
-        1, &barrier
-    );
-
-    endSingleTimeCommands(commandBuffer, pApp);
-}
-
 void createTextureImageView(VkApp *pApp) {
-    pApp->textureImageView = createImageView(pApp->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, pApp);
+    pApp->textureImageView = createLayeredImageView(pApp->textureImage, pApp->textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, pApp->textureMipLevels, 1, pApp);
 }
 
+// trilinear, repeating, as much anisotropy as the device has; views limit the mips, so every texture shares it
 void createTextureSampler(VkApp *pApp) {
-    VkSamplerCreateInfo samplerInfo = {0};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    VkPhysicalDeviceProperties properties = {};
-    vkGetPhysicalDeviceProperties(pApp->physicalDevice, &properties);
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-    if (vkCreateSampler(pApp->device, &samplerInfo, NULL, &pApp->textureSampler) != VK_SUCCESS) {
-        fprintf(stderr, "failed to create texture sampler!");
-        exit(1);
-    }
+    SamplerKey key;
+    samplerKeyInit(&key, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    key.maxAnisotropy = pApp->deviceProperties.limits.maxSamplerAnisotropy;
+    pApp->textureSampler = samplerCacheGet(&pApp->samplerCache, &key, pApp);
 }
 
-void createTextureImage(VkApp *pApp) {
-    // Load image with SDL_image
-    SDL_Surface *originalSurface = IMG_Load(texturePath);
-
-    if (originalSurface == NULL) {
-        fprintf(stderr, "ERROR: image can't load: %s\n", SDL_GetError());
-        exit(1);
-    }
-    // convert to RGBA because SDL is cringe and by default loads in RGB??
-    // idk this is wack
-
-    SDL_Surface* surfaceRGBA = SDL_ConvertSurfaceFormat(originalSurface, SDL_PIXELFORMAT_RGBA32, 0);
-    SDL_FreeSurface(originalSurface);
-
-
-    if (surfaceRGBA == NULL) {
-        fprintf(stderr, "Failed to convert surface to RGBA format: %s\n", SDL_GetError());
-        exit(1);
-    }
-
-
-    printf("bytes per pixel: %d\n", surfaceRGBA->format->BytesPerPixel);
-    // hacky way to work around image formats, since SDL uses RGB and Vulkan uses RGBA (probably will cause problems down the line but idc)
-    size_t imageSize = surfaceRGBA->w * surfaceRGBA->h * surfaceRGBA->format->BytesPerPixel;
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, pApp);
-
-    void* data;
-    vkMapMemory(pApp->device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, surfaceRGBA->pixels, imageSize);
-    vkUnmapMemory(pApp->device, stagingBufferMemory);
-
-    createImage(surfaceRGBA->w, surfaceRGBA->h, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pApp->textureImage, &pApp->textureImageMemory, pApp);
-    transitionImageLayout(pApp->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pApp);
-    copyBufferToImage(stagingBuffer, pApp->textureImage, surfaceRGBA->w, surfaceRGBA->h, pApp);
-    transitionImageLayout(pApp->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, pApp);
-
-    vkDestroyBuffer(pApp->device, stagingBuffer, NULL);
-    vkFreeMemory(pApp->device, stagingBufferMemory, NULL);
+bool formatSupportsLinearBlit(VkFormat format, VkApp *pApp) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(pApp->physicalDevice, format, &properties);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & needed) == needed;
+}
 
-    SDL_FreeSurface(surfaceRGBA);
+// Expects every level in TRANSFER_DST_OPTIMAL with level 0 filled in. Each
+// level is blitted from the one above it, after a single barrier that turns
+// that one into a blit source, so the whole chain goes into the batch's
+// command buffer. The moves to SHADER_READ_ONLY_OPTIMAL are left in the batch,
+// two barriers for the whole chain, for the caller to flush together with
+// whatever else is done with the transfer queue by then.
+void recordMipmapGeneration(BarrierBatch *pBatch, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels) {
+    VkCommandBuffer commandBuffer = pBatch->commandBuffer;
+    BarrierBatch levelBarrier;
+    initBarrierBatch(&levelBarrier, commandBuffer);
+    int32_t mipWidth = (int32_t)width;
+    int32_t mipHeight = (int32_t)height;
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        VkImageSubresourceRange source = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1};
+        barrierBatchImage(&levelBarrier, image, source, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        barrierBatchFlush(&levelBarrier);
+
+        int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+        int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+        VkImageBlit blit = {0};
+        blit.srcOffsets[1] = (VkOffset3D){mipWidth, mipHeight, 1};
+        blit.srcSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.dstOffsets[1] = (VkOffset3D){nextWidth, nextHeight, 1};
+        blit.dstSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // every level but the last was read from, the last one was only ever written
+    if (mipLevels > 1) {
+        VkImageSubresourceRange sources = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels - 1, 0, 1};
+        barrierBatchImage(pBatch, image, sources, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    VkImageSubresourceRange last = {VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - 1, 1, 0, 1};
+    barrierBatchImage(pBatch, image, last, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
 }
 
 VkCommandBuffer beginSingleTimeCommands(VkApp *pApp) {
@@ -1476,16 +1776,20 @@ void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkApp *pApp) {
 }
 
 VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkApp *pApp) {
+    return createLayeredImageView(image, format, aspectFlags, 1, 1, pApp);
+}
+
+VkImageView createLayeredImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t layers, VkApp *pApp) {
     VkImageViewCreateInfo viewInfo = {0};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.viewType = layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.subresourceRange.layerCount = layers;
 
     VkImageView imageView;
     if (vkCreateImageView(pApp->device, &viewInfo, NULL, &imageView) != VK_SUCCESS) {
@@ -1528,13 +1832,6 @@ VkFormat findDepthFormat(VkApp *pApp) {
     );
 }
 
-void createDepthResources(VkApp *pApp) {
-    VkFormat depthFormat = findDepthFormat(pApp);
-    createImage(pApp->swapChainExtent.width, pApp->swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pApp->depthImage, &pApp->depthImageMemory, pApp);
-    pApp->depthImageView = createImageView(pApp->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, pApp);
-    transitionImageLayout(pApp->depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, pApp);
-}
-
 
 void loadFile(void *ctx, const char * filename, const int is_mtl, const char *obj_filename, char ** buffer, size_t * len)
 {
@@ -1559,8 +1856,8 @@ void loadFile(void *ctx, const char * filename, const int is_mtl, const char *ob
 }
 
 
-void loadModel() {
-    printf("INFO: Loading model: %s!\n", modelPath);
+// false if the file could not be parsed; the arrays are malloc'd for the caller
+bool loadModelFile(const char *path, Vertex **ppVertices, uint32_t *pVertexCount, uint32_t **ppIndices, uint32_t *pIndexCount) {
     unsigned int flags = TINYOBJ_FLAG_TRIANGULATE;
     tinyobj_attrib_t attrib;
     tinyobj_shape_t *shapes;
@@ -1571,18 +1868,31 @@ void loadModel() {
 
     int ret =
         tinyobj_parse_obj(&attrib, &shapes, &num_shapes, &materials,
-                          &num_materials, modelPath, loadFile, NULL, flags);
+                          &num_materials, path, loadFile, NULL, flags);
     if (ret != TINYOBJ_SUCCESS) {
-        fprintf(stderr, "ERROR: failed to load obj file!");
+        return false;
+    }
+    // the indices come from the file as written; a face without a texture
+    // coordinate or pointing past the attribute arrays fails the load
+    for (uint32_t i = 0; i < attrib.num_faces; i++) {
+        int v_idx = attrib.faces[i].v_idx;
+        int vt_idx = attrib.faces[i].vt_idx;
+        if (v_idx < 0 || (unsigned int)v_idx >= attrib.num_vertices || vt_idx < 0 || (unsigned int)vt_idx >= attrib.num_texcoords) {
+            fprintf(stderr, "ERROR: %s: face index %u has a missing or out of range position or texture coordinate!\n", path, i);
+            tinyobj_attrib_free(&attrib);
+            tinyobj_shapes_free(shapes, num_shapes);
+            tinyobj_materials_free(materials, num_materials);
+            return false;
+        }
+    }
+    Vertex *vertices = (Vertex*)calloc(attrib.num_vertices, sizeof(Vertex));
+    uint32_t *indices = (uint32_t*)malloc((size_t)attrib.num_faces * sizeof(uint32_t));
+    if ((vertices == NULL && attrib.num_vertices > 0) || (indices == NULL && attrib.num_faces > 0)) {
+        fprintf(stderr, "ERROR: out of memory loading %s!\n", path);
         exit(1);
     }
-    modelVertices = (Vertex*)malloc((size_t)attrib.num_vertices * sizeof(Vertex));
-    modelIndices = (uint32_t*)malloc((size_t)attrib.num_faces * sizeof(uint32_t));
 
-    modelIndexCount = attrib.num_faces;
-    modelVertexCount = attrib.num_vertices;
-    printf("Num Faces: %u, Num Verts: %u\n", attrib.num_faces, attrib.num_vertices);
-    for (uint32_t i; i < attrib.num_faces; i++) {
+    for (uint32_t i = 0; i < attrib.num_faces; i++) {
         Vertex vertex = {};
         vertex.pos[0] = attrib.vertices[3 * attrib.faces[i].v_idx + 0];
         vertex.pos[1] = attrib.vertices[3 *attrib.faces[i].v_idx + 1];
@@ -1596,10 +1906,24 @@ void loadModel() {
         vertex.color[1] = 1.0f;
         vertex.color[2] = 1.0f;
 
-        modelIndices[i] = attrib.faces[i].v_idx;
-        modelVertices[attrib.faces[i].v_idx] = vertex;
+        indices[i] = attrib.faces[i].v_idx;
+        vertices[attrib.faces[i].v_idx] = vertex;
     }
+    *ppVertices = vertices;
+    *pVertexCount = attrib.num_vertices;
+    *ppIndices = indices;
+    *pIndexCount = attrib.num_faces;
     tinyobj_attrib_free(&attrib);
     tinyobj_shapes_free(shapes, num_shapes);
     tinyobj_materials_free(materials, num_materials);
+    return true;
+}
+
+void loadModel() {
+    printf("INFO: Loading model: %s!\n", modelPath);
+    if (!loadModelFile(modelPath, &modelVertices, &modelVertexCount, &modelIndices, &modelIndexCount)) {
+        fprintf(stderr, "ERROR: failed to load obj file!");
+        exit(1);
+    }
+    printf("Num Faces: %u, Num Verts: %u\n", modelIndexCount, modelVertexCount);
 }
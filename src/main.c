@@ -3,9 +3,10 @@
 
 #include "include/vkapp.h"
 
-int main() {
+int main(int argc, char **argv) {
     VkApp app = {0};
     populateVkApp(1000, 800, "shartvk triangle", &app);
+    app_parseArgs(argc, argv, &app);
     return app_run(&app);
 }
 
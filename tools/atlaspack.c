@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+#include "vkapp_packer.h"
+
+// Offline atlas packer: packs small images into square pages and writes the
+// pages as PNG next to a .atlas manifest the app loads with --atlas, so the
+// packing and the per texture decodes are done once instead of at every
+// startup. Page n of out.atlas is written to out_<n>.png.
+//
+//   atlaspack [--page-size <texels>] <output.atlas> <image>...
+
+int main(int argc, char **argv) {
+    AtlasLayout layout = {.pageSize = ATLAS_DEFAULT_PAGE_SIZE, .padding = ATLAS_PADDING};
+    const char *outputPath = NULL;
+    int firstInput = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--page-size") == 0 && i + 1 < argc) {
+            layout.pageSize = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            outputPath = argv[i];
+            firstInput = i + 1;
+            break;
+        }
+    }
+    size_t outputLength = outputPath != NULL ? strlen(outputPath) : 0;
+    bool manifestPath = outputLength > strlen(".atlas") && strcmp(outputPath + outputLength - strlen(".atlas"), ".atlas") == 0;
+    if (!manifestPath || firstInput >= argc || layout.pageSize == 0 || layout.pageSize % layout.padding != 0) {
+        fprintf(stderr, "usage: %s [--page-size <texels, a multiple of %u>] <output.atlas> <image>...\n", argv[0], ATLAS_PADDING);
+        return 1;
+    }
+    if (SDL_Init(0) != 0) {
+        fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    layout.entryCount = (uint32_t)(argc - firstInput);
+    layout.entries = (AtlasEntry *)calloc(layout.entryCount, sizeof(AtlasEntry));
+    uint8_t **pixels = (uint8_t **)calloc(layout.entryCount, sizeof(uint8_t *));
+    for (uint32_t i = 0; i < layout.entryCount; i++) {
+        AtlasEntry *pEntry = &layout.entries[i];
+        pEntry->path = atlasCopyPath(argv[firstInput + i]);
+        pixels[i] = atlasLoadImageRGBA8(pEntry->path, &pEntry->width, &pEntry->height);
+        if (pixels[i] == NULL) {
+            return 1;
+        }
+        if (!atlasAccepts(layout.pageSize, layout.padding, pEntry->width, pEntry->height)) {
+            fprintf(stderr, "ERROR: %s is %ux%u, pages of %u texels take up to %u on either side\n", pEntry->path, pEntry->width, pEntry->height, layout.pageSize, layout.pageSize / 2);
+            return 1;
+        }
+    }
+    if (!atlasPack(&layout)) {
+        return 1;
+    }
+
+    // pages go next to the manifest, named after it
+    size_t baseLength = outputLength - strlen(".atlas");
+    uint8_t *pPage = (uint8_t *)malloc((size_t)layout.pageSize * layout.pageSize * 4);
+    bool written = true;
+    for (uint32_t page = 0; page < layout.pageCount && written; page++) {
+        memset(pPage, 0, (size_t)layout.pageSize * layout.pageSize * 4);
+        for (uint32_t i = 0; i < layout.entryCount; i++) {
+            if (layout.entries[i].page == page) {
+                atlasBlitEntry(pPage, layout.pageSize, layout.padding, &layout.entries[i], pixels[i]);
+            }
+        }
+        char pagePath[ATLAS_MAX_PATH];
+        snprintf(pagePath, sizeof(pagePath), "%.*s_%u.png", (int)baseLength, outputPath, page);
+        layout.pagePaths[page] = atlasCopyPath(pagePath);
+        SDL_Surface *pSurface = SDL_CreateRGBSurfaceWithFormatFrom(pPage, (int)layout.pageSize, (int)layout.pageSize, 32, (int)layout.pageSize * 4, SDL_PIXELFORMAT_RGBA32);
+        if (pSurface == NULL || IMG_SavePNG(pSurface, pagePath) != 0) {
+            fprintf(stderr, "ERROR: unable to write %s: %s\n", pagePath, SDL_GetError());
+            written = false;
+        }
+        SDL_FreeSurface(pSurface);
+    }
+    written = written && writeAtlasManifest(outputPath, &layout);
+    if (written) {
+        printf("INFO: wrote %s: %u textures on %u pages of %u texels\n", outputPath, layout.entryCount, layout.pageCount, layout.pageSize);
+    }
+    for (uint32_t i = 0; i < layout.entryCount; i++) {
+        free(pixels[i]);
+    }
+    free(pixels);
+    free(pPage);
+    freeAtlasLayout(&layout);
+    SDL_Quit();
+    return written ? 0 : 1;
+}
@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+#include "vkapp_jobs.h"
+#include "vkapp_image.h"
+#include "vkapp_ktx.h"
+
+// Offline texture compressor: decodes an image, builds its mip chain and
+// writes every level as BC7 (color) or BC5 (normal maps, X and Y in red and
+// green) blocks into a KTX2 file the app uploads without decoding, see
+// loadKtx2File. Rows of blocks are spread over the job system.
+//
+//   ktxconv [--normal] [--linear] <input image> <output.ktx2>
+//
+// BC7 blocks all use mode 6: one RGBA endpoint pair per block, fitted to
+// the block's principal axis, with 7 bit endpoints plus a p-bit each and
+// 4 bit indices. It is the cheapest mode to search and good enough for
+// textures without sharp multi-color edges inside a block.
+
+#define KTXCONV_ROWS_PER_JOB 4
+#define KHR_DF_MODEL_BC5 132
+#define KHR_DF_MODEL_BC7 134
+#define KHR_DF_PRIMARIES_BT709 1
+#define KHR_DF_TRANSFER_LINEAR 1
+#define KHR_DF_TRANSFER_SRGB 2
+#define KHR_DF_CHANNEL_RED 0
+#define KHR_DF_CHANNEL_GREEN 1
+
+const uint32_t bc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+typedef struct {
+    uint8_t bytes[16];
+    uint32_t position;
+} BlockWriter;
+
+void blockPutBits(BlockWriter *pWriter, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, pWriter->position++) {
+        if (value & (1u << i)) {
+            pWriter->bytes[pWriter->position / 8] |= (uint8_t)(1u << (pWriter->position % 8));
+        }
+    }
+}
+
+// 4x4 texels, clamped at the right and bottom edges of small levels
+void fetchBlock(const uint8_t *pLevel, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t texels[16][4]) {
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sy = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sx = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+            memcpy(texels[y * 4 + x], pLevel + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+// fills the 16 entry palette for two quantized endpoints and returns the block error
+uint32_t bc7Mode6Error(uint8_t texels[16][4], const int endpoints[2][4], uint8_t indices[16]) {
+    int palette[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            palette[i][c] = (int)(((64 - bc7Weights4[i]) * (uint32_t)endpoints[0][c] + bc7Weights4[i] * (uint32_t)endpoints[1][c] + 32) >> 6);
+        }
+    }
+    uint32_t total = 0;
+    for (int t = 0; t < 16; t++) {
+        uint32_t best = UINT32_MAX;
+        for (int i = 0; i < 16; i++) {
+            uint32_t error = 0;
+            for (int c = 0; c < 4; c++) {
+                int d = (int)texels[t][c] - palette[i][c];
+                error += (uint32_t)(d * d);
+            }
+            if (error < best) {
+                best = error;
+                indices[t] = (uint8_t)i;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+void encodeBC7Block(uint8_t texels[16][4], uint8_t *pOut) {
+    // principal axis of the block by power iteration on its covariance
+    float mean[4] = {0.0f};
+    for (int t = 0; t < 16; t++) {
+        for (int c = 0; c < 4; c++) {
+            mean[c] += texels[t][c] / 16.0f;
+        }
+    }
+    float covariance[4][4] = {{0.0f}};
+    for (int t = 0; t < 16; t++) {
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++) {
+                covariance[a][b] += (texels[t][a] - mean[a]) * (texels[t][b] - mean[b]);
+            }
+        }
+    }
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {0.0f};
+        float length = 0.0f;
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) {
+            break;
+        }
+        length = sqrtf(length);
+        for (int a = 0; a < 4; a++) {
+            axis[a] = next[a] / length;
+        }
+    }
+    float minT = 0.0f;
+    float maxT = 0.0f;
+    for (int t = 0; t < 16; t++) {
+        float projected = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            projected += (texels[t][c] - mean[c]) * axis[c];
+        }
+        minT = projected < minT ? projected : minT;
+        maxT = projected > maxT ? projected : maxT;
+    }
+    float ends[2][4];
+    for (int c = 0; c < 4; c++) {
+        ends[0][c] = mean[c] + minT * axis[c];
+        ends[1][c] = mean[c] + maxT * axis[c];
+    }
+
+    // try every p-bit pair, each endpoint is (7 bit value << 1) | p-bit
+    uint32_t bestError = UINT32_MAX;
+    int bestQuantized[2][4] = {{0}};
+    int bestP[2] = {0, 0};
+    uint8_t bestIndices[16] = {0};
+    for (int p0 = 0; p0 < 2; p0++) {
+        for (int p1 = 0; p1 < 2; p1++) {
+            int p[2] = {p0, p1};
+            int quantized[2][4];
+            int endpoints[2][4];
+            for (int e = 0; e < 2; e++) {
+                for (int c = 0; c < 4; c++) {
+                    int q = (int)floorf((ends[e][c] - p[e]) / 2.0f + 0.5f);
+                    quantized[e][c] = q < 0 ? 0 : q > 127 ? 127 : q;
+                    endpoints[e][c] = quantized[e][c] << 1 | p[e];
+                }
+            }
+            uint8_t indices[16];
+            uint32_t error = bc7Mode6Error(texels, (const int (*)[4])endpoints, indices);
+            if (error < bestError) {
+                bestError = error;
+                memcpy(bestQuantized, quantized, sizeof(quantized));
+                bestP[0] = p0;
+                bestP[1] = p1;
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+    }
+
+    // the first index is stored without its top bit, so it has to be below 8
+    if (bestIndices[0] >= 8) {
+        for (int c = 0; c < 4; c++) {
+            int swap = bestQuantized[0][c];
+            bestQuantized[0][c] = bestQuantized[1][c];
+            bestQuantized[1][c] = swap;
+        }
+        int swap = bestP[0];
+        bestP[0] = bestP[1];
+        bestP[1] = swap;
+        for (int t = 0; t < 16; t++) {
+            bestIndices[t] = (uint8_t)(15 - bestIndices[t]);
+        }
+    }
+
+    BlockWriter writer = {{0}, 0};
+    blockPutBits(&writer, 1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        blockPutBits(&writer, (uint32_t)bestQuantized[0][c], 7);
+        blockPutBits(&writer, (uint32_t)bestQuantized[1][c], 7);
+    }
+    blockPutBits(&writer, (uint32_t)bestP[0], 1);
+    blockPutBits(&writer, (uint32_t)bestP[1], 1);
+    for (int t = 0; t < 16; t++) {
+        blockPutBits(&writer, bestIndices[t], t == 0 ? 3 : 4);
+    }
+    memcpy(pOut, writer.bytes, 16);
+}
+
+// one BC4 style channel, endpoints at the channel's extremes with 8 interpolated values
+void encodeBC4Channel(uint8_t texels[16][4], int channel, uint8_t *pOut) {
+    uint8_t high = 0;
+    uint8_t low = 255;
+    for (int t = 0; t < 16; t++) {
+        high = texels[t][channel] > high ? texels[t][channel] : high;
+        low = texels[t][channel] < low ? texels[t][channel] : low;
+    }
+    int palette[8] = {high, low};
+    for (int i = 2; i < 8; i++) {
+        palette[i] = ((8 - i) * high + (i - 1) * low + 3) / 7;
+    }
+    BlockWriter writer = {{0}, 0};
+    blockPutBits(&writer, high, 8);
+    blockPutBits(&writer, low, 8);
+    for (int t = 0; t < 16; t++) {
+        uint32_t bestIndex = 0;
+        int bestError = INT32_MAX;
+        for (int i = 0; i < 8; i++) {
+            int error = abs((int)texels[t][channel] - palette[i]);
+            if (error < bestError) {
+                bestError = error;
+                bestIndex = (uint32_t)i;
+            }
+        }
+        // with high == low every index decodes to the same value
+        blockPutBits(&writer, high == low ? 0 : bestIndex, 3);
+    }
+    memcpy(pOut, writer.bytes, 8);
+}
+
+void encodeBC5Block(uint8_t texels[16][4], uint8_t *pOut) {
+    encodeBC4Channel(texels, 0, pOut);
+    encodeBC4Channel(texels, 1, pOut + 8);
+}
+
+typedef struct {
+    const uint8_t *pLevel;
+    uint32_t width;
+    uint32_t height;
+    bool normal;
+    uint8_t *pBlocks;
+} EncodeLevelData;
+
+void encodeBlockRows(void *data, uint32_t begin, uint32_t end) {
+    EncodeLevelData *pData = (EncodeLevelData *)data;
+    uint32_t blocksWide = (pData->width + 3) / 4;
+    for (uint32_t blockY = begin; blockY < end; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+            uint8_t texels[16][4];
+            fetchBlock(pData->pLevel, pData->width, pData->height, blockX, blockY, texels);
+            uint8_t *pOut = pData->pBlocks + ((size_t)blockY * blocksWide + blockX) * 16;
+            if (pData->normal) {
+                encodeBC5Block(texels, pOut);
+            } else {
+                encodeBC7Block(texels, pOut);
+            }
+        }
+    }
+}
+
+void writeU32(FILE *pFile, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    fwrite(bytes, 1, 4, pFile);
+}
+
+void writeU64(FILE *pFile, uint64_t value) {
+    writeU32(pFile, (uint32_t)value);
+    writeU32(pFile, (uint32_t)(value >> 32));
+}
+
+// Basic data format descriptor for 4x4 blocks of 16 bytes: BC7 is a single
+// opaque sample, BC5 a red and a green half.
+uint32_t writeDataFormatDescriptor(FILE *pFile, bool normal, bool srgb) {
+    uint32_t sampleCount = normal ? 2 : 1;
+    uint32_t blockSize = 24 + 16 * sampleCount;
+    if (pFile != NULL) {
+        writeU32(pFile, 4 + blockSize);
+        writeU32(pFile, 0);
+        writeU32(pFile, 2 | blockSize << 16);
+        uint8_t basic[12] = {
+            normal ? KHR_DF_MODEL_BC5 : KHR_DF_MODEL_BC7, KHR_DF_PRIMARIES_BT709, srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR, 0,
+            3, 3, 0, 0,
+            16, 0, 0, 0
+        };
+        fwrite(basic, 1, sizeof(basic), pFile);
+        // bytesPlane4-7
+        writeU32(pFile, 0);
+        for (uint32_t i = 0; i < sampleCount; i++) {
+            uint8_t sample[8] = {
+                (uint8_t)(i * 64), 0, normal ? 63 : 127, normal ? (i == 0 ? KHR_DF_CHANNEL_RED : KHR_DF_CHANNEL_GREEN) : 0,
+                0, 0, 0, 0
+            };
+            fwrite(sample, 1, sizeof(sample), pFile);
+            writeU32(pFile, 0);
+            writeU32(pFile, UINT32_MAX);
+        }
+    }
+    return 4 + blockSize;
+}
+
+// levels are stored smallest first, each starting on KTX2_LEVEL_ALIGNMENT
+bool writeKtx2File(const char *path, VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, uint8_t **ppLevels, const size_t *pLevelSizes, bool normal, bool srgb) {
+    FILE *pFile = fopen(path, "wb");
+    if (pFile == NULL) {
+        fprintf(stderr, "ERROR: unable to open %s\n", path);
+        return false;
+    }
+    uint32_t dfdOffset = KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    uint32_t dfdSize = writeDataFormatDescriptor(NULL, normal, srgb);
+    uint64_t levelOffsets[KTX2_MAX_LEVELS];
+    uint64_t offset = dfdOffset + dfdSize;
+    for (int32_t level = (int32_t)levelCount - 1; level >= 0; level--) {
+        offset = (offset + KTX2_LEVEL_ALIGNMENT - 1) / KTX2_LEVEL_ALIGNMENT * KTX2_LEVEL_ALIGNMENT;
+        levelOffsets[level] = offset;
+        offset += pLevelSizes[level];
+    }
+
+    fwrite(ktx2Identifier, 1, sizeof(ktx2Identifier), pFile);
+    writeU32(pFile, (uint32_t)format);
+    // typeSize is 1 for block compressed formats
+    writeU32(pFile, 1);
+    writeU32(pFile, width);
+    writeU32(pFile, height);
+    writeU32(pFile, 0);
+    writeU32(pFile, 0);
+    writeU32(pFile, 1);
+    writeU32(pFile, levelCount);
+    writeU32(pFile, 0);
+    writeU32(pFile, dfdOffset);
+    writeU32(pFile, dfdSize);
+    // no key/value data and no supercompression data
+    writeU32(pFile, 0);
+    writeU32(pFile, 0);
+    writeU64(pFile, 0);
+    writeU64(pFile, 0);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        writeU64(pFile, levelOffsets[level]);
+        writeU64(pFile, pLevelSizes[level]);
+        writeU64(pFile, pLevelSizes[level]);
+    }
+    writeDataFormatDescriptor(pFile, normal, srgb);
+    for (int32_t level = (int32_t)levelCount - 1; level >= 0; level--) {
+        static const uint8_t padding[KTX2_LEVEL_ALIGNMENT] = {0};
+        long position = ftell(pFile);
+        fwrite(padding, 1, (size_t)(levelOffsets[level] - (uint64_t)position), pFile);
+        fwrite(ppLevels[level], 1, pLevelSizes[level], pFile);
+    }
+    bool written = !ferror(pFile);
+    if (fclose(pFile) != 0 || !written) {
+        fprintf(stderr, "ERROR: unable to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool normal = false;
+    bool srgb = true;
+    const char *inputPath = NULL;
+    const char *outputPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--normal") == 0) {
+            normal = true;
+            srgb = false;
+        } else if (strcmp(argv[i], "--linear") == 0) {
+            srgb = false;
+        } else if (inputPath == NULL) {
+            inputPath = argv[i];
+        } else if (outputPath == NULL) {
+            outputPath = argv[i];
+        } else {
+            outputPath = NULL;
+            break;
+        }
+    }
+    if (inputPath == NULL || outputPath == NULL) {
+        fprintf(stderr, "usage: %s [--normal] [--linear] <input image> <output.ktx2>\n", argv[0]);
+        return 1;
+    }
+    if (SDL_Init(0) != 0) {
+        fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    SDL_Surface *pOriginal = IMG_Load(inputPath);
+    if (pOriginal == NULL) {
+        fprintf(stderr, "ERROR: image can't load: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_Surface *pSurface = SDL_ConvertSurfaceFormat(pOriginal, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(pOriginal);
+    if (pSurface == NULL) {
+        fprintf(stderr, "ERROR: failed to convert %s to RGBA: %s\n", inputPath, SDL_GetError());
+        return 1;
+    }
+    uint32_t width = (uint32_t)pSurface->w;
+    uint32_t height = (uint32_t)pSurface->h;
+    uint32_t levelCount = mipLevelCount(width, height);
+    // the box filter wants tightly packed rows
+    uint8_t *pPixels = (uint8_t *)malloc((size_t)width * height * 4);
+    uint8_t *pChain = (uint8_t *)malloc(mipChainSize(width, height, levelCount));
+    if (pPixels == NULL || pChain == NULL) {
+        fprintf(stderr, "ERROR: unable to allocate the mip chain\n");
+        return 1;
+    }
+    for (uint32_t y = 0; y < height; y++) {
+        memcpy(pPixels + (size_t)y * width * 4, (const uint8_t *)pSurface->pixels + (size_t)y * pSurface->pitch, (size_t)width * 4);
+    }
+    SDL_FreeSurface(pSurface);
+    size_t chainOffsets[KTX2_MAX_LEVELS];
+    buildMipChainRGBA8(pPixels, width, height, levelCount, srgb, pChain, chainOffsets);
+    free(pPixels);
+
+    JobSystem jobSystem;
+    jobSystemInit(&jobSystem, JOB_SYSTEM_DEFAULT_WORKERS);
+    jobSystemRegisterThread(&jobSystem);
+    uint64_t start = SDL_GetPerformanceCounter();
+    uint8_t *levels[KTX2_MAX_LEVELS];
+    size_t levelSizes[KTX2_MAX_LEVELS];
+    size_t totalSize = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        EncodeLevelData data = {
+            .pLevel = pChain + chainOffsets[level],
+            .width = mipLevelExtent(width, level),
+            .height = mipLevelExtent(height, level),
+            .normal = normal
+        };
+        levelSizes[level] = ktxLevelSize(data.width, data.height);
+        levels[level] = (uint8_t *)malloc(levelSizes[level]);
+        if (levels[level] == NULL) {
+            fprintf(stderr, "ERROR: unable to allocate level %u\n", level);
+            return 1;
+        }
+        data.pBlocks = levels[level];
+        jobSystemParallelFor(&jobSystem, (data.height + 3) / 4, KTXCONV_ROWS_PER_JOB, encodeBlockRows, &data);
+        totalSize += levelSizes[level];
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    jobSystemShutdown(&jobSystem);
+
+    VkFormat format = normal ? VK_FORMAT_BC5_UNORM_BLOCK : srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    bool written = writeKtx2File(outputPath, format, width, height, levelCount, levels, levelSizes, normal, srgb);
+    if (written) {
+        printf("INFO: wrote %s: %ux%u %s, %u levels, %zu bytes (%.1f%% of RGBA8) in %.2fs\n", outputPath, width, height,
+               normal ? "BC5" : "BC7", levelCount, totalSize, 100.0 * (double)totalSize / (double)mipChainSize(width, height, levelCount), seconds);
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+        free(levels[level]);
+    }
+    free(pChain);
+    SDL_Quit();
+    return written ? 0 : 1;
+}